@@ -26,7 +26,6 @@
 #include <libavformat/avformat.h>
 #include <libavutil/avassert.h>
 #include <libavutil/avstring.h>
-#include <libavutil/motion_vector.h>
 #include <libavutil/opt.h>
 #include <libavutil/rational.h>
 #include <libavutil/time.h>
@@ -35,6 +34,10 @@
 
 #include "sxplayer.h"
 #include "async.h"
+#include "codec_pool.h"
+#include "decoders.h"
+#include "frame.h"
+#include "frame_cache.h"
 #include "log.h"
 #include "internal.h"
 
@@ -46,9 +49,15 @@ struct sxplayer_ctx {
 
     struct sxplayer_opts opts;
 
+    AVBufferPool *frame_pool;               // user frames, outlives the context until they are all released
+
     struct async_context *actx;
     int context_configured;
 
+    struct sxplayer_ctx *master;            // context this one shares the input with
+    struct sxplayer_ctx **links;            // contexts sharing the input of this one
+    int nb_links;
+
     AVFrame *cached_frame;
 
     AVRational st_timebase;                 // stream timebase
@@ -59,6 +68,29 @@ struct sxplayer_ctx {
     int64_t first_ts;
     int64_t last_ts;
 
+    struct frame_cache *frame_cache;
+    int64_t frame_cache_prev_pts;           // pts of the previous frame poped from the pipeline since the latest seek
+    int frame_cache_served;                 // latest pushed frame comes from the frame cache and is behind the pipeline
+    int64_t frame_cache_hits;
+    int64_t frame_cache_misses;
+    int64_t prefetch_vt;                    // media time of the pending previous GOP prefetch (backward direction)
+
+    int drop_ref;                           // user frame dropping mode (SXPLAYER_DROP_*)
+    enum AVDiscard skip_frame;              // decoder skip frame level currently requested
+    int auto_drop_nb_requests;
+    int auto_drop_nb_discarded;             // decoded frames skipped by the requests
+    int auto_drop_nb_repeated;              // requests returning the same frame again
+
+    int64_t deadline;                       // av_gettime_relative() time at which the current request gives up
+    int timed_out;                          // the current request reached its deadline
+    int64_t converging_vt;                  // media time the pipeline still moves from after a timed out request
+    int64_t keyframe_vt;                    // media time of the pending keyframe seek, served by its first frame
+
+    int64_t nb_forward_seeks;               // forward requests served by seeking
+    int64_t nb_forward_decodes;             // forward requests served by decoding up to the requested time
+    double decode_speed;                    // measured decoding time per media second, 0 if unknown
+    double seek_overhead;                   // measured seek time besides the decoding from the keyframe (s), -1 if unknown
+
     int64_t entering_time;
     const char *cur_func_name;
 };
@@ -87,6 +119,17 @@ static const AVOption sxplayer_options[] = {
     { "vt_pix_fmt",             NULL, OFFSET(vt_pix_fmt),             AV_OPT_TYPE_STRING,    {.str="bgra"},  0, 0 },
     { "stream_idx",             NULL, OFFSET(stream_idx),             AV_OPT_TYPE_INT,       {.i64=-1},     -1, INT_MAX },
     { "use_pkt_duration",       NULL, OFFSET(use_pkt_duration),       AV_OPT_TYPE_INT,       {.i64=1},       0, 1 },
+    { "cache_dir",              NULL, OFFSET(cache_dir),              AV_OPT_TYPE_STRING,    {.str=NULL},    0, 0 },
+    { "frame_cache_size",       NULL, OFFSET(frame_cache_size),       AV_OPT_TYPE_INT,       {.i64=0},       0, INT_MAX },
+    { "packet_cache_size",      NULL, OFFSET(packet_cache_size),      AV_OPT_TYPE_INT,       {.i64=0},       0, INT_MAX },
+    { "direction",              NULL, OFFSET(direction),              AV_OPT_TYPE_INT,       {.i64=SXPLAYER_DIRECTION_FORWARD}, 0, NB_SXPLAYER_DIRECTION-1 },
+    { "exec_mode",              NULL, OFFSET(exec_mode),              AV_OPT_TYPE_INT,       {.i64=SXPLAYER_EXEC_THREADS}, 0, NB_SXPLAYER_EXEC-1 },
+    { "codec_threads",          NULL, OFFSET(codec_threads),          AV_OPT_TYPE_INT,       {.i64=0},       0, CODEC_POOL_MAX_JOBS },
+    { "fused_filtering",        NULL, OFFSET(fused_filtering),        AV_OPT_TYPE_INT,       {.i64=0},       0, 1 },
+    { "seek_precision",         NULL, OFFSET(seek_precision),         AV_OPT_TYPE_INT,       {.i64=SXPLAYER_SEEK_EXACT}, 0, NB_SXPLAYER_SEEK-1 },
+    { "lazy_filtering",         NULL, OFFSET(lazy_filtering),         AV_OPT_TYPE_INT,       {.i64=0},       0, 1 },
+    { "adaptive_seek_trigger",  NULL, OFFSET(adaptive_seek_trigger),  AV_OPT_TYPE_INT,       {.i64=0},       0, 1 },
+    { "intra_decoders",         NULL, OFFSET(intra_decoders),         AV_OPT_TYPE_INT,       {.i64=0},       0, MAX_INTRA_DECODERS },
     { NULL }
 };
 
@@ -157,6 +200,8 @@ static void free_context(struct sxplayer_ctx *s)
         return;
     av_freep(&s->filename);
     av_freep(&s->logname);
+    av_buffer_pool_uninit(&s->frame_pool);
+    av_freep(&s->links);
     sxpi_log_free(&s->log_ctx);
     av_opt_free(s);
     av_freep(&s);
@@ -168,6 +213,8 @@ static void free_temp_context_data(struct sxplayer_ctx *s)
     TRACE(s, "free temporary context data");
 
     av_frame_free(&s->cached_frame);
+    sxpi_frame_cache_free(&s->frame_cache);
+    s->frame_cache_served = 0;
 
     sxpi_async_free(&s->actx);
 
@@ -180,6 +227,25 @@ void sxplayer_set_log_callback(struct sxplayer_ctx *s, void *arg,
     sxpi_log_set_callback(s->log_ctx, arg, callback);
 }
 
+int sxplayer_set_frame_callback(struct sxplayer_ctx *s, void *arg,
+                                sxplayer_frame_callback_type callback)
+{
+    if (s->context_configured) {
+        LOG(s, ERROR, "Context is already configured, can not set the frame callback");
+        return AVERROR(EINVAL);
+    }
+    s->opts.frame_cb     = callback;
+    s->opts.frame_cb_arg = arg;
+    return 0;
+}
+
+int sxplayer_resume_frames(struct sxplayer_ctx *s)
+{
+    if (!s->context_configured)
+        return 0;
+    return sxpi_async_resume_frames(s->actx);
+}
+
 struct sxplayer_ctx *sxplayer_create(const char *filename)
 {
     const struct {
@@ -201,7 +267,8 @@ struct sxplayer_ctx *sxplayer_create(const char *filename)
 
     s->filename = av_strdup(filename);
     s->logname  = av_asprintf("sxplayer:%s", av_basename(filename));
-    if (!s->filename || !s->logname)
+    s->frame_pool = sxpi_frame_pool_init();
+    if (!s->filename || !s->logname || !s->frame_pool)
         goto fail;
 
     s->class = &sxplayer_class;
@@ -233,6 +300,12 @@ struct sxplayer_ctx *sxplayer_create(const char *filename)
     s->first_ts             = AV_NOPTS_VALUE;
     s->last_frame_poped_ts  = AV_NOPTS_VALUE;
     s->last_pushed_frame_ts = AV_NOPTS_VALUE;
+    s->frame_cache_prev_pts = AV_NOPTS_VALUE;
+    s->prefetch_vt          = AV_NOPTS_VALUE;
+    s->deadline             = AV_NOPTS_VALUE;
+    s->converging_vt        = AV_NOPTS_VALUE;
+    s->keyframe_vt          = AV_NOPTS_VALUE;
+    s->seek_overhead        = -1;
 
     av_assert0(!s->context_configured);
     return s;
@@ -242,6 +315,49 @@ fail:
     return NULL;
 }
 
+struct sxplayer_ctx *sxplayer_create_linked(struct sxplayer_ctx *s, int avselect)
+{
+    if (s->master)
+        s = s->master;
+
+    if (s->context_configured) {
+        LOG(s, ERROR, "Context is already configured, can not link another one");
+        return NULL;
+    }
+
+    struct sxplayer_ctx **links = av_realloc_array(s->links, s->nb_links + 1, sizeof(*links));
+    if (!links)
+        return NULL;
+    s->links = links;
+
+    struct sxplayer_ctx *link = sxplayer_create(s->filename);
+    if (!link)
+        return NULL;
+
+    if (sxplayer_set_option(link, "avselect", avselect) < 0) {
+        sxplayer_free(&link);
+        return NULL;
+    }
+
+    LOG(s, INFO, "linked context with avselect:%d", avselect);
+    s->links[s->nb_links++] = link;
+    link->master = s;
+    return link;
+}
+
+static void unlink_context(struct sxplayer_ctx *master, struct sxplayer_ctx *link)
+{
+    for (int i = 0; i < master->nb_links; i++) {
+        if (master->links[i] == link) {
+            memmove(&master->links[i], &master->links[i + 1],
+                    (master->nb_links - i - 1) * sizeof(*master->links));
+            master->nb_links--;
+            break;
+        }
+    }
+    link->master = NULL;
+}
+
 void sxplayer_free(struct sxplayer_ctx **ss)
 {
     struct sxplayer_ctx *s = *ss;
@@ -251,6 +367,17 @@ void sxplayer_free(struct sxplayer_ctx **ss)
 
     LOG(s, DEBUG, "destroying context");
 
+    /* The linked contexts have to leave the shared modules first, they will
+     * read the media on their own afterwards */
+    while (s->nb_links) {
+        struct sxplayer_ctx *link = s->links[0];
+        free_temp_context_data(link);
+        unlink_context(s, link);
+    }
+
+    if (s->master)
+        unlink_context(s->master, s);
+
     free_temp_context_data(s);
     free_context(s);
     *ss = NULL;
@@ -265,6 +392,8 @@ static int64_t get_media_time(const struct sxplayer_opts *o, int64_t t)
     return o->end_time64 == AV_NOPTS_VALUE ? mt : FFMIN(mt, o->end_time64);
 }
 
+#define DEFAULT_BACKWARD_FRAME_CACHE_SIZE 128
+
 static int set_context_fields(struct sxplayer_ctx *s)
 {
     struct sxplayer_opts *o = &s->opts;
@@ -285,6 +414,19 @@ static int set_context_fields(struct sxplayer_ctx *s)
         o->auto_hwaccel = 0;
     }
 
+    if (o->direction == SXPLAYER_DIRECTION_BACKWARD) {
+        if (o->auto_hwaccel) {
+            LOG(s, WARNING, "Backward direction relies on the frame cache, "
+                "disabling auto_hwaccel since hardware frames can not be cached");
+            o->auto_hwaccel = 0;
+        }
+        if (!o->frame_cache_size) {
+            o->frame_cache_size = DEFAULT_BACKWARD_FRAME_CACHE_SIZE;
+            LOG(s, INFO, "Backward direction requires the frame cache, "
+                "using frame_cache_size=%d", o->frame_cache_size);
+        }
+    }
+
     LOG(s, INFO, "avselect:%d start_time:%f end_time:%f "
         "dist_time_seek_trigger:%f queues:[%d %d %d] filters:'%s'",
         o->avselect, o->start_time, o->end_time,
@@ -327,15 +469,33 @@ static int set_context_fields(struct sxplayer_ctx *s)
           PTS2TIMESTR(o->end_time64),
           PTS2TIMESTR(o->dist_time_seek_trigger64));
 
+    if (o->frame_cache_size) {
+        av_assert0(!s->frame_cache);
+        s->frame_cache = sxpi_frame_cache_alloc();
+        if (!s->frame_cache)
+            return AVERROR(ENOMEM);
+        int ret = sxpi_frame_cache_init(s->frame_cache, (int64_t)o->frame_cache_size << 20,
+                                         o->use_pkt_duration);
+        if (ret < 0)
+            return ret;
+    }
+
     av_assert0(!s->actx);
     s->actx = sxpi_async_alloc_context();
     if (!s->actx)
         return AVERROR(ENOMEM);
 
-    int ret = sxpi_async_init(s->actx, s->log_ctx, s->filename, &s->opts);
+    int ret = s->master ? sxpi_async_init_linked(s->actx, s->log_ctx, &s->opts, s->frame_pool, s->master->actx)
+                        : sxpi_async_init(s->actx, s->log_ctx, s->filename, &s->opts, s->frame_pool);
     if (ret < 0)
         return ret;
 
+    if (s->skip_frame != AVDISCARD_DEFAULT) {
+        ret = sxpi_async_set_skip_frame(s->actx, s->skip_frame);
+        if (ret < 0)
+            return ret;
+    }
+
     s->context_configured = 1;
 
     return 0;
@@ -348,13 +508,21 @@ static int set_context_fields(struct sxplayer_ctx *s)
  */
 static int configure_context(struct sxplayer_ctx *s)
 {
+    /* Linked contexts share the modules, so they are configured all at once */
+    if (s->master)
+        return configure_context(s->master);
+
     if (s->context_configured)
         return 1;
 
     TRACE(s, "set context fields");
     int ret = set_context_fields(s);
+    for (int i = 0; i < s->nb_links && ret >= 0; i++)
+        ret = set_context_fields(s->links[i]);
     if (ret < 0) {
         LOG(s, ERROR, "Unable to set context fields: %s", av_err2str(ret));
+        for (int i = 0; i < s->nb_links; i++)
+            free_temp_context_data(s->links[i]);
         free_temp_context_data(s);
         return ret;
     }
@@ -362,105 +530,6 @@ static int configure_context(struct sxplayer_ctx *s)
     return 0;
 }
 
-static const int col_spc_map[] = {
-    [AVCOL_SPC_RGB]                = SXPLAYER_COL_SPC_RGB,
-    [AVCOL_SPC_BT709]              = SXPLAYER_COL_SPC_BT709,
-    [AVCOL_SPC_UNSPECIFIED]        = SXPLAYER_COL_SPC_UNSPECIFIED,
-    [AVCOL_SPC_RESERVED]           = SXPLAYER_COL_SPC_RESERVED,
-    [AVCOL_SPC_FCC]                = SXPLAYER_COL_SPC_FCC,
-    [AVCOL_SPC_BT470BG]            = SXPLAYER_COL_SPC_BT470BG,
-    [AVCOL_SPC_SMPTE170M]          = SXPLAYER_COL_SPC_SMPTE170M,
-    [AVCOL_SPC_SMPTE240M]          = SXPLAYER_COL_SPC_SMPTE240M,
-    [AVCOL_SPC_YCGCO]              = SXPLAYER_COL_SPC_YCGCO,
-    [AVCOL_SPC_BT2020_NCL]         = SXPLAYER_COL_SPC_BT2020_NCL,
-    [AVCOL_SPC_BT2020_CL]          = SXPLAYER_COL_SPC_BT2020_CL,
-    [AVCOL_SPC_SMPTE2085]          = SXPLAYER_COL_SPC_SMPTE2085,
-    [AVCOL_SPC_CHROMA_DERIVED_NCL] = SXPLAYER_COL_SPC_CHROMA_DERIVED_NCL,
-    [AVCOL_SPC_CHROMA_DERIVED_CL]  = SXPLAYER_COL_SPC_CHROMA_DERIVED_CL,
-    [AVCOL_SPC_ICTCP]              = SXPLAYER_COL_SPC_ICTCP,
-};
-
-SXPI_STATIC_ASSERT(col_spc_map, FF_ARRAY_ELEMS(col_spc_map) < 32);
-
-static int get_sxplayer_col_spc(int avcol_spc)
-{
-    if (avcol_spc < 0 || avcol_spc >= FF_ARRAY_ELEMS(col_spc_map))
-        return SXPLAYER_COL_SPC_UNSPECIFIED;
-    return col_spc_map[avcol_spc];
-}
-
-static const int col_rng_map[] = {
-    [AVCOL_RANGE_UNSPECIFIED] = SXPLAYER_COL_RNG_UNSPECIFIED,
-    [AVCOL_RANGE_MPEG]        = SXPLAYER_COL_RNG_LIMITED,
-    [AVCOL_RANGE_JPEG]        = SXPLAYER_COL_RNG_FULL,
-};
-
-SXPI_STATIC_ASSERT(col_rng_map, FF_ARRAY_ELEMS(col_rng_map) < 32);
-
-static int get_sxplayer_col_rng(int avcol_rng)
-{
-    if (avcol_rng < 0 || avcol_rng >= FF_ARRAY_ELEMS(col_rng_map))
-        return SXPLAYER_COL_RNG_UNSPECIFIED;
-    return col_rng_map[avcol_rng];
-}
-
-static const int col_pri_map[] = {
-    [AVCOL_PRI_RESERVED0]   = SXPLAYER_COL_PRI_RESERVED0,
-    [AVCOL_PRI_BT709]       = SXPLAYER_COL_PRI_BT709,
-    [AVCOL_PRI_UNSPECIFIED] = SXPLAYER_COL_PRI_UNSPECIFIED,
-    [AVCOL_PRI_RESERVED]    = SXPLAYER_COL_PRI_RESERVED,
-    [AVCOL_PRI_BT470M]      = SXPLAYER_COL_PRI_BT470M,
-    [AVCOL_PRI_BT470BG]     = SXPLAYER_COL_PRI_BT470BG,
-    [AVCOL_PRI_SMPTE170M]   = SXPLAYER_COL_PRI_SMPTE170M,
-    [AVCOL_PRI_SMPTE240M]   = SXPLAYER_COL_PRI_SMPTE240M,
-    [AVCOL_PRI_FILM]        = SXPLAYER_COL_PRI_FILM,
-    [AVCOL_PRI_BT2020]      = SXPLAYER_COL_PRI_BT2020,
-    [AVCOL_PRI_SMPTE428]    = SXPLAYER_COL_PRI_SMPTE428,
-    [AVCOL_PRI_SMPTE431]    = SXPLAYER_COL_PRI_SMPTE431,
-    [AVCOL_PRI_SMPTE432]    = SXPLAYER_COL_PRI_SMPTE432,
-    [AVCOL_PRI_JEDEC_P22]   = SXPLAYER_COL_PRI_JEDEC_P22,
-};
-
-SXPI_STATIC_ASSERT(col_pri_map, FF_ARRAY_ELEMS(col_pri_map) < 32);
-
-static int get_sxplayer_col_pri(int avcol_pri)
-{
-    if (avcol_pri < 0 || avcol_pri >= FF_ARRAY_ELEMS(col_pri_map))
-        return SXPLAYER_COL_PRI_UNSPECIFIED;
-    return col_pri_map[avcol_pri];
-}
-
-static const int col_trc_map[] = {
-    [AVCOL_TRC_RESERVED0]    = SXPLAYER_COL_TRC_RESERVED0,
-    [AVCOL_TRC_BT709]        = SXPLAYER_COL_TRC_BT709,
-    [AVCOL_TRC_UNSPECIFIED]  = SXPLAYER_COL_TRC_UNSPECIFIED,
-    [AVCOL_TRC_RESERVED]     = SXPLAYER_COL_TRC_RESERVED,
-    [AVCOL_TRC_GAMMA22]      = SXPLAYER_COL_TRC_GAMMA22,
-    [AVCOL_TRC_GAMMA28]      = SXPLAYER_COL_TRC_GAMMA28,
-    [AVCOL_TRC_SMPTE170M]    = SXPLAYER_COL_TRC_SMPTE170M,
-    [AVCOL_TRC_SMPTE240M]    = SXPLAYER_COL_TRC_SMPTE240M,
-    [AVCOL_TRC_LINEAR]       = SXPLAYER_COL_TRC_LINEAR,
-    [AVCOL_TRC_LOG]          = SXPLAYER_COL_TRC_LOG,
-    [AVCOL_TRC_LOG_SQRT]     = SXPLAYER_COL_TRC_LOG_SQRT,
-    [AVCOL_TRC_IEC61966_2_4] = SXPLAYER_COL_TRC_IEC61966_2_4,
-    [AVCOL_TRC_BT1361_ECG]   = SXPLAYER_COL_TRC_BT1361_ECG,
-    [AVCOL_TRC_IEC61966_2_1] = SXPLAYER_COL_TRC_IEC61966_2_1,
-    [AVCOL_TRC_BT2020_10]    = SXPLAYER_COL_TRC_BT2020_10,
-    [AVCOL_TRC_BT2020_12]    = SXPLAYER_COL_TRC_BT2020_12,
-    [AVCOL_TRC_SMPTE2084]    = SXPLAYER_COL_TRC_SMPTE2084,
-    [AVCOL_TRC_SMPTE428]     = SXPLAYER_COL_TRC_SMPTE428,
-    [AVCOL_TRC_ARIB_STD_B67] = SXPLAYER_COL_TRC_ARIB_STD_B67,
-};
-
-SXPI_STATIC_ASSERT(col_trc_map, FF_ARRAY_ELEMS(col_trc_map) < 32);
-
-static int get_sxplayer_col_trc(int avcol_trc)
-{
-    if (avcol_trc < 0 || avcol_trc >= FF_ARRAY_ELEMS(col_trc_map))
-        return SXPLAYER_COL_TRC_UNSPECIFIED;
-    return col_trc_map[avcol_trc];
-}
-
 #define START_FUNC_BASE(name, ...) do {                     \
     s->cur_func_name = name;                                \
     if (LOG_LEVEL >= AV_LOG_WARNING)                        \
@@ -484,6 +553,24 @@ static int get_sxplayer_col_trc(int avcol_trc)
 #define MAX_ASYNC_OP_TIME (10/1000.)
 #define MAX_SYNC_OP_TIME  (1/60.)
 
+/*
+ * Stream timebase must be known when this function is called.
+ */
+static inline int64_t stream_time(const struct sxplayer_ctx *s, int64_t t)
+{
+    av_assert0(s->st_timebase.den);
+    return av_rescale_q(t, AV_TIME_BASE_Q, s->st_timebase);
+}
+
+/*
+ * Media time of a stream timestamp, rounded up so that seeking to it does not
+ * alter the timestamp of the frame.
+ */
+static inline int64_t media_time(const struct sxplayer_ctx *s, int64_t ts)
+{
+    return av_rescale_q_rnd(ts, s->st_timebase, AV_TIME_BASE_Q, AV_ROUND_UP);
+}
+
 /* Return the frame only if different from previous one. We do not make a
  * simple pointer check because of the frame reference counting (and thus
  * pointer reuse, depending on many parameters)  */
@@ -492,6 +579,14 @@ static struct sxplayer_frame *ret_frame(struct sxplayer_ctx *s, AVFrame *frame)
     struct sxplayer_frame *ret = NULL;
     const struct sxplayer_opts *o = &s->opts;
 
+    if (!s->timed_out) {
+        s->converging_vt = AV_NOPTS_VALUE;
+        s->keyframe_vt = AV_NOPTS_VALUE;
+    }
+
+    if (s->context_configured)
+        sxpi_async_update_event(s->actx, !!s->cached_frame);
+
     if (!frame) {
         LOG(s, DEBUG, "no frame to return");
         goto end;
@@ -508,66 +603,43 @@ static struct sxplayer_frame *ret_frame(struct sxplayer_ctx *s, AVFrame *frame)
     /* if same frame as previously, do not raise it again */
     if (s->last_pushed_frame_ts == frame_ts) {
         LOG(s, DEBUG, "same frame as previously, return NULL");
+        s->auto_drop_nb_repeated++;
         av_frame_free(&frame);
         goto end;
     }
 
-    ret = av_mallocz(sizeof(*ret));
-    if (!ret) {
+    /* With lazy filtering, only the frames returned go through the filters */
+    const int err = sxpi_async_convert_frame(s->actx, &frame);
+    if (err < 0) {
+        LOG(s, ERROR, "Unable to filter the frame: %s", av_err2str(err));
         av_frame_free(&frame);
         goto end;
     }
 
+    ret = sxpi_frame_wrap(s->frame_pool, frame, s->st_timebase, o);
+    if (!ret) {
+        LOG(s, ERROR, "Unable to wrap the frame");
+        goto end;
+    }
+
     s->last_pushed_frame_ts = frame_ts;
 
-    AVFrameSideData *sd = av_frame_get_side_data(frame, AV_FRAME_DATA_MOTION_VECTORS);
-    if (sd) {
-        ret->mvs = av_memdup(sd->data, sd->size);
-        if (!ret->mvs) {
-            LOG(s, ERROR, "Unable to memdup motion vectors side data");
-            av_frame_free(&frame);
-            av_freep(&ret);
-            goto end;
-        }
-        ret->nb_mvs = sd->size / sizeof(AVMotionVector);
+    /* The pipeline keeps decoding from this frame */
+    if (s->timed_out)
+        s->converging_vt = media_time(s, frame_ts);
+
+    if (ret->nb_mvs)
         TRACE(s, "export %d motion vectors", ret->nb_mvs);
-    }
 
-    ret->internal = frame;
-    ret->data = frame->data[0];
-    ret->linesize = frame->linesize[0];
-    memcpy(ret->datap, frame->data, sizeof(ret->datap));
-    memcpy(ret->linesizep, frame->linesize, sizeof(ret->linesizep));
-    ret->pts      = frame_ts;
-    ret->ms       = av_rescale_q(frame_ts, AV_TIME_BASE_Q, s->st_timebase);
-    ret->ts       = frame_ts * av_q2d(s->st_timebase);
-    ret->color_space     = get_sxplayer_col_spc(frame->colorspace);
-    ret->color_range     = get_sxplayer_col_rng(frame->color_range);
-    ret->color_primaries = get_sxplayer_col_pri(frame->color_primaries);
-    ret->color_trc       = get_sxplayer_col_trc(frame->color_trc);
     if (o->avselect == SXPLAYER_SELECT_VIDEO) {
-        if (frame->format == AV_PIX_FMT_VIDEOTOOLBOX ||
-            frame->format == AV_PIX_FMT_VAAPI        ||
-            frame->format == AV_PIX_FMT_MEDIACODEC) {
-            ret->data = frame->data[3];
-            ret->datap[0] = frame->data[3];
-        }
-        ret->width   = frame->width;
-        ret->height  = frame->height;
-        ret->pix_fmt = sxpi_pix_fmts_ff2sx(frame->format);
         LOG(s, DEBUG, "return %dx%d video frame @ ts=%s",
-            frame->width, frame->height, av_ts2timestr(frame_ts, &s->st_timebase));
+            ret->width, ret->height, av_ts2timestr(frame_ts, &s->st_timebase));
     } else if (o->avselect == SXPLAYER_SELECT_AUDIO && o->audio_texture) {
-        ret->width   = frame->width;
-        ret->height  = frame->height;
-        ret->pix_fmt = SXPLAYER_SMPFMT_FLT;
         LOG(s, DEBUG, "return %dx%d audio tex frame @ ts=%s",
-            frame->width, frame->height, av_ts2timestr(frame_ts, &s->st_timebase));
+            ret->width, ret->height, av_ts2timestr(frame_ts, &s->st_timebase));
     } else {
-        ret->nb_samples = frame->nb_samples;
-        ret->pix_fmt = sxpi_smp_fmts_ff2sx(frame->format);
         LOG(s, DEBUG, "return %d samples audio frame @ ts=%s",
-            frame->nb_samples, av_ts2timestr(frame_ts, &s->st_timebase));
+            ret->nb_samples, av_ts2timestr(frame_ts, &s->st_timebase));
     }
 
 end:
@@ -577,17 +649,93 @@ end:
 
 void sxplayer_release_frame(struct sxplayer_frame *frame)
 {
-    if (frame) {
-        AVFrame *avframe = frame->internal;
-        av_frame_free(&avframe);
-        av_freep(&frame->mvs);
-        av_free(frame);
-    }
+    if (frame)
+        sxpi_frame_release(frame);
+}
+
+static const enum AVDiscard skip_frame_map[] = {
+    [SXPLAYER_DROP_NONE]   = AVDISCARD_DEFAULT,
+    [SXPLAYER_DROP_NONREF] = AVDISCARD_NONREF,
+    [SXPLAYER_DROP_NONKEY] = AVDISCARD_NONKEY,
+    [SXPLAYER_DROP_AUTO]   = AVDISCARD_DEFAULT,
+};
+
+SXPI_STATIC_ASSERT(skip_frame_map, FF_ARRAY_ELEMS(skip_frame_map) == NB_SXPLAYER_DROP_REF);
+
+static int set_skip_frame(struct sxplayer_ctx *s, enum AVDiscard skip_frame)
+{
+    if (s->skip_frame == skip_frame)
+        return 0;
+    s->skip_frame = skip_frame;
+
+    /* Otherwise honored when the context gets configured */
+    if (!s->context_configured)
+        return 0;
+    return sxpi_async_set_skip_frame(s->actx, skip_frame);
 }
 
 int sxplayer_set_drop_ref(struct sxplayer_ctx *s, int drop)
 {
-    return -1; // TODO
+    START_FUNC("SET DROP REF");
+
+    if (drop < 0 || drop >= NB_SXPLAYER_DROP_REF) {
+        LOG(s, ERROR, "Invalid drop mode %d", drop);
+        return AVERROR(EINVAL);
+    }
+
+    s->drop_ref = drop;
+    s->auto_drop_nb_requests  = 0;
+    s->auto_drop_nb_discarded = 0;
+    s->auto_drop_nb_repeated  = 0;
+
+    int ret = set_skip_frame(s, skip_frame_map[drop]);
+    END_FUNC(MAX_ASYNC_OP_TIME);
+    return ret;
+}
+
+int sxplayer_set_seek_precision(struct sxplayer_ctx *s, int precision)
+{
+    if (precision < 0 || precision >= NB_SXPLAYER_SEEK) {
+        LOG(s, ERROR, "Invalid seek precision %d", precision);
+        return AVERROR(EINVAL);
+    }
+
+    /* Only read by the user thread when requesting a seek, so it is not
+     * locked with the other options once the context is configured */
+    s->opts.seek_precision = precision;
+    return 0;
+}
+
+#define AUTO_DROP_NB_REQUESTS 16
+
+/*
+ * The user is considered behind the decoding when each request skips at least
+ * one decoded frame on average. Once the non reference frames are dropped, it
+ * is considered caught up when half of the requests get the same frame again.
+ */
+static void update_auto_drop(struct sxplayer_ctx *s)
+{
+    if (s->drop_ref != SXPLAYER_DROP_AUTO || ++s->auto_drop_nb_requests < AUTO_DROP_NB_REQUESTS)
+        return;
+
+    enum AVDiscard skip_frame = s->skip_frame;
+    if (skip_frame == AVDISCARD_DEFAULT && s->auto_drop_nb_discarded >= s->auto_drop_nb_requests)
+        skip_frame = AVDISCARD_NONREF;
+    else if (skip_frame == AVDISCARD_NONREF && s->auto_drop_nb_repeated * 2 >= s->auto_drop_nb_requests)
+        skip_frame = AVDISCARD_DEFAULT;
+
+    if (skip_frame != s->skip_frame) {
+        LOG(s, DEBUG, "%s dropping non reference frames (%d frames skipped, %d repeated in %d requests)",
+            skip_frame == AVDISCARD_NONREF ? "start" : "stop",
+            s->auto_drop_nb_discarded, s->auto_drop_nb_repeated, s->auto_drop_nb_requests);
+        int ret = set_skip_frame(s, skip_frame);
+        if (ret < 0)
+            LOG(s, ERROR, "Unable to change the skip frame level: %s", av_err2str(ret));
+    }
+
+    s->auto_drop_nb_requests  = 0;
+    s->auto_drop_nb_discarded = 0;
+    s->auto_drop_nb_repeated  = 0;
 }
 
 static AVFrame *pop_frame(struct sxplayer_ctx *s)
@@ -604,7 +752,9 @@ static AVFrame *pop_frame(struct sxplayer_ctx *s)
         if (!s->st_timebase.den) {
             struct sxplayer_info info;
             int ret = sxpi_async_fetch_info(s->actx, &info);
-            if (ret < 0) {
+            if (ret == AVERROR(EAGAIN)) {
+                s->timed_out = 1;
+            } else if (ret < 0) {
                 TRACE(s, "unable to fetch info %s", av_err2str(ret));
             } else {
                 s->st_timebase = av_make_q(info.timebase[0], info.timebase[1]);
@@ -616,8 +766,26 @@ static AVFrame *pop_frame(struct sxplayer_ctx *s)
 
         if (s->st_timebase.den) {
             int ret = sxpi_async_pop_frame(s->actx, &frame);
+            if (ret == AVERROR(EAGAIN)) {
+                TRACE(s, "no frame available before the deadline");
+                s->timed_out = 1;
+                return NULL;
+            }
             if (ret < 0)
                 TRACE(s, "poped a message raising %s", av_err2str(ret));
+        } else if (s->timed_out) {
+            return NULL;
+        }
+
+        if (s->frame_cache) {
+            if (frame) {
+                int ret = sxpi_frame_cache_add(s->frame_cache, frame, s->frame_cache_prev_pts);
+                if (ret < 0)
+                    LOG(s, WARNING, "Unable to add frame to the cache: %s", av_err2str(ret));
+                s->frame_cache_prev_pts = frame->pts;
+            } else {
+                s->frame_cache_prev_pts = AV_NOPTS_VALUE;
+            }
         }
     }
 
@@ -640,6 +808,33 @@ static AVFrame *pop_frame(struct sxplayer_ctx *s)
     return frame;
 }
 
+/* Timestamp of the next frame the pipeline will deliver, or of the latest one
+ * it delivered if it is not known yet */
+static int64_t get_head_ts(const struct sxplayer_ctx *s)
+{
+    return s->cached_frame ? s->cached_frame->pts : s->last_frame_poped_ts;
+}
+
+/* The frame cache keeps every decoded frame, so the decoder is only told
+ * which one the user waits for without it */
+static void set_wanted_ts(struct sxplayer_ctx *s, int64_t ts)
+{
+    if (!s->frame_cache)
+        sxpi_async_set_wanted_ts(s->actx, ts);
+}
+
+/* Every seek breaks the contiguity of the frames poped from the pipeline */
+static int async_seek(struct sxplayer_ctx *s, int64_t vt, int precision)
+{
+    set_wanted_ts(s, AV_NOPTS_VALUE);
+    s->frame_cache_prev_pts = AV_NOPTS_VALUE;
+    s->frame_cache_served = 0;
+    s->prefetch_vt = AV_NOPTS_VALUE;
+    s->converging_vt = vt;
+    s->keyframe_vt = precision == SXPLAYER_SEEK_KEYFRAME ? vt : AV_NOPTS_VALUE;
+    return sxpi_async_seek(s->actx, vt, precision);
+}
+
 #define SYNTH_FRAME 0
 
 #if SYNTH_FRAME
@@ -672,7 +867,7 @@ int sxplayer_seek(struct sxplayer_ctx *s, double reqt)
         return ret;
 
     const struct sxplayer_opts *o = &s->opts;
-    ret = sxpi_async_seek(s->actx, get_media_time(o, TIME2INT64(reqt)));
+    ret = async_seek(s, get_media_time(o, TIME2INT64(reqt)), o->seek_precision);
     END_FUNC(MAX_ASYNC_OP_TIME);
     return ret;
 }
@@ -683,11 +878,17 @@ int sxplayer_stop(struct sxplayer_ctx *s)
 
     av_frame_free(&s->cached_frame);
     s->last_pushed_frame_ts = AV_NOPTS_VALUE;
+    s->frame_cache_prev_pts = AV_NOPTS_VALUE;
+    s->frame_cache_served = 0;
+    s->prefetch_vt = AV_NOPTS_VALUE;
+    s->converging_vt = AV_NOPTS_VALUE;
+    s->keyframe_vt = AV_NOPTS_VALUE;
 
     int ret = configure_context(s);
     if (ret < 0)
         return ret;
 
+    set_wanted_ts(s, AV_NOPTS_VALUE);
     ret = sxpi_async_stop(s->actx);
     END_FUNC(MAX_ASYNC_OP_TIME);
     return ret;
@@ -706,13 +907,131 @@ int sxplayer_start(struct sxplayer_ctx *s)
     return ret;
 }
 
+/* Media time from which all the frames up to vt can be decoded */
+static int64_t get_gop_start(struct sxplayer_ctx *s, int64_t vt)
+{
+    const struct sxplayer_opts *o = &s->opts;
+    int64_t kf_pts, gop_start;
+
+    if (sxpi_async_get_prev_keyframe(s->actx, stream_time(s, vt), &kf_pts) > 0) {
+        gop_start = FFMIN(media_time(s, kf_pts), vt);
+    } else {
+        /* The keyframe will be known to the index once the demuxer reached
+         * it, so this is only a guess for the first GOP in a region */
+        const int64_t dist = o->dist_time_seek_trigger64 > 0 ? o->dist_time_seek_trigger64 : AV_TIME_BASE;
+        gop_start = vt - dist;
+    }
+    return FFMAX(gop_start, o->start_time64);
+}
+
 /*
- * Stream timebase must be known when this function is called.
+ * In backward direction, the GOP containing the requested time is decoded
+ * forward into the frame cache once, the next requests being served from
+ * there. The previous GOP is then prefetched by the pipeline while the
+ * current one is drained.
  */
-static inline int64_t stream_time(const struct sxplayer_ctx *s, int64_t t)
+static struct sxplayer_frame *get_frame_backward(struct sxplayer_ctx *s, int64_t vt)
 {
-    av_assert0(s->st_timebase.den);
-    return av_rescale_q(t, AV_TIME_BASE_Q, s->st_timebase);
+    const struct sxplayer_opts *o = &s->opts;
+    const int64_t stt = stream_time(s, vt);
+
+    AVFrame *frame = sxpi_frame_cache_get(s->frame_cache, stt);
+    if (frame) {
+        TRACE(s, "frame cache hit with frame %s", av_ts2timestr(frame->pts, &s->st_timebase));
+        s->frame_cache_hits++;
+        if (frame->pts != s->last_pushed_frame_ts)
+            s->frame_cache_served = 1;
+        return ret_frame(s, frame);
+    }
+    s->frame_cache_misses++;
+
+    const int64_t gop_start = get_gop_start(s, vt);
+    if (gop_start == s->prefetch_vt) {
+        TRACE(s, "GOP starting at %s is already prefetched", PTS2TIMESTR(gop_start));
+        s->prefetch_vt = AV_NOPTS_VALUE;
+    } else {
+        TRACE(s, "decode GOP starting at %s", PTS2TIMESTR(gop_start));
+        av_frame_free(&s->cached_frame);
+        int ret = async_seek(s, gop_start, SXPLAYER_SEEK_EXACT);
+        if (ret < 0)
+            return ret_frame(s, NULL);
+    }
+
+    /* Decode up to the frame following the requested time so the frame cache
+     * knows until when the candidate is displayed */
+    AVFrame *candidate = NULL;
+    for (;;) {
+        AVFrame *next = pop_frame(s);
+        if (!next)
+            break;
+        if (next->pts > stt) {
+            if (!candidate)
+                candidate = next;
+            else
+                av_frame_free(&next);
+            break;
+        }
+        av_frame_free(&candidate);
+        candidate = next;
+    }
+
+    if (s->timed_out) {
+        TRACE(s, "deadline reached, resume the GOP decoding on next request");
+        s->prefetch_vt = gop_start;
+    } else if (gop_start > o->start_time64) {
+        const int64_t prev_gop_start = get_gop_start(s, gop_start - 1);
+        TRACE(s, "prefetch previous GOP starting at %s", PTS2TIMESTR(prev_gop_start));
+        if (async_seek(s, prev_gop_start, SXPLAYER_SEEK_EXACT) >= 0)
+            s->prefetch_vt = prev_gop_start;
+    }
+
+    if (candidate)
+        s->frame_cache_served = 1;
+    return ret_frame(s, candidate);
+}
+
+/* Only the decoding of at least that much media time gives a meaningful
+ * measure, the first frames coming out of the queues right away */
+#define COST_MIN_MEDIA_TIME (AV_TIME_BASE / 2)
+#define COST_EMA_WEIGHT 8
+
+static double update_cost(double cost, double sample)
+{
+    return cost > 0 ? cost + (sample - cost) / COST_EMA_WEIGHT : sample;
+}
+
+/* Media time (in seconds) the decoder goes through to reach vt after a seek,
+ * -1 if the keyframe preceding vt is not known */
+static double get_seek_decode_time(struct sxplayer_ctx *s, int64_t vt)
+{
+    int64_t kf_pts;
+    const int64_t stt = stream_time(s, vt);
+    if (sxpi_async_get_prev_keyframe(s->actx, stt, &kf_pts) <= 0)
+        return -1;
+    return FFMAX(stt - kf_pts, 0) * av_q2d(s->st_timebase);
+}
+
+/*
+ * Decide whether moving forward to vt, seek_diff (in stream time base) ahead
+ * of the pipeline position, is done with a seek. With the adaptive trigger,
+ * a seek costs its overhead plus the decoding from the keyframe preceding vt,
+ * against the decoding of the whole distance otherwise; this falls back on
+ * dist_time_seek_trigger until both costs are measured.
+ */
+static int is_forward_seek_cheaper(struct sxplayer_ctx *s, int64_t vt, int64_t seek_diff)
+{
+    const struct sxplayer_opts *o = &s->opts;
+
+    if (o->adaptive_seek_trigger && s->decode_speed > 0 && s->seek_overhead >= 0) {
+        const double seek_decode_time = get_seek_decode_time(s, vt);
+        if (seek_decode_time >= 0) {
+            const double seek_cost = s->seek_overhead + seek_decode_time * s->decode_speed;
+            const double decode_cost = seek_diff * av_q2d(s->st_timebase) * s->decode_speed;
+            TRACE(s, "seek cost: %fs, decoding cost: %fs", seek_cost, decode_cost);
+            return seek_cost < decode_cost;
+        }
+    }
+    return av_compare_ts(seek_diff, s->st_timebase, o->dist_time_seek_trigger64, AV_TIME_BASE_Q) >= 0;
 }
 
 struct sxplayer_frame *sxplayer_get_frame_ms(struct sxplayer_ctx *s, int64_t t64)
@@ -722,19 +1041,33 @@ struct sxplayer_frame *sxplayer_get_frame_ms(struct sxplayer_ctx *s, int64_t t64
 
     START_FUNC_T("GET FRAME", t64 / 1000000.);
 
+    s->timed_out = 0;
+
 #if SYNTH_FRAME
     return ret_synth_frame(s, t64);
 #endif
 
+    if (o->frame_cb) {
+        LOG(s, ERROR, "Frames are delivered through the frame callback");
+        return ret_frame(s, NULL);
+    }
+
     int ret = configure_context(s);
     if (ret < 0)
         return ret_frame(s, NULL);
 
+    sxpi_async_set_deadline(s->actx, s->deadline);
+
+    /* The previous request may have been further than this one */
+    set_wanted_ts(s, AV_NOPTS_VALUE);
+
     if (t64 < 0) {
         sxplayer_start(s);
         return ret_frame(s, NULL);
     }
 
+    update_auto_drop(s);
+
     const int64_t vt = get_media_time(o, t64);
     TRACE(s, "t=%s -> vt=%s", PTS2TIMESTR(t64), PTS2TIMESTR(vt));
 
@@ -750,6 +1083,42 @@ struct sxplayer_frame *sxplayer_get_frame_ms(struct sxplayer_ctx *s, int64_t t64
         return ret_frame(s, NULL);
     }
 
+    if (o->direction == SXPLAYER_DIRECTION_BACKWARD && s->last_pushed_frame_ts != AV_NOPTS_VALUE &&
+        stream_time(s, vt) < s->last_pushed_frame_ts)
+        return get_frame_backward(s, vt);
+
+    /* Frames behind the pipeline can only be served by the frame cache; if
+     * the latest frame returned already came from it, the pipeline can not
+     * be used to move backward either, so a miss implies a seek. */
+    int force_seek = 0;
+    int64_t head_ts = AV_NOPTS_VALUE;
+    if (s->frame_cache && s->last_pushed_frame_ts != AV_NOPTS_VALUE) {
+        const int64_t stt = stream_time(s, vt);
+        head_ts = get_head_ts(s);
+        if (stt < head_ts) {
+            AVFrame *frame = sxpi_frame_cache_get(s->frame_cache, stt);
+            if (frame) {
+                TRACE(s, "frame cache hit with frame %s", av_ts2timestr(frame->pts, &s->st_timebase));
+                s->frame_cache_hits++;
+                if (frame->pts != s->last_pushed_frame_ts)
+                    s->frame_cache_served = 1;
+                return ret_frame(s, frame);
+            }
+            TRACE(s, "frame cache miss");
+            s->frame_cache_misses++;
+            force_seek = s->frame_cache_served;
+        } else if (s->frame_cache_served && !s->cached_frame) {
+            /* The latest frame poped from the pipeline was never returned
+             * (or was overridden), we need it back to resume from there */
+            s->cached_frame = sxpi_frame_cache_get_exact(s->frame_cache, head_ts);
+            force_seek = !s->cached_frame;
+        }
+    }
+
+    /* The pipeline is busy decoding a previous GOP */
+    if (s->prefetch_vt != AV_NOPTS_VALUE)
+        force_seek = 1;
+
     AVFrame *candidate = NULL;
 
     /* If no frame was ever pushed, we need to pop one */
@@ -763,7 +1132,7 @@ struct sxplayer_frame *sxplayer_get_frame_ms(struct sxplayer_ctx *s, int64_t t64
         if (!sxpi_sxpi_async_started(s->actx) && vt > o->start_time64) {
             TRACE(s, "no prefetch, but requested time (%s) beyond initial start_time (%s)",
                   PTS2TIMESTR(vt), PTS2TIMESTR(o->start_time64));
-            sxpi_async_seek(s->actx, vt);
+            async_seek(s, vt, o->seek_precision);
         }
 
         TRACE(s, "no frame ever pushed yet, pop a candidate");
@@ -773,6 +1142,11 @@ struct sxplayer_frame *sxplayer_get_frame_ms(struct sxplayer_ctx *s, int64_t t64
             return ret_frame(s, NULL);
         }
 
+        if (s->keyframe_vt == vt) {
+            TRACE(s, "keyframe seek, return the first frame");
+            return ret_frame(s, candidate);
+        }
+
         /* At this point we can assume the stream timebase is known because
          * pop_frame() was called. */
         const int64_t stt = stream_time(s, vt);
@@ -811,16 +1185,37 @@ struct sxplayer_frame *sxplayer_get_frame_ms(struct sxplayer_ctx *s, int64_t t64
     if (!diff)
         return ret_frame(s, candidate);
 
-    /* Check if a seek is needed */
-    const int forward_seek = av_compare_ts(diff, s->st_timebase, o->dist_time_seek_trigger64, AV_TIME_BASE_Q) >= 0;
-    if (diff < 0 || forward_seek) {
-        if (diff < 0)
+    /* Check if a seek is needed; when the latest frame comes from the frame
+     * cache, the decoding resumes from the pipeline position instead */
+    const int64_t seek_diff = s->frame_cache_served ? stream_time(s, vt) - head_ts : diff;
+    const int forward_seek = force_seek || (diff > 0 && is_forward_seek_cheaper(s, vt, seek_diff));
+
+    /* A previous request reached its deadline while the pipeline was moving
+     * toward a time from which this one can be reached without seeking */
+    const int converging = !force_seek && s->converging_vt != AV_NOPTS_VALUE &&
+                           vt >= s->converging_vt && vt - s->converging_vt < o->dist_time_seek_trigger64;
+    if (converging)
+        TRACE(s, "pipeline is converging toward %s, no seek needed", PTS2TIMESTR(s->converging_vt));
+
+    /* The costs of the seeks and of the forward decoding are measured on the
+     * requests reaching their frame */
+    const int64_t start_time = av_gettime_relative();
+    const int64_t start_head = stream_time(s, vt) - seek_diff;
+    double seek_decode_time = -1;
+    const int seeking = !converging && (diff < 0 || forward_seek);
+
+    if (seeking) {
+        if (diff < 0) {
             TRACE(s, "diff %s [%"PRId64"] < 0 request backward seek",
                   av_ts2timestr(diff, &s->st_timebase), diff);
-        else
+        } else {
             TRACE(s, "diff %s > %s request future seek",
                   av_ts2timestr(diff, &s->st_timebase),
                   PTS2TIMESTR(o->dist_time_seek_trigger64));
+            s->nb_forward_seeks++;
+        }
+        if (o->adaptive_seek_trigger)
+            seek_decode_time = get_seek_decode_time(s, vt);
 
         /* If we never returned a frame and got a candidate, we do not free it
          * immediately, because after the seek we might not actually get
@@ -839,13 +1234,32 @@ struct sxplayer_frame *sxplayer_get_frame_ms(struct sxplayer_ctx *s, int64_t t64
 
         av_frame_free(&s->cached_frame);
 
-        ret = sxpi_async_seek(s->actx, vt);
+        ret = async_seek(s, vt, o->seek_precision);
         if (ret < 0) {
             av_frame_free(&candidate);
             return ret_frame(s, NULL);
         }
+    } else if (diff > 0) {
+        s->nb_forward_decodes++;
     }
 
+    s->frame_cache_served = 0;
+
+    /* The decoder does not discard the frames preceding the requested time
+     * after a keyframe seek, so the first one is the keyframe itself */
+    if (s->keyframe_vt == vt) {
+        TRACE(s, "keyframe seek, return the first frame");
+        AVFrame *next = pop_frame(s);
+        if (next) {
+            av_frame_free(&candidate);
+            candidate = next;
+        }
+        return ret_frame(s, candidate);
+    }
+
+    /* Let the pipeline drop the frames this loop would skip */
+    set_wanted_ts(s, stream_time(s, vt));
+
     /* Consume frames until we get a frame as accurate as possible */
     for (;;) {
         const int next_is_cached_frame = !!s->cached_frame;
@@ -867,10 +1281,13 @@ struct sxplayer_frame *sxplayer_get_frame_ms(struct sxplayer_ctx *s, int64_t t64
         if (s->opts.use_pkt_duration && next->pkt_duration > 0 && rescaled_vt >= next->pts) {
             const int64_t next_guessed_pts = next->pts + next->pkt_duration;
             if (rescaled_vt < next_guessed_pts) {
+                if (candidate)
+                    s->auto_drop_nb_discarded++;
                 av_frame_free(&candidate);
                 av_frame_free(&s->cached_frame);
                 s->cached_frame = NULL;
-                return ret_frame(s, next);
+                candidate = next;
+                break;
             }
         }
 
@@ -886,6 +1303,8 @@ struct sxplayer_frame *sxplayer_get_frame_ms(struct sxplayer_ctx *s, int64_t t64
             }
             break;
         }
+        if (candidate)
+            s->auto_drop_nb_discarded++;
         av_frame_free(&candidate);
         candidate = next;
         if (candidate->pts == rescaled_vt) {
@@ -894,6 +1313,19 @@ struct sxplayer_frame *sxplayer_get_frame_ms(struct sxplayer_ctx *s, int64_t t64
         }
     }
 
+    if (o->adaptive_seek_trigger && candidate && !s->timed_out) {
+        const double elapsed = (av_gettime_relative() - start_time) / 1000000.;
+        if (!seeking) {
+            const int64_t end_pts = s->cached_frame ? s->cached_frame->pts : candidate->pts;
+            const int64_t decoded = av_rescale_q(end_pts - start_head, s->st_timebase, AV_TIME_BASE_Q);
+            if (decoded >= COST_MIN_MEDIA_TIME)
+                s->decode_speed = update_cost(s->decode_speed, elapsed * AV_TIME_BASE / decoded);
+        } else if (seek_decode_time >= 0 && s->decode_speed > 0) {
+            const double overhead = FFMAX(elapsed - seek_decode_time * s->decode_speed, 0);
+            s->seek_overhead = s->seek_overhead < 0 ? overhead : update_cost(s->seek_overhead, overhead);
+        }
+    }
+
     return ret_frame(s, candidate);
 }
 
@@ -902,14 +1334,67 @@ struct sxplayer_frame *sxplayer_get_frame(struct sxplayer_ctx *s, double t)
     return sxplayer_get_frame_ms(s, TIME2INT64(t));
 }
 
+struct sxplayer_frame *sxplayer_get_frame_deadline(struct sxplayer_ctx *s, double t,
+                                                   int64_t timeout_us, int *status)
+{
+    s->deadline = av_gettime_relative() + FFMAX(timeout_us, 0);
+    struct sxplayer_frame *frame = sxplayer_get_frame_ms(s, TIME2INT64(t));
+    s->deadline = AV_NOPTS_VALUE;
+    if (s->context_configured)
+        sxpi_async_set_deadline(s->actx, AV_NOPTS_VALUE);
+
+    if (status) {
+        if (!s->timed_out)
+            *status = SXPLAYER_DEADLINE_EXACT;
+        else
+            *status = frame ? SXPLAYER_DEADLINE_PARTIAL : SXPLAYER_DEADLINE_TIMEOUT;
+    }
+    return frame;
+}
+
 struct sxplayer_frame *sxplayer_get_next_frame(struct sxplayer_ctx *s)
 {
     START_FUNC("GET NEXT FRAME");
 
+    s->timed_out = 0;
+
+    if (s->opts.frame_cb) {
+        LOG(s, ERROR, "Frames are delivered through the frame callback");
+        return ret_frame(s, NULL);
+    }
+
     int ret = configure_context(s);
     if (ret < 0)
         return ret_frame(s, NULL);
 
+    set_wanted_ts(s, AV_NOPTS_VALUE);
+
+    const int prefetching = s->prefetch_vt != AV_NOPTS_VALUE;
+    if (s->frame_cache_served || prefetching) {
+        /* Follow the frames chain in the frame cache until the pipeline
+         * position is reached again */
+        AVFrame *frame = sxpi_frame_cache_get_next(s->frame_cache, s->last_pushed_frame_ts);
+        const int64_t head_ts = get_head_ts(s);
+        if (frame && (frame->pts < head_ts || (frame->pts == head_ts && !s->cached_frame && !prefetching))) {
+            s->frame_cache_hits++;
+            s->frame_cache_served = frame->pts < head_ts;
+            return ret_frame(s, frame);
+        }
+        if (!frame) {
+            TRACE(s, "frame cache miss, resume from the pipeline position");
+            s->frame_cache_misses++;
+        }
+        av_frame_free(&frame);
+        s->frame_cache_served = 0;
+
+        if (prefetching) {
+            /* Bring the pipeline back to where it was before the prefetch */
+            ret = async_seek(s, media_time(s, head_ts), SXPLAYER_SEEK_EXACT);
+            if (ret < 0)
+                return ret_frame(s, NULL);
+        }
+    }
+
     AVFrame *frame = pop_frame(s);
     return ret_frame(s, frame);
 }
@@ -933,6 +1418,50 @@ end:
     return ret;
 }
 
+int sxplayer_get_stats(struct sxplayer_ctx *s, struct sxplayer_stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->frame_cache_hits   = s->frame_cache_hits;
+    stats->frame_cache_misses = s->frame_cache_misses;
+    stats->nb_forward_seeks   = s->nb_forward_seeks;
+    stats->nb_forward_decodes = s->nb_forward_decodes;
+    stats->decode_speed       = s->decode_speed;
+    stats->seek_overhead      = FFMAX(s->seek_overhead, 0);
+    if (s->frame_cache) {
+        stats->frame_cache_size      = sxpi_frame_cache_get_size(s->frame_cache);
+        stats->frame_cache_nb_frames = sxpi_frame_cache_get_nb_frames(s->frame_cache);
+    }
+    if (s->actx)
+        sxpi_async_get_stats(s->actx, stats);
+    return 0;
+}
+
+int sxplayer_get_event_fd(struct sxplayer_ctx *s)
+{
+    int ret = configure_context(s);
+    if (ret < 0)
+        return ret;
+    ret = sxpi_async_get_event_fd(s->actx);
+    if (ret < 0)
+        LOG(s, ERROR, "Unable to get the event file descriptor: %s", av_err2str(ret));
+    return ret;
+}
+
+int sxplayer_get_keyframes(struct sxplayer_ctx *s, double *timestamps, int max_nb)
+{
+    START_FUNC("GET KEYFRAMES");
+
+    int ret = configure_context(s);
+    if (ret < 0)
+        goto end;
+    ret = sxpi_async_get_keyframes(s->actx, timestamps, max_nb);
+    TRACE(s, "%d keyframes indexed", ret);
+
+end:
+    END_FUNC(MAX_ASYNC_OP_TIME);
+    return ret;
+}
+
 int sxplayer_get_duration(struct sxplayer_ctx *s, double *duration)
 {
     START_FUNC("GET DURATION");
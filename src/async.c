@@ -23,7 +23,6 @@
 #include <libavutil/avassert.h>
 #include <libavutil/avstring.h>
 #include <libavutil/opt.h>
-#include <libavutil/threadmessage.h>
 #include <libavutil/time.h>
 #include <libavutil/timestamp.h>
 
@@ -35,6 +34,11 @@
 #include "mod_demuxing.h"
 #include "mod_decoding.h"
 #include "mod_filtering.h"
+#include "msg_queue.h"
+#include "notifier.h"
+#include "seek_index.h"
+#include "shared_input.h"
+#include "worker_pool.h"
 
 struct info_message {
     int width, height;
@@ -43,65 +47,238 @@ struct info_message {
     AVRational timebase;
 };
 
+struct async_group;
+
 struct async_context {
     void *log_ctx;
-    const char *filename;
     const struct sxplayer_opts *o;
 
-    struct demuxing_ctx  *demuxer;
+    struct async_group *group;
+    int linked;                             // joined the group of another context
+    int output;                             // demuxer output of the selected stream
+    int active;                             // reading from the running modules
+    int started;                            // user side: a start was requested since the latest stop
+
     struct decoding_ctx  *decoder;
     struct filtering_ctx *filterer;
 
-    pthread_t demuxer_tid;
+    struct notifier *notifier;              // user event loop readiness
+    AVBufferPool *frame_pool;               // user frames, owned by the user context
+
     pthread_t decoder_tid;
     pthread_t filterer_tid;
-    pthread_t control_tid;
+    pthread_t fused_tid;
 
-    int demuxer_started;
     int decoder_started;
     int filterer_started;
-    int control_started;
+    int fused_started;
+
+    int fused;                              // the decoder thread does the filtering itself
+
+    /* Lazy filtering: filters the frames returned to the user, it outlives
+     * the modules since the user may hold frames decoded before they stop */
+    pthread_mutex_t convert_lock;
+    struct filtering_ctx *converter;
+
+    struct msg_queue *pkt_queue;            // demuxer  <-> decoder
+    struct msg_queue *frames_queue;         // decoder  <-> filterer
+    struct msg_queue *sink_queue;           // filterer <-> user
 
-    AVThreadMessageQueue *src_queue;        // user     <-> demuxer
-    AVThreadMessageQueue *pkt_queue;        // demuxer  <-> decoder
-    AVThreadMessageQueue *frames_queue;     // decoder  <-> filterer
-    AVThreadMessageQueue *sink_queue;       // filterer <-> user
+    struct msg_queue *ctl_out_queue;
 
-    AVThreadMessageQueue *ctl_in_queue;
-    AVThreadMessageQueue *ctl_out_queue;
+    struct msg_pool *msg_pool;              // packets and frames of the queues above, outlives them
 
     int thread_stack_size;
 
-    int64_t request_seek;
+    enum AVDiscard skip_frame;
 
     struct info_message info;
     int has_info;
 
-    int modules_initialized;
-
     int need_sync;
+    int ctl_pending;                        // mask of the control messages sent but not received back yet
+    int64_t deadline;                       // time (av_gettime_relative()) at which the user calls give up
+    int64_t wanted_ts;                      // hint read by the decoder, see sxpi_async_set_wanted_ts()
+
+    /* Push mode: the filterer waits on this condition while the user defers
+     * a frame, until it is resumed, a seek is requested or the modules are
+     * killed */
+    pthread_mutex_t push_lock;
+    pthread_cond_t push_cond;
+    int push_resumed;
+    int push_aborted;
+    int push_seek_id;
+    int push_eos_stop;                      // end of stream stop left to the control thread, accessed atomically
+};
+
+/* Control thread and demuxer shared by the contexts reading the same media.
+ * The first member opened the group and drives the demuxing with its
+ * options, it is always the last one to leave. */
+struct async_group {
+    void *log_ctx;
+    const char *filename;
+    const struct sxplayer_opts *o;
+
+    /* Held by the control thread while it processes an action, and by the
+     * contexts joining or leaving the group */
+    pthread_mutex_t lock;
+    struct async_context **members;
+    int nb_members;
+
+    struct demuxing_ctx *demuxer;
+    struct seek_index *seek_index;          // outlives the modules
+    struct shared_input *shared_input;      // outlives the modules, NULL if the input is not shared
+    struct worker_set *workers;             // outlives the modules, NULL if the modules run in threads
+    int use_workers;                        // the modules currently initialized run as worker tasks
+    int inline_exec;                        // the actions and modules run in the threads of the users
+    int ctl_err;                            // inline execution: error of the latest failed action
+
+    pthread_t demuxer_tid;
+    pthread_t control_tid;
+
+    int demuxer_started;
+    int control_started;
+
+    struct msg_queue *src_queue;            // user     <-> demuxer
+    struct msg_queue *ctl_in_queue;
+    struct msg_fifo ctl_backlog;            // actions taken out of the control input queue ahead of their turn
+
+    int seek_id;                            // identifier of the latest seek sent to the demuxer
+
+    pthread_mutex_t seek_wait_lock;
+    struct msg_queue *seek_wait_sink;       // sink the control thread waits for a seek in, guarded by seek_wait_lock
+
+    int thread_stack_size;
+
+    int64_t request_seek;
+    int request_seek_precision;
+
+    int modules_initialized;
+    int64_t media_cache_hits;               // read by the users at any time
 
     int playing;
 };
 
+/* The module tasks never wait, so they must be scheduled again whenever
+ * something they may be waiting for happens outside of them */
+static void wake_modules(struct async_group *group)
+{
+    if (group->workers)
+        sxpi_worker_pool_wake(group->workers);
+}
+
+/* Inline execution: a module is running until its step function reports
+ * its end */
+static int step_module(int *started, int ret)
+{
+    if (ret < 0)
+        *started = 0;
+    return ret != 0;
+}
+
+#define STEP_MODULE(ctx, name, action)                                          \
+    ((ctx)->name##_started ?                                                    \
+     step_module(&(ctx)->name##_started,                                        \
+                 sxpi_##action##_step((ctx)->name, AV_THREAD_MESSAGE_NONBLOCK)) \
+     : 0)
+
+/* Make every running module of the group go one step further, returns 1 if
+ * any of them did something, 0 if they are all waiting, and AVERROR_EXIT if
+ * none is running. Must be called with the group lock held. */
+static int step_modules(struct async_group *group)
+{
+    int running = group->demuxer_started;
+    int progress = STEP_MODULE(group, demuxer, demuxing);
+    for (int i = 0; i < group->nb_members; i++) {
+        struct async_context *actx = group->members[i];
+        running |= actx->decoder_started | actx->filterer_started;
+        progress |= STEP_MODULE(actx, decoder, decoding);
+        progress |= STEP_MODULE(actx, filterer, filtering);
+    }
+    if (progress)
+        return 1;
+    return running ? 0 : AVERROR_EXIT;
+}
+
+/* Inline execution: run the modules in the calling thread until the queue has
+ * a message, giving up with AVERROR(EAGAIN) when the deadline is reached */
+static int recv_inline(struct async_group *group, struct msg_queue *q,
+                       struct message *msg, int64_t deadline, int locked)
+{
+    for (;;) {
+        int ret = sxpi_msg_queue_recv(q, msg, AV_THREAD_MESSAGE_NONBLOCK);
+        if (ret != AVERROR(EAGAIN))
+            return ret;
+        if (deadline != AV_NOPTS_VALUE && av_gettime_relative() >= deadline) {
+            TRACE(group, "deadline reached");
+            return ret;
+        }
+        if (!locked)
+            pthread_mutex_lock(&group->lock);
+        ret = step_modules(group);
+        if (!locked)
+            pthread_mutex_unlock(&group->lock);
+        if (ret < 0)
+            return ret;
+        if (!ret) {
+            /* Every module waits for another one, this is not supposed to
+             * happen while the queue is empty */
+            LOG(group, ERROR, "The modules are stuck");
+            return AVERROR_BUG;
+        }
+    }
+}
+
+/* Receive a message from a queue the user is waiting on, giving up with
+ * AVERROR(EAGAIN) when the deadline is reached */
+static int recv_user_message(struct async_context *actx, struct msg_queue *q,
+                             struct message *msg)
+{
+    if (actx->group->inline_exec)
+        return recv_inline(actx->group, q, msg, actx->deadline, 0);
+
+    if (actx->deadline == AV_NOPTS_VALUE)
+        return sxpi_msg_queue_recv(q, msg, 0);
+
+    const int ret = sxpi_msg_queue_recv_until(q, msg, actx->deadline);
+    if (ret == AVERROR(EAGAIN))
+        TRACE(actx, "deadline reached");
+    return ret;
+}
+
+static int run_ctl_message(struct async_context *actx, struct message *msg);
+
 /* Send a message to the control input and fetch from the output until we get
- * it back */
+ * it back. If the deadline is reached, the message is kept pending and waited
+ * for again (instead of being sent again) on the next call. */
 static int send_wait_ctl_message(struct async_context *actx,
                                  struct message *msg)
 {
+    int ret;
     const int message_type = msg->type;
     const char *msg_type_str = sxpi_async_get_msg_type_string(message_type);
-    TRACE(actx, "--> send %s", msg_type_str);
-    int ret = av_thread_message_queue_send(actx->ctl_in_queue, msg, 0);
-    if (ret < 0) {
-        TRACE(actx, "couldn't send %s: %s", msg_type_str, av_err2str(ret));
-        return ret;
+    if (actx->group->inline_exec)
+        return run_ctl_message(actx, msg);
+    if (actx->ctl_pending & 1 << message_type) {
+        TRACE(actx, "%s already sent", msg_type_str);
+    } else {
+        TRACE(actx, "--> send %s", msg_type_str);
+        msg->origin = actx;
+        ret = sxpi_msg_queue_send(actx->group->ctl_in_queue, msg, 0);
+        if (ret < 0) {
+            TRACE(actx, "couldn't send %s: %s", msg_type_str, av_err2str(ret));
+            return ret;
+        }
+        actx->ctl_pending |= 1 << message_type;
     }
     TRACE(actx, "wait %s", msg_type_str);
     memset(msg, 0, sizeof(*msg));
     for (;;) {
-        ret = av_thread_message_queue_recv(actx->ctl_out_queue, msg, 0);
-        if (ret < 0 || msg->type == message_type)
+        ret = recv_user_message(actx, actx->ctl_out_queue, msg);
+        if (ret < 0)
+            break;
+        actx->ctl_pending &= ~(1 << msg->type);
+        if (msg->type == message_type)
             break;
         sxpi_msg_free_data(msg);
     }
@@ -112,21 +289,46 @@ static int send_wait_ctl_message(struct async_context *actx,
     return ret;
 }
 
+/* Queue an action for the control thread without waiting for it */
+static int queue_ctl_message(struct async_context *actx, struct message *msg)
+{
+    struct msg_queue *ctl_in_queue = actx->group->ctl_in_queue;
+
+    if (actx->group->inline_exec)
+        return run_ctl_message(actx, msg);
+
+    msg->origin = actx;
+    int ret = sxpi_msg_queue_send(ctl_in_queue, msg, 0);
+    if (ret < 0) {
+        sxpi_msg_queue_set_err_recv(ctl_in_queue, ret);
+        sxpi_msg_free_data(msg);
+        return ret;
+    }
+    actx->need_sync = 1;
+    return 0;
+}
+
 /* There might be some actions still processing in the control thread, so we
  * send a sync message to make sure every actions has been processed */
 static int sync_control_thread(struct async_context *actx)
 {
-    if (actx->need_sync) {
-        TRACE(actx, "need sync");
+    if (!actx->need_sync && !(actx->ctl_pending & 1 << MSG_SYNC)) {
+        TRACE(actx, "no need to sync");
+        return 0;
+    }
+
+    TRACE(actx, "need sync");
+    do {
+        /* A pending sync does not cover the actions requested after it was
+         * sent, so another one is needed once it is back */
+        if (!(actx->ctl_pending & 1 << MSG_SYNC))
+            actx->need_sync = 0;
         struct message sync_msg = { .type = MSG_SYNC };
         int ret = send_wait_ctl_message(actx, &sync_msg);
         if (ret < 0)
             return ret;
         av_assert0(!sync_msg.data);
-        actx->need_sync = 0;
-    } else {
-        TRACE(actx, "no need to sync");
-    }
+    } while (actx->need_sync);
     return 0;
 }
 
@@ -159,6 +361,9 @@ struct async_context *sxpi_async_alloc_context(void)
     struct async_context *actx = av_mallocz(sizeof(*actx));
     if (!actx)
         return NULL;
+    pthread_mutex_init(&actx->push_lock, NULL);
+    pthread_cond_init(&actx->push_cond, NULL);
+    pthread_mutex_init(&actx->convert_lock, NULL);
     return actx;
 }
 
@@ -186,7 +391,7 @@ int sxpi_async_pop_frame(struct async_context *actx, AVFrame **framep)
     if (ret < 0)
         return ret;
 
-    if (!actx->playing) {
+    if (!actx->group->playing || !actx->started) {
         TRACE(actx, "not playing, start modules");
         ret = sxpi_async_start(actx);
         if (ret < 0)
@@ -198,285 +403,692 @@ int sxpi_async_pop_frame(struct async_context *actx, AVFrame **framep)
 
     TRACE(actx, "fetching a frame from the sink");
     struct message msg;
-    ret = av_thread_message_queue_recv(actx->sink_queue, &msg, 0);
-    if (ret < 0) {
-        TRACE(actx, "couldn't fetch frame from sink because %s", av_err2str(ret));
-        av_thread_message_queue_set_err_send(actx->sink_queue, ret);
-        (void)sxpi_async_stop(actx);
-        return ret;
+    for (;;) {
+        ret = recv_user_message(actx, actx->sink_queue, &msg);
+        if (ret == AVERROR(EAGAIN))
+            return ret;
+        if (ret >= 0)
+            wake_modules(actx->group);
+        if (ret < 0) {
+            TRACE(actx, "couldn't fetch frame from sink because %s", av_err2str(ret));
+            sxpi_msg_queue_set_err_send(actx->sink_queue, ret);
+            (void)sxpi_async_stop(actx);
+            return ret;
+        }
+        /* The seeks requested through a linked context reach this sink too */
+        if (msg.type != MSG_SEEK)
+            break;
+        TRACE(actx, "skip seek requested by a linked context");
+        sxpi_msg_free_data(&msg);
     }
     av_assert0(msg.type == MSG_FRAME);
     *framep = msg.data;
     return 0;
 }
 
-static int create_seek_msg(struct message *msg, int64_t ts)
+/* A deferred frame would prevent the seek from reaching the sink */
+static void interrupt_deferred_frame(struct async_context *actx)
 {
-    msg->type = MSG_SEEK,
-    msg->data = av_malloc(sizeof(ts));
-    if (!msg->data)
-        return AVERROR(ENOMEM);
-    *(int64_t *)msg->data = ts;
-    return 0;
+    pthread_mutex_lock(&actx->push_lock);
+    actx->push_seek_id++;
+    pthread_cond_broadcast(&actx->push_cond);
+    pthread_mutex_unlock(&actx->push_lock);
+}
+
+/* The sink is published before waiting in it, so a newer seek can interrupt
+ * the wait whichever member it comes from */
+static void set_seek_wait_sink(struct async_group *group, struct msg_queue *sink)
+{
+    pthread_mutex_lock(&group->seek_wait_lock);
+    group->seek_wait_sink = sink;
+    pthread_mutex_unlock(&group->seek_wait_lock);
+}
+
+static void interrupt_seek_wait(struct async_group *group)
+{
+    pthread_mutex_lock(&group->seek_wait_lock);
+    if (group->seek_wait_sink)
+        sxpi_msg_queue_interrupt_recv(group->seek_wait_sink);
+    pthread_mutex_unlock(&group->seek_wait_lock);
 }
 
-int sxpi_async_seek(struct async_context *actx, int64_t ts)
+int sxpi_async_seek(struct async_context *actx, int64_t ts, int precision)
 {
     TRACE(actx, "--> send seek msg @ %s", PTS2TIMESTR(ts));
-    struct message msg;
-    int ret = create_seek_msg(&msg, ts);
+    struct message msg = { .type = MSG_SEEK, .ts = ts, .seek_precision = precision };
+
+    if (actx->o->frame_cb)
+        interrupt_deferred_frame(actx);
+
+    const int ret = queue_ctl_message(actx, &msg);
     if (ret < 0)
         return ret;
-    ret = av_thread_message_queue_send(actx->ctl_in_queue, &msg, 0);
-    if (ret < 0) {
-        av_thread_message_queue_set_err_recv(actx->ctl_in_queue, ret);
-        av_freep(&msg.data);
-        return ret;
-    }
-    actx->need_sync = 1;
+
+    /* The control thread may be waiting for the previous seek in a sink */
+    if (!actx->group->inline_exec)
+        interrupt_seek_wait(actx->group);
     return 0;
 }
 
+int sxpi_async_convert_frame(struct async_context *actx, AVFrame **framep)
+{
+    pthread_mutex_lock(&actx->convert_lock);
+    const int ret = actx->converter ? sxpi_filtering_convert_frame(actx->converter, framep) : 0;
+    pthread_mutex_unlock(&actx->convert_lock);
+    return ret;
+}
+
 int sxpi_async_start(struct async_context *actx)
 {
     TRACE(actx, "--> send start msg");
     struct message msg = { .type = MSG_START };
-    int ret = av_thread_message_queue_send(actx->ctl_in_queue, &msg, 0);
-    if (ret < 0) {
-        av_thread_message_queue_set_err_recv(actx->ctl_in_queue, ret);
-        return ret;
-    }
-    actx->need_sync = 1;
-    return 0;
+    actx->started = 1;
+    return queue_ctl_message(actx, &msg);
+}
+
+void sxpi_async_set_deadline(struct async_context *actx, int64_t deadline)
+{
+    actx->deadline = deadline;
 }
 
 int sxpi_async_stop(struct async_context *actx)
 {
     TRACE(actx, "--> send stop msg");
     struct message msg = { .type = MSG_STOP };
-    int ret = av_thread_message_queue_send(actx->ctl_in_queue, &msg, 0);
-    if (ret < 0) {
-        av_thread_message_queue_set_err_recv(actx->ctl_in_queue, ret);
-        return ret;
-    }
-    actx->need_sync = 1;
+    actx->started = 0;
+    return queue_ctl_message(actx, &msg);
+}
+
+int sxpi_async_set_skip_frame(struct async_context *actx, enum AVDiscard skip_frame)
+{
+    TRACE(actx, "--> send drop ref msg (skip frame level %d)", skip_frame);
+    struct message msg = { .type = MSG_DROP_REF, .skip_frame = skip_frame };
+    return queue_ctl_message(actx, &msg);
+}
+
+void sxpi_async_set_wanted_ts(struct async_context *actx, int64_t ts)
+{
+    __atomic_store_n(&actx->wanted_ts, ts, __ATOMIC_RELAXED);
+}
+
+int sxpi_async_resume_frames(struct async_context *actx)
+{
+    TRACE(actx, "resume deferred frame");
+    pthread_mutex_lock(&actx->push_lock);
+    actx->push_resumed = 1;
+    pthread_cond_signal(&actx->push_cond);
+    pthread_mutex_unlock(&actx->push_lock);
     return 0;
 }
 
-static int initialize_modules_once(struct async_context *actx,
-                                   const struct sxplayer_opts *opts)
+/* Called from the filterer thread for every filtered frame in push mode */
+/*
+ * The control thread may be stopping the modules and waiting for the
+ * filterer, so the stop can not wait for room in the control queue. When the
+ * queue is full, the control thread takes the stop from a flag after its next
+ * action; if the queue was emptied meanwhile, there may be no such action, so
+ * the stop is taken back and sent again.
+ */
+static void queue_eos_stop(struct async_context *actx)
 {
-    int ret;
+    struct msg_queue *ctl_in_queue = actx->group->ctl_in_queue;
+
+    for (;;) {
+        struct message msg = { .type = MSG_STOP, .origin = actx };
+        const int ret = sxpi_msg_queue_send(ctl_in_queue, &msg, AV_THREAD_MESSAGE_NONBLOCK);
+        if (ret != AVERROR(EAGAIN)) {
+            if (ret < 0 && ret != AVERROR_EXIT)
+                LOG(actx, ERROR, "Unable to queue the end of stream stop: %s", av_err2str(ret));
+            return;
+        }
 
-    if (actx->modules_initialized)
+        TRACE(actx, "control queue full, leave the stop to the control thread");
+        __atomic_store_n(&actx->push_eos_stop, 1, __ATOMIC_RELEASE);
+        if (sxpi_msg_queue_nb_elems(ctl_in_queue) > 0 ||
+            !__atomic_exchange_n(&actx->push_eos_stop, 0, __ATOMIC_ACQ_REL))
+            return;
+    }
+}
+
+static int push_frame(void *opaque, struct sxplayer_frame *frame)
+{
+    struct async_context *actx = opaque;
+    const struct sxplayer_opts *o = actx->o;
+
+    if (!frame) {
+        pthread_mutex_lock(&actx->push_lock);
+        const int aborted = actx->push_aborted;
+        pthread_mutex_unlock(&actx->push_lock);
+        if (!aborted) {
+            /* Release the playback resources like sxpi_async_pop_frame() does
+             * at the end of the stream, so that the decoding can be restarted */
+            queue_eos_stop(actx);
+            TRACE(actx, "notify the user of the end of the stream");
+            o->frame_cb(o->frame_cb_arg, NULL);
+        }
         return 0;
+    }
+
+    pthread_mutex_lock(&actx->push_lock);
+    const int seek_id = actx->push_seek_id;
+    pthread_mutex_unlock(&actx->push_lock);
+
+    for (;;) {
+        const int status = o->frame_cb(o->frame_cb_arg, frame);
+        if (status == SXPLAYER_FRAME_ACCEPTED)
+            return 0;
+        if (status != SXPLAYER_FRAME_DEFERRED) {
+            TRACE(actx, "frame refused by the user");
+            sxplayer_release_frame(frame);
+            return 0;
+        }
+
+        TRACE(actx, "frame deferred by the user, waiting");
+        pthread_mutex_lock(&actx->push_lock);
+        while (!actx->push_resumed && !actx->push_aborted && actx->push_seek_id == seek_id)
+            pthread_cond_wait(&actx->push_cond, &actx->push_lock);
+        const int resumed = actx->push_resumed;
+        const int aborted = actx->push_aborted;
+        actx->push_resumed = 0;
+        pthread_mutex_unlock(&actx->push_lock);
+
+        if (!resumed || aborted) {
+            TRACE(actx, "dropping deferred frame");
+            sxplayer_release_frame(frame);
+            return aborted ? AVERROR_EXIT : 0;
+        }
+    }
+}
 
-    av_assert0(!actx->demuxer && !actx->decoder && !actx->filterer);
+/* Fused filtering: called by the decoder for every frame or message it
+ * outputs */
+static int filter_decoded(void *opaque, struct message *msg)
+{
+    struct async_context *actx = opaque;
+    return sxpi_filtering_push_message(actx->filterer, msg);
+}
 
-    TRACE(actx, "alloc modules");
-    actx->demuxer  = sxpi_demuxing_alloc();
-    actx->decoder  = sxpi_decoding_alloc();
-    actx->filterer = sxpi_filtering_alloc();
-    if (!actx->demuxer || !actx->decoder || !actx->filterer)
+static int init_converter(struct async_context *actx, const AVStream *stream,
+                          double media_rotation)
+{
+    struct filtering_ctx *converter = sxpi_filtering_alloc();
+    if (!converter)
         return AVERROR(ENOMEM);
 
-    TRACE(actx, "initialize modules");
-
-    if ((ret = sxpi_demuxing_init(actx->log_ctx,
-                                  actx->demuxer,
-                                  actx->src_queue, actx->pkt_queue,
-                                  actx->filename, opts)) < 0 ||
-        (ret = sxpi_decoding_init(actx->log_ctx,
-                                  actx->decoder,
-                                  actx->pkt_queue, actx->frames_queue,
-                                  sxpi_demuxing_is_image(actx->demuxer),
-                                  sxpi_demuxing_get_stream(actx->demuxer), opts)) < 0 ||
-        (ret = sxpi_filtering_init(actx->log_ctx,
-                                   actx->filterer,
-                                   actx->frames_queue, actx->sink_queue,
-                                   sxpi_demuxing_get_stream(actx->demuxer),
-                                   sxpi_decoding_get_avctx(actx->decoder),
-                                   sxpi_demuxing_probe_rotation(actx->demuxer), opts)) < 0)
+    int ret = sxpi_filtering_init(actx->log_ctx, converter, NULL, NULL, stream,
+                                  sxpi_decoding_get_avctx(actx->decoder),
+                                  media_rotation, actx->o, NULL, NULL, NULL, NULL);
+    if (ret < 0) {
+        sxpi_filtering_free(&converter);
         return ret;
+    }
 
-    actx->modules_initialized = 1;
+    pthread_mutex_lock(&actx->convert_lock);
+    sxpi_filtering_free(&actx->converter);
+    actx->converter = converter;
+    pthread_mutex_unlock(&actx->convert_lock);
     return 0;
 }
 
-static int alloc_msg_queue(AVThreadMessageQueue **q, int n)
+/* The demuxer feeds the first member through its first output, and every
+ * linked context through an additional one */
+static int initialize_modules_once(struct async_group *group)
 {
-    int ret = av_thread_message_queue_alloc(q, n, sizeof(struct message));
+    int ret;
+
+    if (group->modules_initialized)
+        return 0;
+
+    av_assert0(!group->demuxer);
+
+    TRACE(group, "alloc modules");
+    group->demuxer = sxpi_demuxing_alloc();
+    if (!group->demuxer)
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < group->nb_members; i++) {
+        struct async_context *actx = group->members[i];
+        av_assert0(!actx->decoder && !actx->filterer);
+        actx->decoder  = sxpi_decoding_alloc();
+        actx->filterer = sxpi_filtering_alloc();
+        if (!actx->decoder || !actx->filterer)
+            return AVERROR(ENOMEM);
+        actx->output = 0;
+        if (i) {
+            ret = sxpi_demuxing_add_output(group->demuxer, actx->pkt_queue,
+                                           actx->msg_pool, actx->o);
+            if (ret < 0)
+                return ret;
+            actx->output = ret;
+        }
+    }
+
+    if (group->shared_input)
+        sxpi_demuxing_set_shared_input(group->demuxer, group->shared_input);
+
+    group->use_workers = !!group->workers;
+    for (int i = 0; i < group->nb_members && group->use_workers; i++) {
+        if (group->members[i]->o->frame_cb) {
+            LOG(group, WARNING, "The frame callback may wait for the user, "
+                "running the modules in threads instead of the worker pool");
+            group->use_workers = 0;
+        }
+    }
+
+    /* The worker tasks and the inline steps already avoid the hop between
+     * the decoder and the filterer threads */
+    for (int i = 0; i < group->nb_members; i++) {
+        struct async_context *actx = group->members[i];
+        actx->fused = actx->o->fused_filtering && !group->use_workers && !group->inline_exec;
+    }
+
+    TRACE(group, "initialize modules");
+
+    ret = sxpi_demuxing_init(group->log_ctx,
+                             group->demuxer,
+                             group->src_queue, group->members[0]->pkt_queue,
+                             group->members[0]->msg_pool,
+                             group->seek_index,
+                             group->filename, group->o);
     if (ret < 0)
         return ret;
-    av_thread_message_queue_set_free_func(*q, sxpi_msg_free_data);
+
+    if (sxpi_demuxing_has_cached_info(group->demuxer))
+        __atomic_add_fetch(&group->media_cache_hits, 1, __ATOMIC_RELAXED);
+
+    const int is_image = sxpi_demuxing_is_image(group->demuxer);
+    for (int i = 0; i < group->nb_members; i++) {
+        struct async_context *actx = group->members[i];
+        const AVStream *stream = sxpi_demuxing_get_stream(group->demuxer, actx->output);
+        const double media_rotation = sxpi_demuxing_probe_rotation(group->demuxer, actx->output);
+        if ((ret = sxpi_decoding_init(actx->log_ctx,
+                                      actx->decoder,
+                                      actx->pkt_queue, actx->frames_queue,
+                                      actx->msg_pool, is_image, stream, actx->o,
+                                      &actx->wanted_ts,
+                                      actx->fused ? filter_decoded : NULL, actx)) < 0 ||
+            (ret = sxpi_filtering_init(actx->log_ctx,
+                                       actx->filterer,
+                                       actx->frames_queue, actx->sink_queue,
+                                       stream,
+                                       sxpi_decoding_get_avctx(actx->decoder),
+                                       media_rotation,
+                                       actx->o,
+                                       actx->o->frame_cb ? push_frame : NULL, actx,
+                                       actx->frame_pool, actx->notifier)) < 0)
+            return ret;
+
+        if (sxpi_filtering_is_lazy(actx->filterer)) {
+            ret = init_converter(actx, stream, media_rotation);
+            if (ret < 0)
+                return ret;
+        }
+
+        sxpi_decoding_set_skip_frame(actx->decoder, actx->skip_frame);
+    }
+
+    group->modules_initialized = 1;
     return 0;
 }
 
-#define MODULE_THREAD_FUNC(name, action)                                        \
+#define MODULE_THREAD_FUNC(type, name, action)                                  \
 static void *name##_thread(void *arg)                                           \
 {                                                                               \
-    struct async_context *actx = arg;                                           \
+    struct type *ctx = arg;                                                     \
     sxpi_set_thread_name("sxp/" AV_STRINGIFY(name));                            \
-    TRACE(actx, "[>] " AV_STRINGIFY(action) " thread starting");                \
-    sxpi_##action##_run(actx->name);                                            \
-    TRACE(actx, "[<] " AV_STRINGIFY(action) " thread ending");                  \
+    TRACE(ctx, "[>] " AV_STRINGIFY(action) " thread starting");                 \
+    sxpi_##action##_run(ctx->name);                                             \
+    TRACE(ctx, "[<] " AV_STRINGIFY(action) " thread ending");                   \
     return NULL;                                                                \
 }
 
-#define START_MODULE_THREAD(name) do {                                          \
-    if (actx->name##_started) {                                                 \
-        TRACE(actx, "not starting " AV_STRINGIFY(name)                          \
+#define START_MODULE_THREAD(ctx, name) do {                                     \
+    if ((ctx)->name##_started) {                                                \
+        TRACE(ctx, "not starting " AV_STRINGIFY(name)                           \
               " thread: already running");                                      \
     } else {                                                                    \
         pthread_attr_t attr;                                                    \
         pthread_attr_t *attrp = NULL;                                           \
-        if (actx->thread_stack_size > 0) {                                      \
+        if ((ctx)->thread_stack_size > 0) {                                     \
             pthread_attr_init(&attr);                                           \
             if (ENABLE_DBG) {                                                   \
                 size_t stack_size;                                              \
                 pthread_attr_getstacksize(&attr, &stack_size);                  \
-                TRACE(actx, "stack size before: %d", (int)stack_size);          \
-                pthread_attr_setstacksize(&attr, actx->thread_stack_size);      \
+                TRACE(ctx, "stack size before: %d", (int)stack_size);           \
+                pthread_attr_setstacksize(&attr, (ctx)->thread_stack_size);     \
                 stack_size = 0;                                                 \
                 pthread_attr_getstacksize(&attr, &stack_size);                  \
-                TRACE(actx, "stack size after: %d", (int)stack_size);           \
+                TRACE(ctx, "stack size after: %d", (int)stack_size);            \
             } else {                                                            \
-                pthread_attr_setstacksize(&attr, actx->thread_stack_size);      \
+                pthread_attr_setstacksize(&attr, (ctx)->thread_stack_size);     \
             }                                                                   \
             attrp = &attr;                                                      \
         }                                                                       \
-        int ret = pthread_create(&actx->name##_tid, attrp, name##_thread, actx);\
+        int ret = pthread_create(&(ctx)->name##_tid, attrp, name##_thread, ctx);\
         if (attrp)                                                              \
             pthread_attr_destroy(attrp);                                        \
         if (ret) {                                                              \
             const int err = AVERROR(ret);                                       \
-            LOG(actx, ERROR, "Unable to start " AV_STRINGIFY(name)              \
+            LOG(ctx, ERROR, "Unable to start " AV_STRINGIFY(name)               \
                 " thread: %s", av_err2str(err));                                \
         } else                                                                  \
-            actx->name##_started = 1;                                           \
+            (ctx)->name##_started = 1;                                          \
     }                                                                           \
 } while (0)
 
-#define JOIN_MODULE_THREAD(name) do {                                           \
-    if (!actx->name##_started) {                                                \
-        TRACE(actx, "not joining " AV_STRINGIFY(name) " thread: not running");  \
+#define JOIN_MODULE_THREAD(ctx, name) do {                                      \
+    if (!(ctx)->name##_started) {                                               \
+        TRACE(ctx, "not joining " AV_STRINGIFY(name) " thread: not running");   \
     } else {                                                                    \
-        TRACE(actx, "joining " AV_STRINGIFY(name) " thread");                   \
-        int ret = pthread_join(actx->name##_tid, NULL);                         \
+        TRACE(ctx, "joining " AV_STRINGIFY(name) " thread");                    \
+        int ret = pthread_join((ctx)->name##_tid, NULL);                        \
         if (ret)                                                                \
-            LOG(actx, ERROR, "Unable to join " AV_STRINGIFY(name) ": %s",       \
+            LOG(ctx, ERROR, "Unable to join " AV_STRINGIFY(name) ": %s",        \
                 av_err2str(AVERROR(ret)));                                      \
-        TRACE(actx, AV_STRINGIFY(name) " thread joined");                       \
-        actx->name##_started = 0;                                               \
+        TRACE(ctx, AV_STRINGIFY(name) " thread joined");                        \
+        (ctx)->name##_started = 0;                                              \
+    }                                                                           \
+} while (0)
+
+#define MODULE_TASK_FUNC(type, name, action)                                    \
+static int name##_task(void *arg)                                               \
+{                                                                               \
+    struct type *ctx = arg;                                                     \
+    return sxpi_##action##_step(ctx->name, AV_THREAD_MESSAGE_NONBLOCK);         \
+}
+
+#define START_MODULE_TASK(ctx, workers, name) do {                              \
+    if ((ctx)->name##_started) {                                                \
+        TRACE(ctx, "not starting " AV_STRINGIFY(name)                           \
+              " task: already running");                                        \
+    } else {                                                                    \
+        int ret = sxpi_worker_pool_add_task(workers, name##_task, ctx);         \
+        if (ret < 0)                                                            \
+            LOG(ctx, ERROR, "Unable to start " AV_STRINGIFY(name)               \
+                " task: %s", av_err2str(ret));                                  \
+        else                                                                    \
+            (ctx)->name##_started = 1;                                          \
     }                                                                           \
 } while (0)
 
-MODULE_THREAD_FUNC(demuxer,  demuxing)
-MODULE_THREAD_FUNC(decoder,  decoding)
-MODULE_THREAD_FUNC(filterer, filtering)
+/* The tasks are waited for all at once before joining */
+#define JOIN_MODULE_TASK(ctx, name) do {                                        \
+    TRACE(ctx, AV_STRINGIFY(name) " task done");                                \
+    (ctx)->name##_started = 0;                                                  \
+} while (0)
+
+/* In inline execution, the modules only run when the users wait for them */
+#define START_MODULE(group, ctx, name) do {                                     \
+    if ((group)->inline_exec)                                                   \
+        (ctx)->name##_started = 1;                                              \
+    else if ((group)->use_workers)                                              \
+        START_MODULE_TASK(ctx, (group)->workers, name);                         \
+    else                                                                        \
+        START_MODULE_THREAD(ctx, name);                                         \
+} while (0)
+
+#define JOIN_MODULE(group, ctx, name) do {                                      \
+    if ((group)->use_workers || (group)->inline_exec)                           \
+        JOIN_MODULE_TASK(ctx, name);                                            \
+    else                                                                        \
+        JOIN_MODULE_THREAD(ctx, name);                                          \
+} while (0)
+
+MODULE_THREAD_FUNC(async_group,   demuxer,  demuxing)
+MODULE_THREAD_FUNC(async_context, decoder,  decoding)
+MODULE_THREAD_FUNC(async_context, filterer, filtering)
+
+/* The filterer is fed by the decoder directly, it only runs on its own to
+ * handle the end of the decoding */
+static void *fused_thread(void *arg)
+{
+    struct async_context *ctx = arg;
+    sxpi_set_thread_name("sxp/fused");
+    TRACE(ctx, "[>] fused decoding and filtering thread starting");
+    sxpi_decoding_run(ctx->decoder);
+    sxpi_filtering_run(ctx->filterer);
+    TRACE(ctx, "[<] fused decoding and filtering thread ending");
+    return NULL;
+}
+
+MODULE_TASK_FUNC(async_group,   demuxer,  demuxing)
+MODULE_TASK_FUNC(async_context, decoder,  decoding)
+MODULE_TASK_FUNC(async_context, filterer, filtering)
+
+static int is_seek_possible(const struct async_group *group)
+{
+    return sxpi_demuxing_probe_duration(group->demuxer) != AV_NOPTS_VALUE;
+}
 
-static int is_seek_possible(const struct async_context *actx)
+/* The demuxer may have to make room in inline execution */
+static int send_src_message(struct async_group *group, struct message *msg)
 {
-    return sxpi_demuxing_probe_duration(actx->demuxer) != AV_NOPTS_VALUE;
+    if (!group->inline_exec)
+        return sxpi_msg_queue_send(group->src_queue, msg, 0);
+
+    for (;;) {
+        int ret = sxpi_msg_queue_send(group->src_queue, msg, AV_THREAD_MESSAGE_NONBLOCK);
+        if (ret != AVERROR(EAGAIN))
+            return ret;
+        ret = step_modules(group);
+        if (ret <= 0)
+            return ret ? ret : AVERROR_BUG;
+    }
 }
 
-static int op_start(struct async_context *actx)
+/* Take the actions already queued for the control thread, so they can be
+ * looked at before their turn */
+static void pull_ctl_messages(struct async_group *group)
 {
     struct message msg;
+    while (sxpi_msg_queue_recv(group->ctl_in_queue, &msg, AV_THREAD_MESSAGE_NONBLOCK) >= 0) {
+        const int ret = sxpi_msg_fifo_push(&group->ctl_backlog, &msg);
+        if (ret < 0) {
+            LOG(group, ERROR, "Unable to keep aside %s message: %s",
+                sxpi_async_get_msg_type_string(msg.type), av_err2str(ret));
+            sxpi_msg_free_data(&msg);
+        }
+    }
+}
+
+/* Only the position the user lands on is worth decoding, so the seeks a
+ * context queued back to back collapse into its latest one. The seeks of the
+ * linked contexts are kept since each of them waits for its own. */
+static void coalesce_seeks(struct async_group *group, struct message *msg)
+{
+    const struct message *next;
+
+    pull_ctl_messages(group);
+    while ((next = sxpi_msg_fifo_peek(&group->ctl_backlog)) &&
+           next->type == MSG_SEEK && next->origin == msg->origin) {
+        TRACE(group, "seek to %s superseded by a seek to %s",
+              PTS2TIMESTR(msg->ts), PTS2TIMESTR(next->ts));
+        sxpi_msg_free_data(msg);
+        sxpi_msg_fifo_pop(&group->ctl_backlog, msg);
+    }
+}
+
+/* A seek requested by the same context right after the one in progress makes
+ * waiting for the latter pointless */
+static int is_seek_superseded(struct async_group *group, const struct async_context *origin)
+{
+    pull_ctl_messages(group);
+    const struct message *next = sxpi_msg_fifo_peek(&group->ctl_backlog);
+    return next && next->type == MSG_SEEK && next->origin == origin;
+}
+
+/* Drop the frames preceding the seek of the origin in the sink of the context,
+ * along with the markers of the previous seeks. Returns AVERROR(EAGAIN) if the
+ * origin requests a newer seek meanwhile: it flushes the pipeline again
+ * anyway. */
+static int wait_seek_sink(struct async_context *origin, struct async_context *actx, int seek_id)
+{
+    struct async_group *group = actx->group;
+    struct message msg = {0};
+    int ret = 0;
+
+    if (!group->inline_exec) {
+        set_seek_wait_sink(group, actx->sink_queue);
+        /* A seek queued before the sink was published did not interrupt it */
+        if (is_seek_superseded(group, origin))
+            ret = AVERROR(EAGAIN);
+    }
+    while (ret >= 0) {
+        if (group->inline_exec) {
+            ret = recv_inline(group, actx->sink_queue, &msg, AV_NOPTS_VALUE, 1);
+        } else {
+            /* Interrupted by sxpi_async_seek() */
+            while ((ret = sxpi_msg_queue_recv_interruptible(actx->sink_queue, &msg)) == AVERROR(EINTR)) {
+                if (is_seek_superseded(group, origin)) {
+                    ret = AVERROR(EAGAIN);
+                    break;
+                }
+            }
+        }
+        if (ret < 0)
+            break;
+        wake_modules(group);
+        sxpi_msg_free_data(&msg);
+        if (msg.type == MSG_SEEK && msg.seek_id == seek_id)
+            break;
+    }
+    if (!group->inline_exec)
+        set_seek_wait_sink(group, NULL);
+    return ret < 0 ? ret : 0;
+}
+
+/* The seek is waited for in the sink of the requesting context, and in the
+ * ones of the linked contexts in push mode since no user reads them; the other
+ * users skip it when popping their frames */
+static int wait_seek(struct async_group *group, struct async_context *origin, int seek_id)
+{
+    int ret = wait_seek_sink(origin, origin, seek_id);
+    if (ret < 0)
+        return ret;
+    for (int i = 0; i < group->nb_members; i++) {
+        struct async_context *actx = group->members[i];
+        if (actx == origin || !actx->o->frame_cb)
+            continue;
+        ret = wait_seek_sink(origin, actx, seek_id);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
+static int op_start(struct async_group *group, struct async_context *origin)
+{
     int64_t seek_to = AV_NOPTS_VALUE;
-    const struct sxplayer_opts *o = actx->o;
+    int seek_precision = SXPLAYER_SEEK_EXACT;
+    const struct sxplayer_opts *o = group->o;
 
-    TRACE(actx, "exec");
+    TRACE(group, "exec");
 
-    int ret = initialize_modules_once(actx, o);
+    int ret = initialize_modules_once(group);
     if (ret < 0) {
-        LOG(actx, ERROR, "initializing modules failed with %s", av_err2str(ret));
+        LOG(group, ERROR, "initializing modules failed with %s", av_err2str(ret));
         return ret;
     }
 
-    if (actx->request_seek != AV_NOPTS_VALUE) {
-        TRACE(actx, "request seek is set to %s", PTS2TIMESTR(actx->request_seek));
-        seek_to = actx->request_seek;
+    if (group->request_seek != AV_NOPTS_VALUE) {
+        TRACE(group, "request seek is set to %s", PTS2TIMESTR(group->request_seek));
+        seek_to = group->request_seek;
+        seek_precision = group->request_seek_precision;
     } else if (o->start_time64) {
-        TRACE(actx, "start_time is set to %s", PTS2TIMESTR(actx->o->start_time64));
+        TRACE(group, "start_time is set to %s", PTS2TIMESTR(o->start_time64));
         seek_to = o->start_time64;
     }
 
-    if (seek_to != AV_NOPTS_VALUE && !is_seek_possible(actx)) {
-        LOG(actx, ERROR, "can not seek into media, ignoring seek");
+    if (seek_to != AV_NOPTS_VALUE && !is_seek_possible(group)) {
+        LOG(group, ERROR, "can not seek into media, ignoring seek");
         seek_to = AV_NOPTS_VALUE;
     }
 
     if (seek_to != AV_NOPTS_VALUE) {
-        TRACE(actx, "seek to: %s", PTS2TIMESTR(seek_to));
+        TRACE(group, "seek to: %s", PTS2TIMESTR(seek_to));
 
-        int ret = create_seek_msg(&msg, seek_to);
-        if (ret < 0)
-            return ret;
+        struct message msg = {
+            .type           = MSG_SEEK,
+            .ts             = seek_to,
+            .seek_id        = ++group->seek_id,
+            .seek_precision = seek_precision,
+        };
 
         // Queue a seek request which we will pull out after the demuxer is started
-        ret = av_thread_message_queue_send(actx->src_queue, &msg, 0);
+        int ret = send_src_message(group, &msg);
         if (ret < 0) {
-            LOG(actx, ERROR, "Unable to queue a seek message to the demuxer, shouldn't happen!");
-            av_thread_message_queue_set_err_recv(actx->src_queue, ret);
+            LOG(group, ERROR, "Unable to queue a seek message to the demuxer, shouldn't happen!");
+            sxpi_msg_queue_set_err_recv(group->src_queue, ret);
             sxpi_msg_free_data(&msg);
             return ret;
         }
     }
 
-    actx->request_seek = AV_NOPTS_VALUE;
+    group->request_seek = AV_NOPTS_VALUE;
 
-    START_MODULE_THREAD(demuxer);
-    START_MODULE_THREAD(decoder);
-    START_MODULE_THREAD(filterer);
-    if (!actx->demuxer_started ||
-        !actx->decoder_started ||
-        !actx->filterer_started)
+    START_MODULE(group, group, demuxer);
+    if (!group->demuxer_started)
         return AVERROR(ENOMEM);
+    for (int i = 0; i < group->nb_members; i++) {
+        struct async_context *actx = group->members[i];
+        if (actx->fused) {
+            START_MODULE_THREAD(actx, fused);
+            if (!actx->fused_started)
+                return AVERROR(ENOMEM);
+        } else {
+            START_MODULE(group, actx, decoder);
+            START_MODULE(group, actx, filterer);
+            if (!actx->decoder_started ||
+                !actx->filterer_started)
+                return AVERROR(ENOMEM);
+        }
+        actx->active = 1;
+    }
 
-    actx->playing = 1;
+    group->playing = 1;
 
     if (seek_to != AV_NOPTS_VALUE) {
-        TRACE(actx, "wait for seek (to %s) to come back", PTS2TIMESTR(seek_to));
-        memset(&msg, 0, sizeof(msg));
-        do {
-            ret = av_thread_message_queue_recv(actx->sink_queue, &msg, 0);
-            if (ret < 0) {
-                av_thread_message_queue_set_err_send(actx->sink_queue, ret);
-                return ret;
-            }
-            sxpi_msg_free_data(&msg);
-        } while (msg.type != MSG_SEEK);
+        TRACE(group, "wait for seek (to %s) to come back", PTS2TIMESTR(seek_to));
+        ret = wait_seek(group, origin, group->seek_id);
+        if (ret == AVERROR(EAGAIN)) {
+            TRACE(group, "seek superseded by a newer one, stop waiting for it");
+            return 0;
+        }
+        if (ret < 0) {
+            sxpi_msg_queue_set_err_send(origin->sink_queue, ret);
+            return ret;
+        }
     }
 
     return 0;
 }
 
-static int op_info(struct async_context *actx, struct message *msg)
+static int op_info(struct async_group *group, struct async_context *origin,
+                   struct message *msg)
 {
-    const struct sxplayer_opts *o = actx->o;
+    const struct sxplayer_opts *o = origin->o;
 
     // We need the demuxer to be initialized to be able to call demuxing_*()
-    int ret = initialize_modules_once(actx, o);
+    int ret = initialize_modules_once(group);
     if (ret < 0) {
-        LOG(actx, ERROR, "initializing modules failed with %s", av_err2str(ret));
+        LOG(group, ERROR, "initializing modules failed with %s", av_err2str(ret));
         return ret;
     }
 
     int64_t end_time = o->end_time64 >= 0 ? o->end_time64 : AV_NOPTS_VALUE;
-    const int64_t probe_duration = sxpi_demuxing_probe_duration(actx->demuxer);
+    const int64_t probe_duration = sxpi_demuxing_probe_duration(group->demuxer);
 
     av_assert0(AV_NOPTS_VALUE < 0);
     if (probe_duration != AV_NOPTS_VALUE && (end_time <= 0 || probe_duration < end_time)) {
-        LOG(actx, INFO, "fix end_time from %f to %f",
+        LOG(origin, INFO, "fix end_time from %f to %f",
             end_time       * av_q2d(AV_TIME_BASE_Q),
             probe_duration * av_q2d(AV_TIME_BASE_Q));
         end_time = probe_duration;
     }
     if (end_time == AV_NOPTS_VALUE)
         end_time = 0;
-    const AVStream *st = sxpi_demuxing_get_stream(actx->demuxer);
-    const int is_image = sxpi_demuxing_is_image(actx->demuxer);
+    const AVStream *st = sxpi_demuxing_get_stream(group->demuxer, origin->output);
+    const int is_image = sxpi_demuxing_is_image(group->demuxer);
     struct info_message info = {
         .width    = st->codecpar->width,
         .height   = st->codecpar->height,
@@ -486,7 +1098,7 @@ static int op_info(struct async_context *actx, struct message *msg)
     };
 
     if (!info.timebase.num || !info.timebase.den) {
-        LOG(actx, WARNING, "Invalid timebase %d/%d, assuming 1/1",
+        LOG(origin, WARNING, "Invalid timebase %d/%d, assuming 1/1",
             info.timebase.num, info.timebase.den);
         info.timebase = av_make_q(1, 1);
     }
@@ -498,164 +1110,319 @@ static int op_info(struct async_context *actx, struct message *msg)
     return 0;
 }
 
-static void kill_join_reset_workers(struct async_context *actx)
+static void set_queues_err(struct async_group *group, int err)
 {
-    TRACE(actx, "prevent modules from feeding and reading from the queues");
-    av_thread_message_queue_set_err_send(actx->src_queue,    AVERROR_EXIT);
-    av_thread_message_queue_set_err_send(actx->pkt_queue,    AVERROR_EXIT);
-    av_thread_message_queue_set_err_send(actx->frames_queue, AVERROR_EXIT);
-    av_thread_message_queue_set_err_send(actx->sink_queue,   AVERROR_EXIT);
-    av_thread_message_queue_set_err_recv(actx->src_queue,    AVERROR_EXIT);
-    av_thread_message_queue_set_err_recv(actx->pkt_queue,    AVERROR_EXIT);
-    av_thread_message_queue_set_err_recv(actx->frames_queue, AVERROR_EXIT);
-    av_thread_message_queue_set_err_recv(actx->sink_queue,   AVERROR_EXIT);
+    sxpi_msg_queue_set_err_send(group->src_queue, err);
+    sxpi_msg_queue_set_err_recv(group->src_queue, err);
+    for (int i = 0; i < group->nb_members; i++) {
+        struct async_context *actx = group->members[i];
+        sxpi_msg_queue_set_err_send(actx->pkt_queue,    err);
+        sxpi_msg_queue_set_err_send(actx->frames_queue, err);
+        sxpi_msg_queue_set_err_send(actx->sink_queue,   err);
+        sxpi_msg_queue_set_err_recv(actx->pkt_queue,    err);
+        sxpi_msg_queue_set_err_recv(actx->frames_queue, err);
+        sxpi_msg_queue_set_err_recv(actx->sink_queue,   err);
+    }
+}
+
+static void kill_join_reset_workers(struct async_group *group)
+{
+    for (int i = 0; i < group->nb_members; i++) {
+        struct async_context *actx = group->members[i];
+        pthread_mutex_lock(&actx->push_lock);
+        actx->push_aborted = 1;
+        pthread_cond_broadcast(&actx->push_cond);
+        pthread_mutex_unlock(&actx->push_lock);
+    }
+
+    TRACE(group, "prevent modules from feeding and reading from the queues");
+    set_queues_err(group, AVERROR_EXIT);
 
     // they won't fill the queues anymore, so we can empty them
-    av_thread_message_flush(actx->src_queue);
-    av_thread_message_flush(actx->pkt_queue);
-    av_thread_message_flush(actx->frames_queue);
-    av_thread_message_flush(actx->sink_queue);
+    sxpi_msg_queue_flush(group->src_queue);
+    for (int i = 0; i < group->nb_members; i++) {
+        struct async_context *actx = group->members[i];
+        sxpi_msg_queue_flush(actx->pkt_queue);
+        sxpi_msg_queue_flush(actx->frames_queue);
+        sxpi_msg_queue_flush(actx->sink_queue);
+    }
 
     // now that we are sure the threads modules will stop by themselves, we can
     // join them
-    TRACE(actx, "waiting for modules to end");
-    JOIN_MODULE_THREAD(filterer);
-    JOIN_MODULE_THREAD(decoder);
-    JOIN_MODULE_THREAD(demuxer);
+    TRACE(group, "waiting for modules to end");
+    if (group->use_workers) {
+        wake_modules(group);
+        sxpi_worker_pool_wait(group->workers);
+    } else if (group->inline_exec) {
+        while (step_modules(group) > 0);
+    }
+    for (int i = 0; i < group->nb_members; i++) {
+        struct async_context *actx = group->members[i];
+        JOIN_MODULE(group, actx, filterer);
+        JOIN_MODULE(group, actx, decoder);
+        JOIN_MODULE_THREAD(actx, fused);
+    }
+    JOIN_MODULE(group, group, demuxer);
 
     // every worker ended, reset queues states
-    av_thread_message_queue_set_err_send(actx->src_queue,    0);
-    av_thread_message_queue_set_err_send(actx->pkt_queue,    0);
-    av_thread_message_queue_set_err_send(actx->frames_queue, 0);
-    av_thread_message_queue_set_err_send(actx->sink_queue,   0);
-    av_thread_message_queue_set_err_recv(actx->src_queue,    0);
-    av_thread_message_queue_set_err_recv(actx->pkt_queue,    0);
-    av_thread_message_queue_set_err_recv(actx->frames_queue, 0);
-    av_thread_message_queue_set_err_recv(actx->sink_queue,   0);
+    set_queues_err(group, 0);
+
+    for (int i = 0; i < group->nb_members; i++) {
+        struct async_context *actx = group->members[i];
+        sxpi_notifier_unlatch(actx->notifier);
+
+        pthread_mutex_lock(&actx->push_lock);
+        actx->push_aborted = 0;
+        actx->push_resumed = 0;
+        pthread_mutex_unlock(&actx->push_lock);
+    }
 }
 
 /* Forward the message to the modules if they are running, otherwise memorize
  * it for next time we start them */
-static int op_seek(struct async_context *actx, struct message *seek_msg)
+static int op_seek(struct async_group *group, struct async_context *origin,
+                   struct message *seek_msg)
 {
-    const struct sxplayer_opts *o = actx->o;
-
-    TRACE(actx, "exec");
+    TRACE(group, "exec");
 
     // We need the demuxer to be initialized to be able to call demuxing_*()
-    int ret = initialize_modules_once(actx, o);
+    int ret = initialize_modules_once(group);
     if (ret < 0) {
-        LOG(actx, ERROR, "initializing modules failed with %s", av_err2str(ret));
+        LOG(group, ERROR, "initializing modules failed with %s", av_err2str(ret));
         sxpi_msg_free_data(seek_msg);
         return ret;
     }
 
-    if (!is_seek_possible(actx)) {
-        TRACE(actx, "can not seek into media, ignoring seek");
+    if (!is_seek_possible(group)) {
+        TRACE(group, "can not seek into media, ignoring seek");
         sxpi_msg_free_data(seek_msg);
         return 0;
     }
 
-    actx->request_seek = *(int64_t *)seek_msg->data;
+    group->request_seek = seek_msg->ts;
+    group->request_seek_precision = seek_msg->seek_precision;
 
-    if (!actx->playing) {
+    if (!group->playing) {
         sxpi_msg_free_data(seek_msg);
         return 0;
     }
 
-    ret = av_thread_message_queue_send(actx->src_queue, seek_msg, 0);
+    for (int i = 0; i < group->nb_members; i++) {
+        struct async_context *actx = group->members[i];
+        if (actx != origin && actx->o->frame_cb)
+            interrupt_deferred_frame(actx);
+    }
+
+    const int seek_id = ++group->seek_id;
+    seek_msg->seek_id = seek_id;
+    ret = send_src_message(group, seek_msg);
     if (ret < 0) {
         /* If this errors out, it means the modules ended by themselves (no
          * stop requested by the user), so we delay the seek, reset the workers
          * and start them again */
         sxpi_msg_free_data(seek_msg);
-        kill_join_reset_workers(actx);
-        return op_start(actx);
+        kill_join_reset_workers(group);
+        return op_start(group, origin);
     }
 
+    wake_modules(group);
+
     // We were able to send a seek request, now we wait for it to return
-    memset(seek_msg, 0, sizeof(*seek_msg));
-    for (;;) {
-        TRACE(actx, "seek request sent, wait for its return");
-        ret = av_thread_message_queue_recv(actx->sink_queue, seek_msg, 0);
-        if (ret < 0) {
-            TRACE(actx, "unable to get request seek back");
-            kill_join_reset_workers(actx);
-            return op_start(actx);
-        }
-        sxpi_msg_free_data(seek_msg);
-        if (seek_msg->type == MSG_SEEK)
-            break;
+    TRACE(group, "seek request sent, wait for its return");
+    ret = wait_seek(group, origin, seek_id);
+    if (ret == AVERROR(EAGAIN)) {
+        TRACE(group, "seek superseded by a newer one, stop waiting for it");
+        return 0;
+    }
+    if (ret < 0) {
+        TRACE(group, "unable to get request seek back");
+        kill_join_reset_workers(group);
+        return op_start(group, origin);
     }
 
+    sxpi_notifier_signal(origin->notifier);
     return 0;
 }
 
-static void op_stop(struct async_context *actx)
+/* The level is kept for the next modules initialization, and applied to the
+ * running decoder (if any) without restarting it */
+static void op_drop_ref(struct async_group *group, struct async_context *origin,
+                        struct message *msg)
 {
-    TRACE(actx, "exec");
+    origin->skip_frame = msg->skip_frame;
+    sxpi_msg_free_data(msg);
+    if (group->modules_initialized)
+        sxpi_decoding_set_skip_frame(origin->decoder, origin->skip_frame);
+}
+
+static void stop_modules(struct async_group *group)
+{
+    kill_join_reset_workers(group);
+
+    sxpi_demuxing_free(&group->demuxer);
+    for (int i = 0; i < group->nb_members; i++) {
+        struct async_context *actx = group->members[i];
+        sxpi_decoding_free(&actx->decoder);
+        sxpi_filtering_free(&actx->filterer);
+        actx->active = 0;
+    }
+
+    group->modules_initialized = 0;
+    group->playing = 0;
+    group->request_seek = AV_NOPTS_VALUE;
+}
+
+/* The modules are shared by the linked contexts, so they are only stopped
+ * once none of them is reading anymore */
+static void op_stop(struct async_group *group, struct async_context *origin)
+{
+    TRACE(group, "exec");
+
+    origin->active = 0;
+    for (int i = 0; i < group->nb_members; i++) {
+        if (group->members[i]->active) {
+            TRACE(group, "modules still read by a linked context");
+            return;
+        }
+    }
+
+    stop_modules(group);
+}
+
+static struct async_context *get_member(const struct async_group *group, const void *origin)
+{
+    for (int i = 0; i < group->nb_members; i++)
+        if (group->members[i] == origin)
+            return group->members[i];
+    return NULL;
+}
+
+/* Must be called with the group lock held */
+static int process_message(struct async_group *group, struct async_context *origin,
+                           struct message *msg)
+{
+    int ret = 0;
+
+    switch (msg->type) {
+    case MSG_SEEK:
+        ret = op_seek(group, origin, msg);
+        break;
+    case MSG_START:
+        // XXX: fetch info first?
+        if (!group->playing)
+            ret = op_start(group, origin);
+        else
+            origin->active = 1;
+        break;
+    case MSG_STOP:
+        if (group->playing)
+            op_stop(group, origin);
+        break;
+    case MSG_INFO:
+        ret = op_info(group, origin, msg);
+        break;
+    case MSG_SYNC:
+        break;
+    case MSG_DROP_REF:
+        op_drop_ref(group, origin, msg);
+        break;
+    default:
+        av_assert0(0);
+    }
+    return ret;
+}
+
+/* Inline execution: the action is processed in the calling thread. Like
+ * with the control thread, a failure stops the modules and every following
+ * action fails the same way. */
+static int run_ctl_message(struct async_context *actx, struct message *msg)
+{
+    struct async_group *group = actx->group;
+    const char *msg_type_str = sxpi_async_get_msg_type_string(msg->type);
+
+    TRACE(actx, "--- run OP %s", msg_type_str);
 
-    kill_join_reset_workers(actx);
+    pthread_mutex_lock(&group->lock);
+    int ret = group->ctl_err;
+    if (ret >= 0) {
+        ret = process_message(group, actx, msg);
+        if (ret < 0) {
+            LOG(group, ERROR, "Unable to honor %s message: %s",
+                msg_type_str, av_err2str(ret));
+            group->ctl_err = ret;
+            stop_modules(group);
+        }
+    }
+    pthread_mutex_unlock(&group->lock);
 
-    sxpi_demuxing_free(&actx->demuxer);
-    sxpi_decoding_free(&actx->decoder);
-    sxpi_filtering_free(&actx->filterer);
+    if (ret < 0)
+        sxpi_msg_free_data(msg);
+    return ret;
+}
 
-    actx->modules_initialized = 0;
-    actx->playing = 0;
-    actx->request_seek = AV_NOPTS_VALUE;
+/* Stops left by queue_eos_stop(), must be called with the group lock held */
+static void process_eos_stops(struct async_group *group)
+{
+    for (int i = 0; i < group->nb_members; i++) {
+        struct async_context *actx = group->members[i];
+        if (__atomic_exchange_n(&actx->push_eos_stop, 0, __ATOMIC_ACQ_REL) && group->playing) {
+            TRACE(group, "--- handling end of stream stop");
+            op_stop(group, actx);
+        }
+    }
 }
 
 static void *control_thread(void *arg)
 {
     int ret = 0;
-    struct async_context *actx = arg;
+    struct async_group *group = arg;
 
-    LOG(actx, INFO, "starting");
+    LOG(group, INFO, "starting");
 
     sxpi_set_thread_name("sxp/control");
 
     for (;;) {
         struct message msg;
-        ret = av_thread_message_queue_recv(actx->ctl_in_queue, &msg, 0);
+        ret = sxpi_msg_fifo_pop(&group->ctl_backlog, &msg);
+        if (ret < 0)
+            ret = sxpi_msg_queue_recv(group->ctl_in_queue, &msg, 0);
         if (ret < 0) {
             if (ret != AVERROR_EXIT) {
-                LOG(actx, ERROR, "Unable to pull a message "
+                LOG(group, ERROR, "Unable to pull a message "
                     "from the async queue: %s", av_err2str(ret));
                 continue;
             }
             break;
         }
 
+        if (msg.type == MSG_SEEK)
+            coalesce_seeks(group, &msg);
+
         enum msg_type type = msg.type;
-        TRACE(actx, "--- handling OP %s", sxpi_async_get_msg_type_string(type));
+        TRACE(group, "--- handling OP %s", sxpi_async_get_msg_type_string(type));
 
-        switch (type) {
-        case MSG_SEEK:
-            ret = op_seek(actx, &msg);
-            break;
-        case MSG_START:
-            // XXX: fetch info first?
-            if (!actx->playing)
-                ret = op_start(actx);
-            break;
-        case MSG_STOP:
-            if (actx->playing)
-                op_stop(actx);
-            break;
-        case MSG_INFO:
-            ret = op_info(actx, &msg);
-            break;
-        case MSG_SYNC:
-            break;
-        default:
-            av_assert0(0);
+        pthread_mutex_lock(&group->lock);
+
+        struct async_context *origin = get_member(group, msg.origin);
+        if (!origin) {
+            TRACE(group, "context left the group, ignoring OP %s",
+                  sxpi_async_get_msg_type_string(type));
+            process_eos_stops(group);
+            pthread_mutex_unlock(&group->lock);
+            sxpi_msg_free_data(&msg);
+            continue;
         }
 
-        TRACE(actx, "<-- OP %s processed", sxpi_async_get_msg_type_string(type));
+        ret = process_message(group, origin, &msg);
+        if (ret >= 0)
+            process_eos_stops(group);
+
+        pthread_mutex_unlock(&group->lock);
+
+        TRACE(group, "<-- OP %s processed", sxpi_async_get_msg_type_string(type));
 
         if (ret < 0) {
-            LOG(actx, ERROR, "Unable to honor %s message: %s",
+            LOG(group, ERROR, "Unable to honor %s message: %s",
                 sxpi_async_get_msg_type_string(type), av_err2str(ret));
             sxpi_msg_free_data(&msg);
             break;
@@ -664,85 +1431,298 @@ static void *control_thread(void *arg)
         // Forward the message to the out queue now that it has been processed
         // if it's a sync OP
         if (type == MSG_INFO || type == MSG_SYNC) {
-            TRACE(actx, "forward %s to control out queue",
+            TRACE(group, "forward %s to control out queue",
                   sxpi_async_get_msg_type_string(type));
-            ret = av_thread_message_queue_send(actx->ctl_out_queue, &msg, 0);
+            ret = sxpi_msg_queue_send(origin->ctl_out_queue, &msg, 0);
             if (ret < 0) {
                 // shouldn't happen
-                LOG(actx, ERROR, "Unable to forward %s message to the output async queue: %s",
+                LOG(group, ERROR, "Unable to forward %s message to the output async queue: %s",
                     sxpi_async_get_msg_type_string(type), av_err2str(ret));
                 sxpi_msg_free_data(&msg);
             }
+            sxpi_notifier_signal(origin->notifier);
         }
     }
 
+    pthread_mutex_lock(&group->lock);
     if (ret < 0) {
-        av_thread_message_queue_set_err_send(actx->ctl_in_queue, ret);
-        av_thread_message_queue_set_err_recv(actx->ctl_out_queue, ret);
+        sxpi_msg_queue_set_err_send(group->ctl_in_queue, ret);
+        for (int i = 0; i < group->nb_members; i++)
+            sxpi_msg_queue_set_err_recv(group->members[i]->ctl_out_queue, ret);
     }
-    TRACE(actx, "control thread ending");
-    op_stop(actx);
+    TRACE(group, "control thread ending");
+    sxpi_msg_fifo_free(&group->ctl_backlog);
+    stop_modules(group);
+    pthread_mutex_unlock(&group->lock);
 
     return NULL;
 }
 
-int sxpi_async_init(struct async_context *actx, void *log_ctx,
-               const char *filename, const struct sxplayer_opts *o)
+static int add_member(struct async_group *group, struct async_context *actx)
 {
-    int ret;
+    struct async_context **members = av_realloc_array(group->members, group->nb_members + 1,
+                                                      sizeof(*members));
+    if (!members)
+        return AVERROR(ENOMEM);
+    members[group->nb_members++] = actx;
+    group->members = members;
+    actx->group = group;
+    return 0;
+}
 
-    av_assert0(!actx->control_started);
+static void remove_member(struct async_group *group, struct async_context *actx)
+{
+    for (int i = 0; i < group->nb_members; i++) {
+        if (group->members[i] == actx) {
+            memmove(&group->members[i], &group->members[i + 1],
+                    (group->nb_members - i - 1) * sizeof(*group->members));
+            group->nb_members--;
+            break;
+        }
+    }
+}
+
+/* Setup the user side and the decoding chain of a context */
+static int init_context(struct async_context *actx, void *log_ctx,
+                        const struct sxplayer_opts *o, AVBufferPool *frame_pool)
+{
+    int ret;
 
     actx->log_ctx = log_ctx;
-    actx->filename = filename;
     actx->o = o;
+    actx->frame_pool = frame_pool;
     actx->thread_stack_size = o->thread_stack_size;
-    actx->request_seek = AV_NOPTS_VALUE;
+    actx->skip_frame = AVDISCARD_DEFAULT;
+    actx->deadline = AV_NOPTS_VALUE;
+    actx->wanted_ts = AV_NOPTS_VALUE;
+
+    actx->notifier = sxpi_notifier_alloc();
+    if (!actx->notifier)
+        return AVERROR(ENOMEM);
+
+    actx->msg_pool = sxpi_msg_pool_alloc(o->max_nb_packets, o->max_nb_frames);
+    if (!actx->msg_pool)
+        return AVERROR(ENOMEM);
 
     TRACE(actx, "alloc modules queues");
-    if ((ret = alloc_msg_queue(&actx->src_queue,    1))                 < 0 ||
-        (ret = alloc_msg_queue(&actx->pkt_queue,    o->max_nb_packets)) < 0 ||
-        (ret = alloc_msg_queue(&actx->frames_queue, o->max_nb_frames))  < 0 ||
-        (ret = alloc_msg_queue(&actx->sink_queue,   o->max_nb_sink))    < 0)
+    if ((ret = sxpi_msg_queue_alloc(&actx->pkt_queue,    o->max_nb_packets)) < 0 ||
+        (ret = sxpi_msg_queue_alloc(&actx->frames_queue, o->max_nb_frames))  < 0 ||
+        (ret = sxpi_msg_queue_alloc(&actx->sink_queue,   o->max_nb_sink))    < 0)
         return ret;
 
     TRACE(actx, "allocate async queues");
-    if ((ret = alloc_msg_queue(&actx->ctl_in_queue,  5)) < 0 ||
-        (ret = alloc_msg_queue(&actx->ctl_out_queue, 5)) < 0)
+    return sxpi_msg_queue_alloc(&actx->ctl_out_queue, 5);
+}
+
+int sxpi_async_init(struct async_context *actx, void *log_ctx,
+               const char *filename, const struct sxplayer_opts *o,
+               AVBufferPool *frame_pool)
+{
+    int ret;
+
+    av_assert0(!actx->group);
+
+    ret = init_context(actx, log_ctx, o, frame_pool);
+    if (ret < 0)
+        return ret;
+
+    struct async_group *group = av_mallocz(sizeof(*group));
+    if (!group)
+        return AVERROR(ENOMEM);
+    pthread_mutex_init(&group->lock, NULL);
+    pthread_mutex_init(&group->seek_wait_lock, NULL);
+    group->log_ctx = log_ctx;
+    group->filename = filename;
+    group->o = o;
+    group->thread_stack_size = o->thread_stack_size;
+    group->request_seek = AV_NOPTS_VALUE;
+
+    ret = add_member(group, actx);
+    if (ret < 0) {
+        pthread_mutex_destroy(&group->lock);
+        pthread_mutex_destroy(&group->seek_wait_lock);
+        av_free(group);
+        return ret;
+    }
+
+    group->seek_index = sxpi_seek_index_alloc();
+    if (!group->seek_index)
+        return AVERROR(ENOMEM);
+
+    if (o->packet_cache_size) {
+        group->shared_input = sxpi_shared_input_acquire(filename, o);
+        if (!group->shared_input)
+            return AVERROR(ENOMEM);
+    }
+
+    if (o->exec_mode == SXPLAYER_EXEC_POOL) {
+        group->workers = sxpi_worker_pool_create_set();
+        if (!group->workers)
+            return AVERROR(ENOMEM);
+    } else if (o->exec_mode == SXPLAYER_EXEC_INLINE) {
+        if (o->frame_cb)
+            LOG(group, WARNING, "The frame callback needs the modules to run on "
+                "their own, running them in threads instead of inline");
+        else
+            group->inline_exec = 1;
+    }
+
+    TRACE(group, "alloc demuxer and control queues");
+    if ((ret = sxpi_msg_queue_alloc(&group->src_queue,    1)) < 0 ||
+        (ret = sxpi_msg_queue_alloc(&group->ctl_in_queue, 5)) < 0)
         return ret;
 
-    START_MODULE_THREAD(control);
-    if (!actx->control_started)
+    if (group->inline_exec)
+        return 0;
+
+    START_MODULE_THREAD(group, control);
+    if (!group->control_started)
         return AVERROR(ENOMEM); // XXX
 
     return 0;
 }
 
+int sxpi_async_init_linked(struct async_context *actx, void *log_ctx,
+                           const struct sxplayer_opts *o, AVBufferPool *frame_pool,
+                           struct async_context *master)
+{
+    av_assert0(!actx->group);
+
+    int ret = init_context(actx, log_ctx, o, frame_pool);
+    if (ret < 0)
+        return ret;
+
+    struct async_group *group = master->group;
+    pthread_mutex_lock(&group->lock);
+    if (group->modules_initialized) {
+        LOG(actx, ERROR, "Modules are already initialized, can not link the context");
+        ret = AVERROR(EINVAL);
+    } else if (group->inline_exec && o->frame_cb) {
+        LOG(actx, ERROR, "The frame callback can not be used with a context "
+            "executed inline");
+        ret = AVERROR(EINVAL);
+    } else {
+        ret = add_member(group, actx);
+        actx->linked = ret >= 0;
+    }
+    pthread_mutex_unlock(&group->lock);
+    return ret;
+}
+
 const char *sxpi_async_get_msg_type_string(enum msg_type type)
 {
     static const char * const s[NB_MSG] = {
-        [MSG_FRAME]  = "frame",
-        [MSG_PACKET] = "packet",
-        [MSG_SEEK]   = "seek",
-        [MSG_INFO]   = "info",
-        [MSG_START]  = "start",
-        [MSG_STOP]   = "stop",
-        [MSG_SYNC]   = "sync",
+        [MSG_FRAME]    = "frame",
+        [MSG_PACKET]   = "packet",
+        [MSG_SEEK]     = "seek",
+        [MSG_INFO]     = "info",
+        [MSG_START]    = "start",
+        [MSG_STOP]     = "stop",
+        [MSG_SYNC]     = "sync",
+        [MSG_DROP_REF] = "drop_ref",
     };
     return s[type];
 }
 
-static void control_quit(struct async_context *actx)
+static void control_quit(struct async_group *group, struct async_context *actx)
 {
     sxpi_async_stop(actx);
     sync_control_thread(actx);
-    av_thread_message_queue_set_err_send(actx->ctl_in_queue,  AVERROR_EXIT);
-    av_thread_message_queue_set_err_send(actx->ctl_out_queue, AVERROR_EXIT);
-    av_thread_message_queue_set_err_recv(actx->ctl_in_queue,  AVERROR_EXIT);
-    av_thread_message_queue_set_err_recv(actx->ctl_out_queue, AVERROR_EXIT);
-    av_thread_message_flush(actx->ctl_in_queue);
-    av_thread_message_flush(actx->ctl_out_queue);
-    JOIN_MODULE_THREAD(control);
+    sxpi_msg_queue_set_err_send(group->ctl_in_queue, AVERROR_EXIT);
+    sxpi_msg_queue_set_err_send(actx->ctl_out_queue, AVERROR_EXIT);
+    sxpi_msg_queue_set_err_recv(group->ctl_in_queue, AVERROR_EXIT);
+    sxpi_msg_queue_set_err_recv(actx->ctl_out_queue, AVERROR_EXIT);
+    sxpi_msg_queue_flush(group->ctl_in_queue);
+    sxpi_msg_queue_flush(actx->ctl_out_queue);
+    JOIN_MODULE_THREAD(group, control);
+}
+
+static void leave_group(struct async_context *actx)
+{
+    struct async_group *group = actx->group;
+
+    actx->deadline = AV_NOPTS_VALUE;
+
+    pthread_mutex_lock(&group->lock);
+    const int last = group->nb_members == 1;
+    if (!last) {
+        /* The demuxer has an output for this context, so all the modules are
+         * stopped to be initialized again without it on the next start */
+        av_assert0(group->members[0] != actx);
+        const int64_t request_seek = group->request_seek;
+        stop_modules(group);
+        group->request_seek = request_seek;
+        remove_member(group, actx);
+    }
+    pthread_mutex_unlock(&group->lock);
+
+    if (!last)
+        return;
+
+    if (group->control_started) {
+        control_quit(group, actx);
+    } else if (group->inline_exec) {
+        pthread_mutex_lock(&group->lock);
+        stop_modules(group);
+        pthread_mutex_unlock(&group->lock);
+    }
+
+    sxpi_msg_queue_free(&group->src_queue);
+    sxpi_msg_queue_free(&group->ctl_in_queue);
+
+    sxpi_seek_index_free(&group->seek_index);
+    sxpi_shared_input_release(&group->shared_input);
+    sxpi_worker_pool_free_set(&group->workers);
+
+    pthread_mutex_destroy(&group->lock);
+    pthread_mutex_destroy(&group->seek_wait_lock);
+    av_freep(&group->members);
+    av_freep(&actx->group);
+}
+
+int sxpi_async_get_event_fd(struct async_context *actx)
+{
+    int ret = sxpi_notifier_init(actx->notifier);
+    if (ret < 0)
+        return ret;
+    return sxpi_notifier_get_fd(actx->notifier);
+}
+
+void sxpi_async_update_event(struct async_context *actx, int user_pending)
+{
+    sxpi_notifier_clear(actx->notifier);
+    if (user_pending || sxpi_msg_queue_nb_elems(actx->sink_queue) > 0)
+        sxpi_notifier_signal(actx->notifier);
+}
+
+int sxpi_async_get_keyframes(struct async_context *actx, double *timestamps, int max_nb)
+{
+    return sxpi_seek_index_get_timestamps(actx->group->seek_index, timestamps, max_nb);
+}
+
+void sxpi_async_get_stats(struct async_context *actx, struct sxplayer_stats *stats)
+{
+    struct shared_input_stats si_stats;
+
+    if (actx->msg_pool)
+        sxpi_msg_pool_get_stats(actx->msg_pool, &stats->msg_pool_allocs, &stats->msg_pool_reuses);
+    if (!actx->group)
+        return;
+    stats->media_cache_hits = __atomic_load_n(&actx->group->media_cache_hits, __ATOMIC_RELAXED);
+    if (!actx->group->shared_input)
+        return;
+    sxpi_shared_input_get_stats(actx->group->shared_input, &si_stats);
+    stats->packet_cache_hits   = si_stats.hits;
+    stats->packet_cache_misses = si_stats.misses;
+    stats->packet_cache_size   = si_stats.size;
+}
+
+int sxpi_async_get_prev_keyframe(struct async_context *actx, int64_t ts, int64_t *pts)
+{
+    /* The index is expressed in the time base of the first member stream */
+    if (actx->linked)
+        return 0;
+    return sxpi_seek_index_get_prev(actx->group->seek_index, ts, pts);
 }
 
 int sxpi_sxpi_async_started(struct async_context *actx)
@@ -750,7 +1730,7 @@ int sxpi_sxpi_async_started(struct async_context *actx)
     int ret = sync_control_thread(actx);
     if (ret < 0)
         return ret;
-    return actx->playing;
+    return actx->group->playing;
 }
 
 void sxpi_async_free(struct async_context **actxp)
@@ -760,15 +1740,24 @@ void sxpi_async_free(struct async_context **actxp)
     if (!actx)
         return;
 
-    control_quit(actx);
+    if (actx->group)
+        leave_group(actx);
+
+    sxpi_msg_queue_free(&actx->pkt_queue);
+    sxpi_msg_queue_free(&actx->frames_queue);
+    sxpi_msg_queue_free(&actx->sink_queue);
+
+    sxpi_msg_queue_free(&actx->ctl_out_queue);
+
+    sxpi_msg_pool_free(&actx->msg_pool);
+
+    sxpi_notifier_free(&actx->notifier);
 
-    av_thread_message_queue_free(&actx->src_queue);
-    av_thread_message_queue_free(&actx->pkt_queue);
-    av_thread_message_queue_free(&actx->frames_queue);
-    av_thread_message_queue_free(&actx->sink_queue);
+    sxpi_filtering_free(&actx->converter);
 
-    av_thread_message_queue_free(&actx->ctl_in_queue);
-    av_thread_message_queue_free(&actx->ctl_out_queue);
+    pthread_mutex_destroy(&actx->push_lock);
+    pthread_cond_destroy(&actx->push_cond);
+    pthread_mutex_destroy(&actx->convert_lock);
 
     TRACE(actx, "free done");
 
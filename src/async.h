@@ -22,6 +22,7 @@
 #define ASYNC_H
 
 #include <stdint.h>
+#include <libavcodec/avcodec.h>
 
 #include "sxplayer.h"
 #include "opts.h"
@@ -34,18 +35,68 @@ void sxpi_msg_free_data(void *arg);
 struct async_context *sxpi_async_alloc_context(void);
 
 int sxpi_async_init(struct async_context *actx, void *log_ctx,
-                    const char *filename, const struct sxplayer_opts *o);
+                    const char *filename, const struct sxplayer_opts *o,
+                    AVBufferPool *frame_pool);
+
+/*
+ * Make the context read another stream of the media of master, sharing its
+ * demuxer. This must be done before the modules are initialized, and the
+ * linked contexts must be freed before master.
+ */
+int sxpi_async_init_linked(struct async_context *actx, void *log_ctx,
+                           const struct sxplayer_opts *o, AVBufferPool *frame_pool,
+                           struct async_context *master);
 
 int sxpi_async_start(struct async_context *actx);
 
 int sxpi_async_fetch_info(struct async_context *actx, struct sxplayer_info *info);
 
-int sxpi_async_seek(struct async_context *actx, int64_t ts);
+int sxpi_async_seek(struct async_context *actx, int64_t ts, int precision);
 
 int sxpi_async_pop_frame(struct async_context *actx, AVFrame **framep);
 
+/*
+ * Filter a frame obtained with sxpi_async_pop_frame() right before it is
+ * returned to the user, if the filtering is lazy; the frame is replaced with
+ * its filtered version, and left untouched on error.
+ */
+int sxpi_async_convert_frame(struct async_context *actx, AVFrame **framep);
+
 int sxpi_async_stop(struct async_context *actx);
 
+/*
+ * Make the frame fetching and the synchronization with the control thread
+ * give up with AVERROR(EAGAIN) once the deadline (av_gettime_relative() time)
+ * is reached, AV_NOPTS_VALUE to wait indefinitely.
+ */
+void sxpi_async_set_deadline(struct async_context *actx, int64_t deadline);
+
+int sxpi_async_set_skip_frame(struct async_context *actx, enum AVDiscard skip_frame);
+
+/*
+ * Tell the decoder the timestamp (in stream time base) of the frame the user
+ * waits for, AV_NOPTS_VALUE if any frame is wanted. The frames superseded
+ * before that time are dropped instead of being filtered, and the non
+ * reference ones are not decoded. It must be reset before requesting a seek
+ * or a start to an earlier time.
+ */
+void sxpi_async_set_wanted_ts(struct async_context *actx, int64_t ts);
+
+int sxpi_async_resume_frames(struct async_context *actx);
+
+int sxpi_async_get_event_fd(struct async_context *actx);
+
+/* Make the event descriptor readable only if a frame is waiting in the sink,
+ * or on the user side (user_pending) */
+void sxpi_async_update_event(struct async_context *actx, int user_pending);
+
+int sxpi_async_get_keyframes(struct async_context *actx, double *timestamps, int max_nb);
+
+/* Fill the statistics of the modules shared with other contexts */
+void sxpi_async_get_stats(struct async_context *actx, struct sxplayer_stats *stats);
+
+int sxpi_async_get_prev_keyframe(struct async_context *actx, int64_t ts, int64_t *pts);
+
 int sxpi_sxpi_async_started(struct async_context *actx);
 
 void sxpi_async_free(struct async_context **actxp);
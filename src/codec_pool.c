@@ -0,0 +1,257 @@
+/*
+ * This file is part of sxplayer.
+ *
+ * Copyright (c) 2016 Stupeflix
+ *
+ * sxplayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * sxplayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with sxplayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <libavutil/common.h>
+#include <libavutil/mem.h>
+
+#include "codec_pool.h"
+#include "internal.h"
+#include "pthread_compat.h"
+
+struct codec_pool_user {
+    int max_jobs;
+    struct codec_pool_user *next;
+};
+
+/* Jobs of one execute() call, the caller waiting for all of them */
+struct batch {
+    AVCodecContext *avctx;
+    int (*func)(AVCodecContext *c, void *arg);
+    int (*func2)(AVCodecContext *c, void *arg, int jobnr, int threadnr);
+    char *arg;
+    int size;
+    int *ret;
+    int count;
+    int next_job;           // next job to hand out
+    int nb_runners;         // runners started so far, each with its own threadnr
+    int max_runners;        // the codec has per thread data for thread_count runners
+    int nb_active;          // runners not done yet
+    struct batch *next;
+};
+
+/* Starting and stopping the threads is serialized by the users lock, the
+ * scheduling is protected by the pool lock */
+static pthread_mutex_t users_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct codec_pool_user *users;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;    // new batch, or a runner slot freed
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;    // the last runner of a batch is done
+static pthread_t threads[CODEC_POOL_MAX_JOBS];
+static int nb_threads;
+static int max_jobs;        // largest value requested by the users
+static int nb_running;
+static int quit;
+static struct batch *pending;   // batches which may still need runners, oldest first
+
+/* Must be called with the pool lock held */
+static void unlink_batch(struct batch *b)
+{
+    for (struct batch **bp = &pending; *bp; bp = &(*bp)->next) {
+        if (*bp == b) {
+            *bp = b->next;
+            return;
+        }
+    }
+}
+
+static struct batch *get_batch(void)
+{
+    while (pending && (pending->next_job == pending->count ||
+                       pending->nb_runners == pending->max_runners))
+        pending = pending->next;
+    return pending;
+}
+
+static void run_job(struct batch *b, int jobnr, int threadnr)
+{
+    const int ret = b->func2 ? b->func2(b->avctx, b->arg, jobnr, threadnr)
+                             : b->func(b->avctx, b->arg + jobnr * b->size);
+    if (b->ret)
+        b->ret[jobnr] = ret;
+}
+
+static void *worker_thread(void *arg)
+{
+    sxpi_set_thread_name("sxp/codec");
+
+    pthread_mutex_lock(&pool_lock);
+    for (;;) {
+        if (quit)
+            break;
+        struct batch *b = get_batch();
+        if (!b || nb_running >= max_jobs) {
+            pthread_cond_wait(&work_cond, &pool_lock);
+            continue;
+        }
+
+        const int threadnr = b->nb_runners++;
+        b->nb_active++;
+        nb_running++;
+        while (b->next_job < b->count) {
+            const int jobnr = b->next_job++;
+            pthread_mutex_unlock(&pool_lock);
+            run_job(b, jobnr, threadnr);
+            pthread_mutex_lock(&pool_lock);
+        }
+        nb_running--;
+        if (!--b->nb_active)
+            pthread_cond_broadcast(&done_cond);
+        pthread_cond_signal(&work_cond);
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    return NULL;
+}
+
+static int execute_batch(struct batch *b)
+{
+    b->max_runners = FFMIN(b->avctx->thread_count, b->count);
+
+    /* Nothing to parallelize, the caller runs the jobs itself */
+    if (b->max_runners <= 1) {
+        for (int i = 0; i < b->count; i++)
+            run_job(b, i, 0);
+        return 0;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    struct batch **bp = &pending;
+    while (*bp)
+        bp = &(*bp)->next;
+    *bp = b;
+    pthread_cond_broadcast(&work_cond);
+    while (b->next_job < b->count || b->nb_active)
+        pthread_cond_wait(&done_cond, &pool_lock);
+    unlink_batch(b);
+    pthread_mutex_unlock(&pool_lock);
+    return 0;
+}
+
+static int pool_execute(AVCodecContext *avctx, int (*func)(AVCodecContext *c, void *arg),
+                        void *arg, int *ret, int count, int size)
+{
+    struct batch b = {
+        .avctx = avctx,
+        .func  = func,
+        .arg   = arg,
+        .size  = size,
+        .ret   = ret,
+        .count = count,
+    };
+    return execute_batch(&b);
+}
+
+static int pool_execute2(AVCodecContext *avctx, int (*func)(AVCodecContext *c, void *arg, int jobnr, int threadnr),
+                         void *arg, int *ret, int count)
+{
+    struct batch b = {
+        .avctx = avctx,
+        .func2 = func,
+        .arg   = arg,
+        .ret   = ret,
+        .count = count,
+    };
+    return execute_batch(&b);
+}
+
+/* Must be called with the users lock held; the threads are never stopped
+ * before the last user leaves, the extra ones just stay idle if the cap
+ * decreases */
+static void update_max_jobs(void)
+{
+    int n = 0;
+    for (const struct codec_pool_user *user = users; user; user = user->next)
+        n = FFMAX(n, user->max_jobs);
+
+    pthread_mutex_lock(&pool_lock);
+    max_jobs = n;
+    pthread_cond_broadcast(&work_cond);
+    while (nb_threads < max_jobs) {
+        if (pthread_create(&threads[nb_threads], NULL, worker_thread, NULL))
+            break;
+        nb_threads++;
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
+struct codec_pool_user *sxpi_codec_pool_acquire(int nb_jobs)
+{
+    struct codec_pool_user *user = av_mallocz(sizeof(*user));
+    if (!user)
+        return NULL;
+    user->max_jobs = av_clip(nb_jobs, 1, CODEC_POOL_MAX_JOBS);
+
+    pthread_mutex_lock(&users_lock);
+    user->next = users;
+    users = user;
+    update_max_jobs();
+    const int started = nb_threads > 0;
+    pthread_mutex_unlock(&users_lock);
+
+    if (!started)
+        sxpi_codec_pool_release(&user);
+    return user;
+}
+
+void sxpi_codec_pool_setup(const struct codec_pool_user *user, AVCodecContext *avctx)
+{
+    avctx->thread_type  = FF_THREAD_SLICE;
+    avctx->thread_count = user->max_jobs;
+}
+
+void sxpi_codec_pool_attach(AVCodecContext *avctx)
+{
+    if (!(avctx->active_thread_type & FF_THREAD_SLICE))
+        return;
+    avctx->execute  = pool_execute;
+    avctx->execute2 = pool_execute2;
+}
+
+void sxpi_codec_pool_release(struct codec_pool_user **userp)
+{
+    struct codec_pool_user *user = *userp;
+    if (!user)
+        return;
+
+    pthread_mutex_lock(&users_lock);
+    for (struct codec_pool_user **up = &users; *up; up = &(*up)->next) {
+        if (*up == user) {
+            *up = user->next;
+            break;
+        }
+    }
+    if (users) {
+        update_max_jobs();
+    } else {
+        pthread_mutex_lock(&pool_lock);
+        quit = 1;
+        pthread_cond_broadcast(&work_cond);
+        pthread_mutex_unlock(&pool_lock);
+        for (int i = 0; i < nb_threads; i++)
+            pthread_join(threads[i], NULL);
+        nb_threads = 0;
+        max_jobs = 0;
+        quit = 0;
+    }
+    pthread_mutex_unlock(&users_lock);
+
+    av_freep(userp);
+}
@@ -0,0 +1,44 @@
+/*
+ * This file is part of sxplayer.
+ *
+ * Copyright (c) 2016 Stupeflix
+ *
+ * sxplayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * sxplayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with sxplayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef CODEC_POOL_H
+#define CODEC_POOL_H
+
+#include <libavcodec/avcodec.h>
+
+#define CODEC_POOL_MAX_JOBS 128
+
+/*
+ * Register a user of the process-wide codec thread pool. The pool runs at
+ * most max_jobs slice jobs at a time, all codecs included, max_jobs being the
+ * largest value requested by the registered users.
+ */
+struct codec_pool_user *sxpi_codec_pool_acquire(int max_jobs);
+
+/* Set the threading of the codec before opening it */
+void sxpi_codec_pool_setup(const struct codec_pool_user *user, AVCodecContext *avctx);
+
+/* Make the opened codec run its slice jobs on the pool instead of its own
+ * threads */
+void sxpi_codec_pool_attach(AVCodecContext *avctx);
+
+void sxpi_codec_pool_release(struct codec_pool_user **userp);
+
+#endif
@@ -26,6 +26,7 @@
 #include <libavutil/pixdesc.h>
 #include <libavutil/pixfmt.h>
 
+#include "codec_pool.h"
 #include "mod_decoding.h"
 #include "decoders.h"
 #include "internal.h"
@@ -141,13 +142,37 @@ static int init_vaapi(struct decoder_ctx *ctx)
 }
 #endif
 
+struct ffdec_sw {
+    struct codec_pool_user *pool_user;
+};
+
 static int ffdec_init_sw(struct decoder_ctx *ctx, const struct sxplayer_opts *opts)
 {
+    struct ffdec_sw *ffdec = ctx->priv_data;
     AVCodecContext *avctx = ctx->avctx;
     avctx->thread_count = 0;
 
+    if (opts->codec_threads) {
+        ffdec->pool_user = sxpi_codec_pool_acquire(opts->codec_threads);
+        if (!ffdec->pool_user)
+            return AVERROR(ENOMEM);
+        sxpi_codec_pool_setup(ffdec->pool_user, avctx);
+    }
+
     const AVCodec *codec = avcodec_find_decoder(avctx->codec_id);
-    return avcodec_open2(avctx, codec, NULL);
+    int ret = avcodec_open2(avctx, codec, NULL);
+    if (ret < 0)
+        return ret;
+
+    if (ffdec->pool_user)
+        sxpi_codec_pool_attach(avctx);
+    return 0;
+}
+
+static void ffdec_uninit_sw(struct decoder_ctx *ctx)
+{
+    struct ffdec_sw *ffdec = ctx->priv_data;
+    sxpi_codec_pool_release(&ffdec->pool_user);
 }
 
 static int ffdec_init_hw(struct decoder_ctx *ctx, const struct sxplayer_opts *opts)
@@ -189,7 +214,7 @@ static int ffdec_push_packet(struct decoder_ctx *ctx, const AVPacket *pkt)
         const int draining = flush && pkt_consumed;
         int64_t next_pts = AV_NOPTS_VALUE;
         while (ret >= 0 || (draining && ret == AVERROR(EAGAIN))) {
-            AVFrame *dec_frame = av_frame_alloc();
+            AVFrame *dec_frame = sxpi_decoding_get_frame(ctx->decoding_ctx);
 
             if (!dec_frame)
                 return AVERROR(ENOMEM);
@@ -199,7 +224,7 @@ static int ffdec_push_packet(struct decoder_ctx *ctx, const AVPacket *pkt)
                 LOG(ctx, ERROR, "Error receiving frame from %s decoder: %s",
                     av_get_media_type_string(avctx->codec_type),
                     av_err2str(ret));
-                    av_frame_free(&dec_frame);
+                sxpi_decoding_release_frame(ctx->decoding_ctx, &dec_frame);
                 return ret;
             }
 
@@ -220,11 +245,11 @@ static int ffdec_push_packet(struct decoder_ctx *ctx, const AVPacket *pkt)
                 ret = sxpi_decoding_queue_frame(ctx->decoding_ctx, dec_frame);
                 if (ret < 0) {
                     TRACE(ctx, "Could not queue frame: %s", av_err2str(ret));
-                    av_frame_free(&dec_frame);
+                    sxpi_decoding_release_frame(ctx->decoding_ctx, &dec_frame);
                     return ret;
                 }
             } else {
-                av_frame_free(&dec_frame);
+                sxpi_decoding_release_frame(ctx->decoding_ctx, &dec_frame);
             }
         }
     }
@@ -247,8 +272,10 @@ static void ffdec_flush(struct decoder_ctx *ctx)
 const struct decoder sxpi_decoder_ffmpeg_sw = {
     .name        = "ffmpeg_sw",
     .init        = ffdec_init_sw,
+    .uninit      = ffdec_uninit_sw,
     .push_packet = ffdec_push_packet,
     .flush       = ffdec_flush,
+    .priv_data_size = sizeof(struct ffdec_sw),
 };
 
 const struct decoder sxpi_decoder_ffmpeg_hw = {
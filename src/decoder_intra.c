@@ -0,0 +1,356 @@
+/*
+ * This file is part of sxplayer.
+ *
+ * Copyright (c) 2016 Stupeflix
+ *
+ * sxplayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * sxplayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with sxplayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <libavcodec/avcodec.h>
+#include <libavutil/mem.h>
+
+#include "mod_decoding.h"
+#include "decoders.h"
+#include "internal.h"
+#include "log.h"
+#include "pthread_compat.h"
+
+/*
+ * Decoder of the intra-only video streams spreading the packets over several
+ * independent codec contexts, each one decoding in its own worker thread.
+ * Since no frame references another, the packets are decoded in any order;
+ * the frames are then queued in the order of their packets, which is also
+ * their presentation order with such streams.
+ */
+
+enum job_state {
+    JOB_PENDING,            // submitted, waiting for a worker
+    JOB_RUNNING,
+    JOB_DONE,
+};
+
+struct intra_job {
+    AVPacket *pkt;
+    AVFrame *frame;         // taken from the frames pool by the submitter
+    enum AVDiscard skip_frame;
+    enum job_state state;
+    int got_frame;
+    int ret;
+};
+
+struct intra_worker {
+    struct decoder_ctx *ctx;
+    AVCodecContext *avctx;
+    pthread_t tid;
+    int started;
+};
+
+struct ffdec_intra {
+    int sync_init;
+    pthread_mutex_t lock;
+    pthread_cond_t job_cond;    // a job was submitted, or the workers must quit
+    pthread_cond_t done_cond;   // a job is done
+    struct intra_job *jobs;     // ring of the jobs, in submission order
+    int nb_jobs;
+    int64_t nb_submitted;
+    int64_t nb_taken;           // jobs picked by the workers
+    int64_t nb_output;          // jobs whose frame was queued or dropped
+    int quit;
+    struct intra_worker *workers;
+    int nb_workers;
+};
+
+static void decode_job(struct intra_worker *w, struct intra_job *job)
+{
+    AVCodecContext *avctx = w->avctx;
+
+    avctx->skip_frame = job->skip_frame;
+    job->got_frame = 0;
+    job->ret = avcodec_send_packet(avctx, job->pkt);
+    av_packet_unref(job->pkt);
+    if (job->ret < 0)
+        return;
+
+    /* Without any threading, the frame comes out right away unless it is
+     * skipped */
+    job->ret = avcodec_receive_frame(avctx, job->frame);
+    if (job->ret == AVERROR(EAGAIN))
+        job->ret = 0;
+    else if (job->ret >= 0)
+        job->got_frame = 1;
+}
+
+static void *worker_thread(void *arg)
+{
+    struct intra_worker *w = arg;
+    struct ffdec_intra *s = w->ctx->priv_data;
+
+    sxpi_set_thread_name("sxp/intradec");
+
+    pthread_mutex_lock(&s->lock);
+    while (!s->quit) {
+        if (s->nb_taken == s->nb_submitted) {
+            pthread_cond_wait(&s->job_cond, &s->lock);
+            continue;
+        }
+        struct intra_job *job = &s->jobs[s->nb_taken++ % s->nb_jobs];
+        job->state = JOB_RUNNING;
+        pthread_mutex_unlock(&s->lock);
+
+        decode_job(w, job);
+
+        pthread_mutex_lock(&s->lock);
+        job->state = JOB_DONE;
+        pthread_cond_signal(&s->done_cond);
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    return NULL;
+}
+
+static int ffdec_init_intra(struct decoder_ctx *ctx, const struct sxplayer_opts *opts)
+{
+    struct ffdec_intra *s = ctx->priv_data;
+    int ret;
+
+    const AVCodec *codec = avcodec_find_decoder(ctx->avctx->codec_id);
+    if (!codec)
+        return AVERROR_DECODER_NOT_FOUND;
+
+    if (pthread_mutex_init(&s->lock, NULL))
+        return AVERROR(ENOMEM);
+    if (pthread_cond_init(&s->job_cond, NULL)) {
+        pthread_mutex_destroy(&s->lock);
+        return AVERROR(ENOMEM);
+    }
+    if (pthread_cond_init(&s->done_cond, NULL)) {
+        pthread_cond_destroy(&s->job_cond);
+        pthread_mutex_destroy(&s->lock);
+        return AVERROR(ENOMEM);
+    }
+    s->sync_init = 1;
+
+    /* One job being decoded and one waiting for each worker */
+    s->nb_workers = opts->intra_decoders;
+    s->nb_jobs = 2 * s->nb_workers;
+    s->workers = av_calloc(s->nb_workers, sizeof(*s->workers));
+    s->jobs = av_calloc(s->nb_jobs, sizeof(*s->jobs));
+    if (!s->workers || !s->jobs)
+        return AVERROR(ENOMEM);
+    for (int i = 0; i < s->nb_jobs; i++) {
+        s->jobs[i].pkt = av_packet_alloc();
+        if (!s->jobs[i].pkt)
+            return AVERROR(ENOMEM);
+    }
+
+    /* The context of the decoder is left unopened: it only holds the stream
+     * parameters and the skip frame level given to the workers */
+    AVCodecParameters *par = avcodec_parameters_alloc();
+    if (!par)
+        return AVERROR(ENOMEM);
+    ret = avcodec_parameters_from_context(par, ctx->avctx);
+
+    for (int i = 0; ret >= 0 && i < s->nb_workers; i++) {
+        struct intra_worker *w = &s->workers[i];
+        w->ctx = ctx;
+        w->avctx = avcodec_alloc_context3(NULL);
+        if (!w->avctx) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        ret = avcodec_parameters_to_context(w->avctx, par);
+        if (ret < 0)
+            break;
+        w->avctx->pkt_timebase = ctx->avctx->pkt_timebase;
+
+        /* The parallelism comes from the workers */
+        w->avctx->thread_count = 1;
+
+        ret = avcodec_open2(w->avctx, codec, NULL);
+        if (ret < 0)
+            break;
+
+        ret = pthread_create(&w->tid, NULL, worker_thread, w);
+        if (ret) {
+            ret = AVERROR(ret);
+            break;
+        }
+        w->started = 1;
+    }
+
+    avcodec_parameters_free(&par);
+    if (ret < 0)
+        return ret;
+
+    TRACE(ctx, "decoding with %d workers", s->nb_workers);
+    return 0;
+}
+
+static void ffdec_uninit_intra(struct decoder_ctx *ctx)
+{
+    struct ffdec_intra *s = ctx->priv_data;
+
+    if (!s->sync_init)
+        return;
+
+    pthread_mutex_lock(&s->lock);
+    s->quit = 1;
+    pthread_cond_broadcast(&s->job_cond);
+    pthread_mutex_unlock(&s->lock);
+
+    for (int i = 0; s->workers && i < s->nb_workers; i++) {
+        struct intra_worker *w = &s->workers[i];
+        if (w->started)
+            pthread_join(w->tid, NULL);
+        avcodec_free_context(&w->avctx);
+    }
+    av_freep(&s->workers);
+
+    for (int i = 0; s->jobs && i < s->nb_jobs; i++) {
+        av_packet_free(&s->jobs[i].pkt);
+        av_frame_free(&s->jobs[i].frame);
+    }
+    av_freep(&s->jobs);
+
+    pthread_cond_destroy(&s->done_cond);
+    pthread_cond_destroy(&s->job_cond);
+    pthread_mutex_destroy(&s->lock);
+}
+
+static int queue_job_frame(struct decoder_ctx *ctx, struct intra_job *job)
+{
+    AVFrame *frame = job->frame;
+    job->frame = NULL;
+
+    if (job->ret < 0) {
+        LOG(ctx, ERROR, "Error decoding video packet: %s", av_err2str(job->ret));
+        sxpi_decoding_release_frame(ctx->decoding_ctx, &frame);
+        return job->ret;
+    }
+
+    if (!job->got_frame) {
+        sxpi_decoding_release_frame(ctx->decoding_ctx, &frame);
+        return 0;
+    }
+
+    const int ret = sxpi_decoding_queue_frame(ctx->decoding_ctx, frame);
+    if (ret < 0) {
+        TRACE(ctx, "Could not queue frame: %s", av_err2str(ret));
+        sxpi_decoding_release_frame(ctx->decoding_ctx, &frame);
+    }
+    return ret;
+}
+
+/* Queue the frames of the jobs done, in submission order, waiting for the
+ * ones submitted before wait_until */
+static int output_jobs(struct decoder_ctx *ctx, int64_t wait_until)
+{
+    struct ffdec_intra *s = ctx->priv_data;
+    int ret = 0;
+
+    pthread_mutex_lock(&s->lock);
+    while (s->nb_output < s->nb_submitted) {
+        struct intra_job *job = &s->jobs[s->nb_output % s->nb_jobs];
+        if (job->state != JOB_DONE) {
+            if (s->nb_output >= wait_until)
+                break;
+            pthread_cond_wait(&s->done_cond, &s->lock);
+            continue;
+        }
+
+        /* Only the submitter (this thread) reuses the job */
+        s->nb_output++;
+        pthread_mutex_unlock(&s->lock);
+        ret = queue_job_frame(ctx, job);
+        pthread_mutex_lock(&s->lock);
+        if (ret < 0)
+            break;
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    return ret;
+}
+
+static int ffdec_push_packet_intra(struct decoder_ctx *ctx, const AVPacket *pkt)
+{
+    struct ffdec_intra *s = ctx->priv_data;
+    const int pkt_size = pkt ? pkt->size : 0;
+    int ret;
+
+    TRACE(ctx, "Received packet of size %d", pkt_size);
+
+    if (!pkt_size) {
+        ret = output_jobs(ctx, s->nb_submitted);
+        if (ret < 0)
+            return ret;
+        return sxpi_decoding_queue_frame(ctx->decoding_ctx, NULL);
+    }
+
+    /* Make room for the new job, waiting for the oldest one if needed */
+    ret = output_jobs(ctx, s->nb_submitted - s->nb_jobs + 1);
+    if (ret < 0)
+        return ret;
+
+    struct intra_job *job = &s->jobs[s->nb_submitted % s->nb_jobs];
+    job->frame = sxpi_decoding_get_frame(ctx->decoding_ctx);
+    if (!job->frame)
+        return AVERROR(ENOMEM);
+    ret = av_packet_ref(job->pkt, pkt);
+    if (ret < 0) {
+        sxpi_decoding_release_frame(ctx->decoding_ctx, &job->frame);
+        return ret;
+    }
+    job->skip_frame = ctx->avctx->skip_frame;
+    job->state = JOB_PENDING;
+
+    pthread_mutex_lock(&s->lock);
+    s->nb_submitted++;
+    pthread_cond_signal(&s->job_cond);
+    pthread_mutex_unlock(&s->lock);
+
+    return 0;
+}
+
+/* The frames of the jobs in progress are dropped, like the ones a codec
+ * holds when it is flushed */
+static void ffdec_flush_intra(struct decoder_ctx *ctx)
+{
+    struct ffdec_intra *s = ctx->priv_data;
+
+    pthread_mutex_lock(&s->lock);
+    while (s->nb_output < s->nb_submitted) {
+        struct intra_job *job = &s->jobs[s->nb_output % s->nb_jobs];
+        if (job->state != JOB_DONE) {
+            pthread_cond_wait(&s->done_cond, &s->lock);
+            continue;
+        }
+        sxpi_decoding_release_frame(ctx->decoding_ctx, &job->frame);
+        s->nb_output++;
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    /* The workers are all idle now */
+    for (int i = 0; i < s->nb_workers; i++)
+        avcodec_flush_buffers(s->workers[i].avctx);
+}
+
+const struct decoder sxpi_decoder_ffmpeg_intra = {
+    .name        = "ffmpeg_intra",
+    .init        = ffdec_init_intra,
+    .uninit      = ffdec_uninit_intra,
+    .push_packet = ffdec_push_packet_intra,
+    .flush       = ffdec_flush_intra,
+    .priv_data_size = sizeof(struct ffdec_intra),
+};
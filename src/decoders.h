@@ -26,6 +26,8 @@
 
 #include "opts.h"
 
+#define MAX_INTRA_DECODERS 64
+
 struct decoding_ctx;
 
 struct decoder_ctx {
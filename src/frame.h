@@ -0,0 +1,48 @@
+/*
+ * This file is part of sxplayer.
+ *
+ * Copyright (c) 2015 Stupeflix
+ *
+ * sxplayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * sxplayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with sxplayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+#include <libavutil/rational.h>
+
+#include "opts.h"
+#include "sxplayer.h"
+
+/*
+ * Pool of user frames. The user may release frames after the context is
+ * freed, so the pool is only uninitialized by the owner and actually freed
+ * with its last frame.
+ */
+AVBufferPool *sxpi_frame_pool_init(void);
+
+/*
+ * Wrap a filtered frame into a user frame from the pool, to be released with
+ * sxpi_frame_release(). The ownership of the AVFrame is transferred to the
+ * returned frame, and it is freed on error (NULL returned).
+ */
+struct sxplayer_frame *sxpi_frame_wrap(AVBufferPool *pool, AVFrame *frame,
+                                       AVRational st_timebase, const struct sxplayer_opts *o);
+
+void sxpi_frame_release(struct sxplayer_frame *frame);
+
+#endif
@@ -0,0 +1,215 @@
+/*
+ * This file is part of sxplayer.
+ *
+ * Copyright (c) 2015 Stupeflix
+ *
+ * sxplayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * sxplayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with sxplayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+#include <libavutil/avutil.h>
+#include <libavutil/mem.h>
+
+#include "frame_cache.h"
+
+struct cache_entry {
+    int64_t pts;
+    int64_t end_pts;    // pts of the next frame, AV_NOPTS_VALUE if unknown
+    AVFrame *frame;
+    int64_t size;
+    uint64_t last_use;
+};
+
+/*
+ * The entries are sorted by pts so the frame displayed at a given time can
+ * be found with a binary search; the least recently used entry is searched
+ * linearly on eviction, which only happens when a new frame is added.
+ */
+struct frame_cache {
+    struct cache_entry *entries;
+    int nb_entries;
+    unsigned entries_size;
+    int64_t size;
+    int64_t max_size;
+    int use_pkt_duration;
+    uint64_t clock;
+};
+
+struct frame_cache *sxpi_frame_cache_alloc(void)
+{
+    return av_mallocz(sizeof(struct frame_cache));
+}
+
+int sxpi_frame_cache_init(struct frame_cache *c, int64_t max_size, int use_pkt_duration)
+{
+    c->max_size = max_size;
+    c->use_pkt_duration = use_pkt_duration;
+    return 0;
+}
+
+/* Index of the last entry with a pts lower or equal to ts, -1 if none */
+static int search_entry(const struct frame_cache *c, int64_t ts)
+{
+    int lo = 0, hi = c->nb_entries - 1, ret = -1;
+
+    while (lo <= hi) {
+        const int mid = (lo + hi) >> 1;
+        if (c->entries[mid].pts <= ts) {
+            ret = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return ret;
+}
+
+static int64_t get_frame_size(const AVFrame *frame)
+{
+    int64_t size = sizeof(*frame);
+    for (int i = 0; i < FF_ARRAY_ELEMS(frame->buf) && frame->buf[i]; i++)
+        size += frame->buf[i]->size;
+    for (int i = 0; i < frame->nb_extended_buf; i++)
+        size += frame->extended_buf[i]->size;
+    return size;
+}
+
+static void remove_entry(struct frame_cache *c, int i)
+{
+    struct cache_entry *e = &c->entries[i];
+    c->size -= e->size;
+    av_frame_free(&e->frame);
+    memmove(e, e + 1, (c->nb_entries - i - 1) * sizeof(*e));
+    c->nb_entries--;
+}
+
+static void evict(struct frame_cache *c, int64_t needed)
+{
+    while (c->nb_entries && c->size + needed > c->max_size) {
+        int lru = 0;
+        for (int i = 1; i < c->nb_entries; i++)
+            if (c->entries[i].last_use < c->entries[lru].last_use)
+                lru = i;
+        remove_entry(c, lru);
+    }
+}
+
+int sxpi_frame_cache_add(struct frame_cache *c, const AVFrame *frame, int64_t prev_pts)
+{
+    if (frame->pts == AV_NOPTS_VALUE)
+        return 0;
+
+    /* Hardware frames are backed by a small pool of decoder surfaces which
+     * must not be retained */
+    if (frame->hw_frames_ctx)
+        return 0;
+
+    const int64_t size = get_frame_size(frame);
+    if (size > c->max_size)
+        return 0;
+
+    int i = search_entry(c, frame->pts);
+    if (i >= 0 && c->entries[i].pts == frame->pts) {
+        c->entries[i].last_use = ++c->clock;
+    } else {
+        AVFrame *ref = av_frame_clone(frame);
+        if (!ref)
+            return AVERROR(ENOMEM);
+
+        evict(c, size);
+
+        struct cache_entry *entries = av_fast_realloc(c->entries, &c->entries_size,
+                                                      (c->nb_entries + 1) * sizeof(*entries));
+        if (!entries) {
+            av_frame_free(&ref);
+            return AVERROR(ENOMEM);
+        }
+        c->entries = entries;
+        i = search_entry(c, frame->pts) + 1;
+        memmove(&entries[i + 1], &entries[i], (c->nb_entries - i) * sizeof(*entries));
+        entries[i].pts      = frame->pts;
+        entries[i].end_pts  = AV_NOPTS_VALUE;
+        entries[i].frame    = ref;
+        entries[i].size     = size;
+        entries[i].last_use = ++c->clock;
+        c->nb_entries++;
+        c->size += size;
+    }
+
+    if (prev_pts != AV_NOPTS_VALUE && i > 0 && c->entries[i - 1].pts == prev_pts)
+        c->entries[i - 1].end_pts = frame->pts;
+
+    return 0;
+}
+
+static AVFrame *get_entry_frame(struct frame_cache *c, int i)
+{
+    struct cache_entry *e = &c->entries[i];
+    e->last_use = ++c->clock;
+    return av_frame_clone(e->frame);
+}
+
+AVFrame *sxpi_frame_cache_get(struct frame_cache *c, int64_t ts)
+{
+    const int i = search_entry(c, ts);
+    if (i < 0)
+        return NULL;
+
+    const struct cache_entry *e = &c->entries[i];
+    int64_t end_pts = e->end_pts;
+    if (end_pts == AV_NOPTS_VALUE && c->use_pkt_duration && e->frame->pkt_duration > 0)
+        end_pts = e->pts + e->frame->pkt_duration;
+
+    if (e->pts != ts && (end_pts == AV_NOPTS_VALUE || ts >= end_pts))
+        return NULL;
+    return get_entry_frame(c, i);
+}
+
+AVFrame *sxpi_frame_cache_get_exact(struct frame_cache *c, int64_t pts)
+{
+    const int i = search_entry(c, pts);
+    if (i < 0 || c->entries[i].pts != pts)
+        return NULL;
+    return get_entry_frame(c, i);
+}
+
+AVFrame *sxpi_frame_cache_get_next(struct frame_cache *c, int64_t pts)
+{
+    const int i = search_entry(c, pts);
+    if (i < 0 || c->entries[i].pts != pts || c->entries[i].end_pts == AV_NOPTS_VALUE)
+        return NULL;
+    return sxpi_frame_cache_get_exact(c, c->entries[i].end_pts);
+}
+
+int64_t sxpi_frame_cache_get_size(const struct frame_cache *c)
+{
+    return c->size;
+}
+
+int sxpi_frame_cache_get_nb_frames(const struct frame_cache *c)
+{
+    return c->nb_entries;
+}
+
+void sxpi_frame_cache_free(struct frame_cache **cp)
+{
+    struct frame_cache *c = *cp;
+    if (!c)
+        return;
+    for (int i = 0; i < c->nb_entries; i++)
+        av_frame_free(&c->entries[i].frame);
+    av_freep(&c->entries);
+    av_freep(cp);
+}
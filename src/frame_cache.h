@@ -0,0 +1,54 @@
+/*
+ * This file is part of sxplayer.
+ *
+ * Copyright (c) 2015 Stupeflix
+ *
+ * sxplayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * sxplayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with sxplayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef FRAME_CACHE_H
+#define FRAME_CACHE_H
+
+#include <stdint.h>
+#include <libavutil/frame.h>
+
+struct frame_cache *sxpi_frame_cache_alloc(void);
+
+int sxpi_frame_cache_init(struct frame_cache *c, int64_t max_size, int use_pkt_duration);
+
+/*
+ * Keep a reference to the frame. If prev_pts is set, it is the pts of the
+ * frame preceding this one in presentation order, which is then known to be
+ * displayed until this frame pts.
+ */
+int sxpi_frame_cache_add(struct frame_cache *c, const AVFrame *frame, int64_t prev_pts);
+
+/* Return a new reference to the frame displayed at ts, or NULL if unknown */
+AVFrame *sxpi_frame_cache_get(struct frame_cache *c, int64_t ts);
+
+/* Return a new reference to the frame with this exact pts, or NULL */
+AVFrame *sxpi_frame_cache_get_exact(struct frame_cache *c, int64_t pts);
+
+/* Return a new reference to the frame following the one with this exact pts,
+ * or NULL if they were not cached contiguously */
+AVFrame *sxpi_frame_cache_get_next(struct frame_cache *c, int64_t pts);
+
+int64_t sxpi_frame_cache_get_size(const struct frame_cache *c);
+
+int sxpi_frame_cache_get_nb_frames(const struct frame_cache *c);
+
+void sxpi_frame_cache_free(struct frame_cache **cp);
+
+#endif
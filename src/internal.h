@@ -30,6 +30,8 @@
 
 #include "sxplayer.h"
 
+struct AVCodecParameters;
+
 #ifdef __ANDROID__
 #define HAVE_MEDIACODEC_HWACCEL 1
 #else
@@ -45,6 +47,7 @@ enum sxplayer_pixel_format sxpi_pix_fmts_ff2sx(enum AVPixelFormat pix_fmt);
 enum sxplayer_pixel_format sxpi_smp_fmts_ff2sx(enum AVSampleFormat smp_fmt);
 void sxpi_set_thread_name(const char *name);
 void sxpi_update_dimensions(int *width, int *height, int max_pixels);
+int sxpi_is_intra_only(const struct AVCodecParameters *par);
 
 #define TIME2INT64(d) llrint((d) * av_q2d(av_inv_q(AV_TIME_BASE_Q)))
 #define PTS2TIMESTR(t64) av_ts2timestr(t64, &AV_TIME_BASE_Q)
@@ -0,0 +1,392 @@
+/*
+ * This file is part of sxplayer.
+ *
+ * Copyright (c) 2015 Stupeflix
+ *
+ * sxplayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * sxplayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with sxplayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <libavformat/avio.h>
+#include <libavutil/avstring.h>
+#include <libavutil/common.h>
+#include <libavutil/intfloat.h>
+#include <libavutil/mem.h>
+#include <libavutil/time.h>
+
+#include "media_cache.h"
+#include "internal.h"
+#include "log.h"
+
+#define CACHE_MAGIC   MKTAG('S','X','P','C')
+#define CACHE_VERSION 1
+
+#define MAX_PATH_LEN       (1 << 16)
+#define MAX_EXTRADATA_SIZE (1 << 28)
+#define MAX_NB_KEYFRAMES   (1 << 26)
+
+struct media_cache {
+    void *log_ctx;
+    char *path;                 // sidecar file path
+
+    /* Cache key: the same media must be re-probed if any of these change */
+    char *filename;
+    int64_t size;
+    int64_t mtime;
+    int avselect;
+    int stream_idx;
+
+    struct media_info info;
+    int loaded;
+};
+
+static uint64_t hash_data(uint64_t h, const uint8_t *data, size_t size)
+{
+    /* 64-bit FNV-1a */
+    for (size_t i = 0; i < size; i++) {
+        h ^= data[i];
+        h *= UINT64_C(0x100000001b3);
+    }
+    return h;
+}
+
+static uint64_t hash_u64(uint64_t h, uint64_t v)
+{
+    uint8_t buf[8];
+    for (int i = 0; i < 8; i++)
+        buf[i] = v >> (i * 8);
+    return hash_data(h, buf, sizeof(buf));
+}
+
+struct media_cache *sxpi_media_cache_open(void *log_ctx,
+                                          const char *filename,
+                                          const struct sxplayer_opts *opts)
+{
+    struct stat st;
+
+    if (stat(filename, &st) < 0 || !S_ISREG(st.st_mode))
+        return NULL;
+
+    struct media_cache *c = av_mallocz(sizeof(*c));
+    if (!c)
+        return NULL;
+
+    c->log_ctx    = log_ctx;
+    c->size       = st.st_size;
+    c->mtime      = st.st_mtime;
+    c->avselect   = opts->avselect;
+    c->stream_idx = opts->stream_idx;
+    c->filename   = av_strdup(filename);
+    if (!c->filename)
+        goto fail;
+
+    uint64_t h = UINT64_C(0xcbf29ce484222325);
+    h = hash_data(h, (const uint8_t *)filename, strlen(filename));
+    h = hash_u64(h, c->size);
+    h = hash_u64(h, c->mtime);
+    h = hash_u64(h, c->avselect);
+    h = hash_u64(h, c->stream_idx);
+
+    c->path = av_asprintf("%s/sxplayer-%016"PRIx64".cache", opts->cache_dir, h);
+    if (!c->path)
+        goto fail;
+
+    TRACE(c, "cache file for %s: %s", filename, c->path);
+    return c;
+
+fail:
+    sxpi_media_cache_close(&c);
+    return NULL;
+}
+
+static void reset_info(struct media_info *info)
+{
+    avcodec_parameters_free(&info->codecpar);
+    av_freep(&info->keyframes);
+    memset(info, 0, sizeof(*info));
+}
+
+static int read_key(struct media_cache *c, AVIOContext *pb)
+{
+    const unsigned len = avio_rl32(pb);
+    if (len != strlen(c->filename))
+        return AVERROR_INVALIDDATA;
+
+    char *filename = av_malloc(len + 1);
+    if (!filename)
+        return AVERROR(ENOMEM);
+    const int n = avio_read(pb, (unsigned char *)filename, len);
+    filename[FFMAX(n, 0)] = 0;
+    const int same_file = n == len && !strcmp(filename, c->filename);
+    av_free(filename);
+
+    if (!same_file                        ||
+        avio_rl64(pb) != c->size          ||
+        avio_rl64(pb) != c->mtime         ||
+        (int)avio_rl32(pb) != c->avselect ||
+        (int)avio_rl32(pb) != c->stream_idx)
+        return AVERROR_INVALIDDATA;
+    return 0;
+}
+
+static int read_codecpar(AVIOContext *pb, AVCodecParameters *par)
+{
+    par->codec_type            = (int)avio_rl32(pb);
+    par->codec_id              = (int)avio_rl32(pb);
+    par->codec_tag             = avio_rl32(pb);
+    par->format                = (int)avio_rl32(pb);
+    par->bit_rate              = avio_rl64(pb);
+    par->bits_per_coded_sample = (int)avio_rl32(pb);
+    par->bits_per_raw_sample   = (int)avio_rl32(pb);
+    par->profile               = (int)avio_rl32(pb);
+    par->level                 = (int)avio_rl32(pb);
+    par->width                 = (int)avio_rl32(pb);
+    par->height                = (int)avio_rl32(pb);
+    par->sample_aspect_ratio.num = (int)avio_rl32(pb);
+    par->sample_aspect_ratio.den = (int)avio_rl32(pb);
+    par->field_order           = (int)avio_rl32(pb);
+    par->color_range           = (int)avio_rl32(pb);
+    par->color_primaries       = (int)avio_rl32(pb);
+    par->color_trc             = (int)avio_rl32(pb);
+    par->color_space           = (int)avio_rl32(pb);
+    par->chroma_location       = (int)avio_rl32(pb);
+    par->video_delay           = (int)avio_rl32(pb);
+    par->channel_layout        = avio_rl64(pb);
+    par->channels              = (int)avio_rl32(pb);
+    par->sample_rate           = (int)avio_rl32(pb);
+    par->block_align           = (int)avio_rl32(pb);
+    par->frame_size            = (int)avio_rl32(pb);
+    par->initial_padding       = (int)avio_rl32(pb);
+    par->trailing_padding      = (int)avio_rl32(pb);
+    par->seek_preroll          = (int)avio_rl32(pb);
+
+    const unsigned extradata_size = avio_rl32(pb);
+    if (extradata_size > MAX_EXTRADATA_SIZE)
+        return AVERROR_INVALIDDATA;
+    if (extradata_size) {
+        par->extradata = av_mallocz(extradata_size + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!par->extradata)
+            return AVERROR(ENOMEM);
+        par->extradata_size = extradata_size;
+        if (avio_read(pb, par->extradata, extradata_size) != extradata_size)
+            return AVERROR_INVALIDDATA;
+    }
+    return 0;
+}
+
+static int read_cache(struct media_cache *c, AVIOContext *pb)
+{
+    struct media_info *info = &c->info;
+
+    if (avio_rl32(pb) != CACHE_MAGIC || avio_rl32(pb) != CACHE_VERSION)
+        return AVERROR_INVALIDDATA;
+
+    int ret = read_key(c, pb);
+    if (ret < 0)
+        return ret;
+
+    const unsigned format_name_len = avio_rl32(pb);
+    if (format_name_len >= sizeof(info->format_name))
+        return AVERROR_INVALIDDATA;
+    if (avio_read(pb, (unsigned char *)info->format_name, format_name_len) != format_name_len)
+        return AVERROR_INVALIDDATA;
+    info->format_name[format_name_len] = 0;
+
+    info->stream_idx    = (int)avio_rl32(pb);
+    info->time_base.num = (int)avio_rl32(pb);
+    info->time_base.den = (int)avio_rl32(pb);
+    info->duration      = avio_rl64(pb);
+    info->rotation      = av_int2double(avio_rl64(pb));
+
+    info->codecpar = avcodec_parameters_alloc();
+    if (!info->codecpar)
+        return AVERROR(ENOMEM);
+    ret = read_codecpar(pb, info->codecpar);
+    if (ret < 0)
+        return ret;
+
+    const unsigned nb_keyframes = avio_rl32(pb);
+    if (nb_keyframes > MAX_NB_KEYFRAMES)
+        return AVERROR_INVALIDDATA;
+    if (nb_keyframes) {
+        info->keyframes = av_malloc_array(nb_keyframes, sizeof(*info->keyframes));
+        if (!info->keyframes)
+            return AVERROR(ENOMEM);
+        for (int i = 0; i < nb_keyframes; i++) {
+            struct seek_index_entry *e = &info->keyframes[i];
+            e->pts        = avio_rl64(pb);
+            e->pos        = avio_rl64(pb);
+            e->contiguous = avio_r8(pb);
+        }
+        info->nb_keyframes = nb_keyframes;
+    }
+
+    if (pb->eof_reached || pb->error)
+        return AVERROR_INVALIDDATA;
+    return 0;
+}
+
+const struct media_info *sxpi_media_cache_get(struct media_cache *c)
+{
+    AVIOContext *pb;
+
+    if (c->loaded)
+        return &c->info;
+
+    int ret = avio_open(&pb, c->path, AVIO_FLAG_READ);
+    if (ret < 0) {
+        TRACE(c, "no cache file %s: %s", c->path, av_err2str(ret));
+        return NULL;
+    }
+    ret = read_cache(c, pb);
+    avio_closep(&pb);
+    if (ret < 0) {
+        LOG(c, WARNING, "Ignoring invalid or outdated cache file %s: %s",
+            c->path, av_err2str(ret));
+        reset_info(&c->info);
+        return NULL;
+    }
+
+    LOG(c, INFO, "Loaded media information from %s", c->path);
+    c->loaded = 1;
+    return &c->info;
+}
+
+static void write_codecpar(AVIOContext *pb, const AVCodecParameters *par)
+{
+    avio_wl32(pb, par->codec_type);
+    avio_wl32(pb, par->codec_id);
+    avio_wl32(pb, par->codec_tag);
+    avio_wl32(pb, par->format);
+    avio_wl64(pb, par->bit_rate);
+    avio_wl32(pb, par->bits_per_coded_sample);
+    avio_wl32(pb, par->bits_per_raw_sample);
+    avio_wl32(pb, par->profile);
+    avio_wl32(pb, par->level);
+    avio_wl32(pb, par->width);
+    avio_wl32(pb, par->height);
+    avio_wl32(pb, par->sample_aspect_ratio.num);
+    avio_wl32(pb, par->sample_aspect_ratio.den);
+    avio_wl32(pb, par->field_order);
+    avio_wl32(pb, par->color_range);
+    avio_wl32(pb, par->color_primaries);
+    avio_wl32(pb, par->color_trc);
+    avio_wl32(pb, par->color_space);
+    avio_wl32(pb, par->chroma_location);
+    avio_wl32(pb, par->video_delay);
+    avio_wl64(pb, par->channel_layout);
+    avio_wl32(pb, par->channels);
+    avio_wl32(pb, par->sample_rate);
+    avio_wl32(pb, par->block_align);
+    avio_wl32(pb, par->frame_size);
+    avio_wl32(pb, par->initial_padding);
+    avio_wl32(pb, par->trailing_padding);
+    avio_wl32(pb, par->seek_preroll);
+    avio_wl32(pb, par->extradata_size);
+    avio_write(pb, par->extradata, par->extradata_size);
+}
+
+static void write_cache(struct media_cache *c, AVIOContext *pb, const struct media_info *info)
+{
+    const size_t filename_len = strlen(c->filename);
+    const size_t format_name_len = strlen(info->format_name);
+
+    avio_wl32(pb, CACHE_MAGIC);
+    avio_wl32(pb, CACHE_VERSION);
+
+    avio_wl32(pb, filename_len);
+    avio_write(pb, (const unsigned char *)c->filename, filename_len);
+    avio_wl64(pb, c->size);
+    avio_wl64(pb, c->mtime);
+    avio_wl32(pb, c->avselect);
+    avio_wl32(pb, c->stream_idx);
+
+    avio_wl32(pb, format_name_len);
+    avio_write(pb, (const unsigned char *)info->format_name, format_name_len);
+    avio_wl32(pb, info->stream_idx);
+    avio_wl32(pb, info->time_base.num);
+    avio_wl32(pb, info->time_base.den);
+    avio_wl64(pb, info->duration);
+    avio_wl64(pb, av_double2int(info->rotation));
+
+    write_codecpar(pb, info->codecpar);
+
+    avio_wl32(pb, info->nb_keyframes);
+    for (int i = 0; i < info->nb_keyframes; i++) {
+        const struct seek_index_entry *e = &info->keyframes[i];
+        avio_wl64(pb, e->pts);
+        avio_wl64(pb, e->pos);
+        avio_w8(pb, e->contiguous);
+    }
+}
+
+int sxpi_media_cache_store(struct media_cache *c, const struct media_info *info)
+{
+    AVIOContext *pb;
+
+    if (strlen(c->filename) >= MAX_PATH_LEN)
+        return AVERROR(EINVAL);
+
+    /* Write to a temporary file first so concurrent readers never see a
+     * partially written cache file */
+    char *tmp_path = av_asprintf("%s.%"PRIx64".tmp", c->path,
+                                 (uint64_t)av_gettime() ^ (uint64_t)(uintptr_t)c);
+    if (!tmp_path)
+        return AVERROR(ENOMEM);
+
+    int ret = avio_open(&pb, tmp_path, AVIO_FLAG_WRITE);
+    if (ret < 0) {
+        LOG(c, WARNING, "Unable to create cache file %s: %s", tmp_path, av_err2str(ret));
+        av_free(tmp_path);
+        return ret;
+    }
+    write_cache(c, pb, info);
+    ret = pb->error;
+    const int close_ret = avio_closep(&pb);
+    if (ret >= 0)
+        ret = close_ret;
+
+    if (ret >= 0 && rename(tmp_path, c->path) < 0) {
+        /* rename() does not replace an existing file on Windows */
+        remove(c->path);
+        if (rename(tmp_path, c->path) < 0)
+            ret = AVERROR(errno);
+    }
+
+    if (ret < 0) {
+        LOG(c, WARNING, "Unable to write cache file %s: %s", c->path, av_err2str(ret));
+        remove(tmp_path);
+    } else {
+        TRACE(c, "media information saved to %s", c->path);
+    }
+
+    av_free(tmp_path);
+    return ret;
+}
+
+void sxpi_media_cache_close(struct media_cache **cp)
+{
+    struct media_cache *c = *cp;
+    if (!c)
+        return;
+    reset_info(&c->info);
+    av_freep(&c->filename);
+    av_freep(&c->path);
+    av_freep(cp);
+}
@@ -0,0 +1,54 @@
+/*
+ * This file is part of sxplayer.
+ *
+ * Copyright (c) 2015 Stupeflix
+ *
+ * sxplayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * sxplayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with sxplayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef MEDIA_CACHE_H
+#define MEDIA_CACHE_H
+
+#include <stdint.h>
+#include <libavcodec/avcodec.h>
+
+#include "opts.h"
+#include "seek_index.h"
+
+/* Everything the demuxer needs to skip avformat_find_stream_info() */
+struct media_info {
+    char format_name[64];
+    int stream_idx;
+    AVRational time_base;
+    int64_t duration;
+    double rotation;
+    AVCodecParameters *codecpar;
+    struct seek_index_entry *keyframes;
+    int nb_keyframes;
+};
+
+/* Return NULL if the media can not be cached (not a local file) */
+struct media_cache *sxpi_media_cache_open(void *log_ctx,
+                                          const char *filename,
+                                          const struct sxplayer_opts *opts);
+
+/* Return NULL on cache miss */
+const struct media_info *sxpi_media_cache_get(struct media_cache *c);
+
+int sxpi_media_cache_store(struct media_cache *c, const struct media_info *info);
+
+void sxpi_media_cache_close(struct media_cache **cp);
+
+#endif
@@ -27,9 +27,11 @@
 #include "internal.h"
 #include "msg.h"
 #include "log.h"
+#include "pthread_compat.h"
 
 extern const struct decoder sxpi_decoder_ffmpeg_sw;
 extern const struct decoder sxpi_decoder_ffmpeg_hw;
+extern const struct decoder sxpi_decoder_ffmpeg_intra;
 static const struct decoder *decoder_def_software = &sxpi_decoder_ffmpeg_sw;
 
 #if __APPLE__
@@ -42,17 +44,35 @@ static const struct decoder *decoder_def_hwaccel = &sxpi_decoder_ffmpeg_hw;
 struct decoding_ctx {
     void *log_ctx;
 
-    AVThreadMessageQueue *pkt_queue;
-    AVThreadMessageQueue *frames_queue;
+    struct msg_queue *pkt_queue;
+    struct msg_queue *frames_queue;
+    struct msg_pool *msg_pool;              // packets and frames of the queues
 
     int is_image;
+    int intra_only;                         // nothing references the frames skipped before the wanted time
     int frame_count;
 
     struct decoder_ctx *decoder;
 
     AVRational st_timebase;
+    int64_t pkt_duration;                   // estimated duration of the packets without one, 0 if unknown
     AVFrame *tmp_frame;
+    struct message held_pkt;                // intra-only: latest packet skipped before the wanted time
     int64_t seek_request;
+    const int64_t *wanted_ts;               // time the user waits for, updated atomically by the user thread
+
+    pthread_mutex_t skip_frame_lock;
+    enum AVDiscard skip_frame;              // requested by the control thread
+
+    /* fused filtering: the messages are handed to this callback instead of
+     * the frames queue, which is then only used to notify the end */
+    int (*output_cb)(void *opaque, struct message *msg);
+    void *output_opaque;
+
+    int nonblock;                           // stepping without ever waiting for the frames queue
+    int end_ret;                            // reason of the end of decoding, 0 while running
+    pthread_mutex_t pending_lock;           // frames may be queued from the decoder threads
+    struct msg_fifo pending;                // messages the frames queue could not take yet
 };
 
 struct decoding_ctx *sxpi_decoding_alloc(void)
@@ -60,14 +80,74 @@ struct decoding_ctx *sxpi_decoding_alloc(void)
     struct decoding_ctx *ctx = av_mallocz(sizeof(*ctx));
     if (!ctx)
         return NULL;
+    if (pthread_mutex_init(&ctx->skip_frame_lock, NULL)) {
+        av_freep(&ctx);
+        return NULL;
+    }
+    if (pthread_mutex_init(&ctx->pending_lock, NULL)) {
+        pthread_mutex_destroy(&ctx->skip_frame_lock);
+        av_freep(&ctx);
+        return NULL;
+    }
     ctx->decoder = sxpi_decoder_alloc();
     if (!ctx->decoder) {
+        pthread_mutex_destroy(&ctx->pending_lock);
+        pthread_mutex_destroy(&ctx->skip_frame_lock);
         av_freep(&ctx);
         return NULL;
     }
+    ctx->seek_request = AV_NOPTS_VALUE;
     return ctx;
 }
 
+void sxpi_decoding_set_skip_frame(struct decoding_ctx *ctx, enum AVDiscard skip_frame)
+{
+    pthread_mutex_lock(&ctx->skip_frame_lock);
+    ctx->skip_frame = skip_frame;
+    pthread_mutex_unlock(&ctx->skip_frame_lock);
+}
+
+/* Time the user waits for (in stream time base), either the target of the
+ * latest seek until it is reached, or the hint of the user */
+static int64_t get_wanted_ts(const struct decoding_ctx *ctx)
+{
+    if (ctx->seek_request != AV_NOPTS_VALUE)
+        return ctx->seek_request;
+    return ctx->wanted_ts ? __atomic_load_n(ctx->wanted_ts, __ATOMIC_RELAXED) : AV_NOPTS_VALUE;
+}
+
+/*
+ * A packet is only decoded to reach the wanted time if the frame following it
+ * is still before that time: its frame will be dropped, and if nothing
+ * references it, it does not need to be decoded at all.
+ */
+static int is_preroll_packet(const struct decoding_ctx *ctx, const AVPacket *pkt)
+{
+    const int64_t wanted_ts = get_wanted_ts(ctx);
+    const int64_t duration = pkt->duration > 0 ? pkt->duration : ctx->pkt_duration;
+    return wanted_ts != AV_NOPTS_VALUE &&
+           pkt->pts != AV_NOPTS_VALUE && duration > 0 &&
+           pkt->pts + duration <= wanted_ts;
+}
+
+/* The level can be changed at any time, it is honored from the next packet */
+static void update_skip_frame(struct decoding_ctx *ctx, const AVPacket *pkt)
+{
+    AVCodecContext *avctx = ctx->decoder->avctx;
+
+    pthread_mutex_lock(&ctx->skip_frame_lock);
+    enum AVDiscard skip_frame = ctx->skip_frame;
+    pthread_mutex_unlock(&ctx->skip_frame_lock);
+
+    if (skip_frame < AVDISCARD_NONREF && !(pkt->flags & AV_PKT_FLAG_KEY) && is_preroll_packet(ctx, pkt))
+        skip_frame = AVDISCARD_NONREF;
+
+    if (avctx->skip_frame != skip_frame) {
+        TRACE(ctx, "skip frame level changed from %d to %d", avctx->skip_frame, skip_frame);
+        avctx->skip_frame = skip_frame;
+    }
+}
+
 const AVCodecContext *sxpi_decoding_get_avctx(struct decoding_ctx *ctx)
 {
     return ctx->decoder->avctx;
@@ -75,11 +155,15 @@ const AVCodecContext *sxpi_decoding_get_avctx(struct decoding_ctx *ctx)
 
 int sxpi_decoding_init(void *log_ctx,
                        struct decoding_ctx *ctx,
-                       AVThreadMessageQueue *pkt_queue,
-                       AVThreadMessageQueue *frames_queue,
+                       struct msg_queue *pkt_queue,
+                       struct msg_queue *frames_queue,
+                       struct msg_pool *msg_pool,
                        int is_image,
                        const AVStream *stream,
-                       const struct sxplayer_opts *opts)
+                       const struct sxplayer_opts *opts,
+                       const int64_t *wanted_ts,
+                       int (*output_cb)(void *opaque, struct message *msg),
+                       void *output_opaque)
 {
     int ret;
     const struct decoder *dec_def, *dec_def_fallback;
@@ -91,9 +175,17 @@ int sxpi_decoding_init(void *log_ctx,
     ctx->log_ctx = log_ctx;
     ctx->pkt_queue = pkt_queue;
     ctx->frames_queue = frames_queue;
+    ctx->msg_pool = msg_pool;
+    ctx->wanted_ts = wanted_ts;
+    ctx->output_cb = output_cb;
+    ctx->output_opaque = output_opaque;
     ctx->is_image = is_image;
+    ctx->intra_only = !is_image && sxpi_is_intra_only(stream->codecpar);
 
-    if (opts->auto_hwaccel && decoder_def_hwaccel) {
+    if (ctx->intra_only && opts->intra_decoders > 1) {
+        dec_def          = &sxpi_decoder_ffmpeg_intra;
+        dec_def_fallback = decoder_def_software;
+    } else if (opts->auto_hwaccel && decoder_def_hwaccel) {
         dec_def          = decoder_def_hwaccel;
         dec_def_fallback = decoder_def_software;
     } else {
@@ -103,6 +195,14 @@ int sxpi_decoding_init(void *log_ctx,
 
     ctx->st_timebase = stream->time_base;
 
+    /* Many containers do not store the packet durations: they are estimated
+     * from the frame rate when it is constant, rounded up so no frame is
+     * wrongly considered superseded */
+    if (stream->avg_frame_rate.num > 0 && stream->avg_frame_rate.den > 0 &&
+        !av_cmp_q(stream->avg_frame_rate, stream->r_frame_rate))
+        ctx->pkt_duration = av_rescale_q_rnd(1, av_inv_q(stream->avg_frame_rate),
+                                             stream->time_base, AV_ROUND_UP);
+
 #define DUMP_INFO(par, name) do {                                       \
     if ((par)->codec_type == AVMEDIA_TYPE_AUDIO) {                      \
         char chl[1024];                                                 \
@@ -139,7 +239,8 @@ int sxpi_decoding_init(void *log_ctx,
     avcodec_parameters_from_context(par, ctx->decoder->avctx);
     DUMP_INFO(par, "initialized");
 
-    LOG(ctx, INFO, "selected decoder: %s", ctx->decoder->dec->name);
+    LOG(ctx, INFO, "selected decoder: %s%s", ctx->decoder->dec->name,
+        ctx->intra_only ? " (intra-only)" : "");
 
     avcodec_parameters_free(&par);
 
@@ -152,12 +253,65 @@ static int64_t get_best_effort_ts(const AVFrame *f)
     return t != AV_NOPTS_VALUE ? t : f->pts;
 }
 
+/* When stepping, the messages the queue can not take yet are kept aside
+ * (after the ones already waiting) instead of waiting for the filterer */
+static int send_message(struct decoding_ctx *ctx, struct message *msg)
+{
+    /* The frames may be queued from the decoder threads */
+    if (ctx->output_cb) {
+        pthread_mutex_lock(&ctx->pending_lock);
+        const int ret = ctx->output_cb(ctx->output_opaque, msg);
+        pthread_mutex_unlock(&ctx->pending_lock);
+        return ret;
+    }
+
+    if (!ctx->nonblock)
+        return sxpi_msg_queue_send(ctx->frames_queue, msg, 0);
+
+    pthread_mutex_lock(&ctx->pending_lock);
+    int ret = ctx->pending.count ? AVERROR(EAGAIN)
+            : sxpi_msg_queue_send(ctx->frames_queue, msg, AV_THREAD_MESSAGE_NONBLOCK);
+    if (ret == AVERROR(EAGAIN))
+        ret = sxpi_msg_fifo_push(&ctx->pending, msg);
+    pthread_mutex_unlock(&ctx->pending_lock);
+    return ret;
+}
+
+/* Returns 1 if nothing is waiting to be sent anymore */
+static int flush_pending(struct decoding_ctx *ctx)
+{
+    pthread_mutex_lock(&ctx->pending_lock);
+    int ret = sxpi_msg_fifo_flush(&ctx->pending, ctx->frames_queue);
+    if (ret >= 0)
+        ret = !ctx->pending.count;
+    pthread_mutex_unlock(&ctx->pending_lock);
+    return ret;
+}
+
+static void drop_pending(struct decoding_ctx *ctx)
+{
+    pthread_mutex_lock(&ctx->pending_lock);
+    sxpi_msg_fifo_drop(&ctx->pending);
+    pthread_mutex_unlock(&ctx->pending_lock);
+}
+
+AVFrame *sxpi_decoding_get_frame(struct decoding_ctx *ctx)
+{
+    return sxpi_msg_pool_get_frame(ctx->msg_pool);
+}
+
+void sxpi_decoding_release_frame(struct decoding_ctx *ctx, AVFrame **framep)
+{
+    sxpi_msg_pool_put_frame(ctx->msg_pool, framep);
+}
+
 static int queue_frame(struct decoding_ctx *ctx, AVFrame *frame)
 {
     int ret;
     struct message msg = {
         .type = MSG_FRAME,
         .data = frame,
+        .pool = ctx->msg_pool,
     };
 
     if (ctx->is_image && ctx->frame_count++ > 0)
@@ -165,11 +319,11 @@ static int queue_frame(struct decoding_ctx *ctx, AVFrame *frame)
 
     TRACE(ctx, "queue frame with ts=%s", av_ts2timestr(frame->pts, &ctx->st_timebase));
 
-    ret = av_thread_message_queue_send(ctx->frames_queue, &msg, 0);
+    ret = send_message(ctx, &msg);
     if (ret < 0) {
         if (ret != AVERROR_EOF && ret != AVERROR_EXIT)
             LOG(ctx, ERROR, "Unable to push frame: %s", av_err2str(ret));
-        av_thread_message_queue_set_err_recv(ctx->frames_queue, ret);
+        sxpi_msg_queue_set_err_recv(ctx->frames_queue, ret);
     }
     return ret;
 }
@@ -184,7 +338,7 @@ static int queue_cached_frame(struct decoding_ctx *ctx)
     prev_frame->pts = cached_ts;
     ret = queue_frame(ctx, prev_frame);
     if (ret < 0) {
-        av_frame_free(&prev_frame);
+        sxpi_decoding_release_frame(ctx, &prev_frame);
         return ret;
     }
     return 0;
@@ -211,16 +365,29 @@ int sxpi_decoding_queue_frame(struct decoding_ctx *ctx, AVFrame *frame)
         TRACE(ctx, "frame ts:%s (%"PRId64"), skipping because before %s (%"PRId64")",
               av_ts2timestr(ts, &ctx->st_timebase), ts,
               av_ts2timestr(ctx->seek_request, &ctx->st_timebase), ctx->seek_request);
-        av_frame_free(&ctx->tmp_frame);
+        sxpi_decoding_release_frame(ctx, &ctx->tmp_frame);
         ctx->tmp_frame = frame;
         return 0;
     }
 
     frame->pts = ts;
 
+    /* A frame before the time the user waits for is kept aside as well, until
+     * the next one tells if it is displayed at that time. Its duration spares
+     * the wait when it does. */
+    const int64_t wanted_ts = get_wanted_ts(ctx);
+    if (ctx->seek_request == AV_NOPTS_VALUE && wanted_ts != AV_NOPTS_VALUE && ts < wanted_ts &&
+        !(frame->pkt_duration > 0 && ts + frame->pkt_duration > wanted_ts)) {
+        TRACE(ctx, "frame ts:%s is before the wanted time %s, keep it aside",
+              av_ts2timestr(ts, &ctx->st_timebase), av_ts2timestr(wanted_ts, &ctx->st_timebase));
+        sxpi_decoding_release_frame(ctx, &ctx->tmp_frame);
+        ctx->tmp_frame = frame;
+        return 0;
+    }
+
     if (ctx->tmp_frame) {
-        if (ctx->seek_request != AV_NOPTS_VALUE && ts == ctx->seek_request) {
-            av_frame_free(&ctx->tmp_frame);
+        if (wanted_ts != AV_NOPTS_VALUE && ts <= wanted_ts) {
+            sxpi_decoding_release_frame(ctx, &ctx->tmp_frame);
         } else {
             ret = queue_cached_frame(ctx);
             if (ret < 0)
@@ -239,80 +406,173 @@ int sxpi_decoding_queue_frame(struct decoding_ctx *ctx, AVFrame *frame)
     return queue_frame(ctx, frame);
 }
 
-void sxpi_decoding_run(struct decoding_ctx *ctx)
+static int push_held_packet(struct decoding_ctx *ctx)
+{
+    const AVPacket *pkt = ctx->held_pkt.data;
+    TRACE(ctx, "push held packet with pts=%s", av_ts2timestr(pkt->pts, &ctx->st_timebase));
+    const int ret = sxpi_decoder_push_packet(ctx->decoder, ctx->held_pkt.data);
+    sxpi_msg_free_data(&ctx->held_pkt);
+    return ret;
+}
+
+/*
+ * The frames of an intra-only stream are independent, so the packets before
+ * the wanted time are not decoded at all: the latest one is only kept aside
+ * until the next packet tells if its frame is displayed at that time, or the
+ * stream ends. Returns 1 if the packet was kept aside.
+ */
+static int hold_intra_packet(struct decoding_ctx *ctx, struct message *msg)
 {
+    const AVPacket *pkt = msg->data;
+
+    if (ctx->held_pkt.data) {
+        const int64_t wanted_ts = get_wanted_ts(ctx);
+        if (wanted_ts != AV_NOPTS_VALUE && pkt->pts != AV_NOPTS_VALUE && pkt->pts <= wanted_ts) {
+            sxpi_msg_free_data(&ctx->held_pkt);
+        } else {
+            const int ret = push_held_packet(ctx);
+            if (ret < 0)
+                return ret;
+        }
+    }
+
+    if (!is_preroll_packet(ctx, pkt))
+        return 0;
+
+    TRACE(ctx, "intra-only packet with pts=%s is before the wanted time, keep it aside",
+          av_ts2timestr(pkt->pts, &ctx->st_timebase));
+    ctx->held_pkt = *msg;
+    return 1;
+}
+
+/* Returns a positive value if some work was done, 0 if the queues are not
+ * ready yet (only when stepping), or the reason of the end of decoding */
+static int decode_packet(struct decoding_ctx *ctx)
+{
+    AVPacket *pkt;
+    struct message msg;
     int ret;
-    int in_err, out_err;
 
-    TRACE(ctx, "decoding packets from %p into %p", ctx->pkt_queue, ctx->frames_queue);
+    if (ctx->nonblock) {
+        ret = flush_pending(ctx);
+        if (ret <= 0)
+            return ret;
+    }
 
-    ctx->seek_request = AV_NOPTS_VALUE;
+    TRACE(ctx, "fetching a packet");
+    ret = sxpi_msg_queue_recv(ctx->pkt_queue, &msg, ctx->nonblock ? AV_THREAD_MESSAGE_NONBLOCK : 0);
+    if (ret == AVERROR(EAGAIN) && ctx->nonblock)
+        return 0;
+    if (ret < 0)
+        return ret;
 
-    for (;;) {
-        AVPacket *pkt;
-        struct message msg;
+    if (msg.type == MSG_SEEK) {
+        const int64_t seek_ts = msg.ts;
+
+        TRACE(ctx, "got a seek message (to %s) in the pkt queue",
+              PTS2TIMESTR(seek_ts));
+
+        /* Make sure the decoder has no packet remaining to consume and
+         * pushed (or dropped) all its cached frames. After this flush, we
+         * can assume that the decoder will not called async_queue_frame()
+         * until a new packet is pushed. */
+        sxpi_decoder_flush(ctx->decoder);
+
+        sxpi_decoding_release_frame(ctx, &ctx->tmp_frame);
+        sxpi_msg_free_data(&ctx->held_pkt);
+
+        /* Let's save some little time by dropping frames in the queue so
+         * the user don't get a shit ton of false positives before the
+         * frames he requested. */
+        drop_pending(ctx);
+        sxpi_msg_queue_flush(ctx->frames_queue);
+
+        /* Mark the seek request so async_queue_frame() can do its
+         * "filtering" work. A keyframe seek lets the frames through from
+         * the keyframe the demuxer landed on. */
+        ctx->seek_request = msg.seek_precision == SXPLAYER_SEEK_KEYFRAME ? AV_NOPTS_VALUE
+                          : av_rescale_q(seek_ts, AV_TIME_BASE_Q, ctx->st_timebase);
+
+        /* Forward seek message */
+        ret = send_message(ctx, &msg);
+        if (ret < 0) {
+            sxpi_msg_free_data(&msg);
+            return ret;
+        }
 
-        TRACE(ctx, "fetching a packet");
-        ret = av_thread_message_queue_recv(ctx->pkt_queue, &msg, 0);
-        if (ret < 0)
-            break;
+        return 1;
+    }
 
-        if (msg.type == MSG_SEEK) {
-            const int64_t seek_ts = *(int64_t *)msg.data;
+    if (ctx->intra_only) {
+        ret = hold_intra_packet(ctx, &msg);
+        if (ret) {
+            if (ret < 0)
+                sxpi_msg_free_data(&msg);
+            return ret;
+        }
+    }
 
-            TRACE(ctx, "got a seek message (to %s) in the pkt queue",
-                  PTS2TIMESTR(seek_ts));
+    pkt = msg.data;
+    if (!ctx->is_image)
+        update_skip_frame(ctx, pkt);
 
-            /* Make sure the decoder has no packet remaining to consume and
-             * pushed (or dropped) all its cached frames. After this flush, we
-             * can assume that the decoder will not called async_queue_frame()
-             * until a new packet is pushed. */
-            sxpi_decoder_flush(ctx->decoder);
+    TRACE(ctx, "got a packet of size %d, push it to decoder", pkt->size);
+    ret = sxpi_decoder_push_packet(ctx->decoder, pkt);
+    sxpi_msg_free_data(&msg);
+    if (ret < 0)
+        return ret;
+    return 1;
+}
 
-            av_frame_free(&ctx->tmp_frame);
+int sxpi_decoding_step(struct decoding_ctx *ctx, int flags)
+{
+    int ret;
+    int in_err, out_err;
 
-            /* Let's save some little time by dropping frames in the queue so
-             * the user don't get a shit ton of false positives before the
-             * frames he requested. */
-            av_thread_message_flush(ctx->frames_queue);
+    ctx->nonblock = !!(flags & AV_THREAD_MESSAGE_NONBLOCK);
 
-            /* Mark the seek request so async_queue_frame() can do its
-             * "filtering" work. */
-            ctx->seek_request = av_rescale_q(seek_ts, AV_TIME_BASE_Q, ctx->st_timebase);
+    if (!ctx->end_ret) {
+        ret = decode_packet(ctx);
+        if (ret >= 0)
+            return ret;
 
-            /* Forward seek message */
-            ret = av_thread_message_queue_send(ctx->frames_queue, &msg, 0);
-            if (ret < 0) {
-                sxpi_msg_free_data(&msg);
-                break;
+        /* Fetch remaining frames */
+        if (ret == AVERROR_EOF) {
+            /* Nothing superseded the packet kept aside */
+            if (ctx->held_pkt.data) {
+                const int err = push_held_packet(ctx);
+                if (err < 0 && err != AVERROR(EAGAIN))
+                    LOG(ctx, WARNING, "Unable to decode the held packet: %s", av_err2str(err));
             }
-
-            continue;
+            TRACE(ctx, "flush cached frames");
+            do {
+                ret = sxpi_decoder_push_packet(ctx->decoder, NULL);
+            } while (ret == 0 || ret == AVERROR(EAGAIN));
         }
 
-        pkt = msg.data;
-        TRACE(ctx, "got a packet of size %d, push it to decoder", pkt->size);
-        ret = sxpi_decoder_push_packet(ctx->decoder, pkt);
-        av_packet_unref(pkt);
-        av_freep(&pkt);
-        if (ret < 0)
-            break;
-    }
+        /* We pushed everything we could to the decoder, now we make sure frame
+         * queuing callback won't be called anymore */
+        sxpi_decoder_flush(ctx->decoder);
 
-    /* Fetch remaining frames */
-    if (ret == AVERROR_EOF) {
-        TRACE(ctx, "flush cached frames");
-        do {
-            ret = sxpi_decoder_push_packet(ctx->decoder, NULL);
-        } while (ret == 0 || ret == AVERROR(EAGAIN));
-    }
+        sxpi_decoding_release_frame(ctx, &ctx->tmp_frame);
+        sxpi_msg_free_data(&ctx->held_pkt);
 
-    /* We pushed everything we could to the decoder, now we make sure frame
-     * queuing callback won't be called anymore */
-    sxpi_decoder_flush(ctx->decoder);
+        ctx->end_ret = ret < 0 ? ret : AVERROR_EOF;
+    }
 
-    av_frame_free(&ctx->tmp_frame);
+    /* The frames kept aside must reach the filterer before the end of stream */
+    if (ctx->end_ret == AVERROR_EOF) {
+        ret = flush_pending(ctx);
+        if (!ret)
+            return 0;
+        if (ret < 0)
+            ctx->end_ret = ret;
+    }
+    drop_pending(ctx);
 
+    ret = ctx->end_ret;
+    ctx->end_ret = 0;
+    ctx->seek_request = AV_NOPTS_VALUE;
     if (ret < 0 && ret != AVERROR_EOF) {
         in_err = out_err = ret;
     } else {
@@ -321,9 +581,16 @@ void sxpi_decoding_run(struct decoding_ctx *ctx)
     }
     TRACE(ctx, "notify demuxer with %s and frames queue with %s",
           av_err2str(in_err), av_err2str(out_err));
-    av_thread_message_queue_set_err_send(ctx->pkt_queue,    in_err);
-    av_thread_message_flush(ctx->pkt_queue);
-    av_thread_message_queue_set_err_recv(ctx->frames_queue, out_err);
+    sxpi_msg_queue_set_err_send(ctx->pkt_queue,    in_err);
+    sxpi_msg_queue_flush(ctx->pkt_queue);
+    sxpi_msg_queue_set_err_recv(ctx->frames_queue, out_err);
+    return ret;
+}
+
+void sxpi_decoding_run(struct decoding_ctx *ctx)
+{
+    TRACE(ctx, "decoding packets from %p into %p", ctx->pkt_queue, ctx->frames_queue);
+    while (sxpi_decoding_step(ctx, 0) >= 0);
 }
 
 void sxpi_decoding_free(struct decoding_ctx **ctxp)
@@ -331,6 +598,10 @@ void sxpi_decoding_free(struct decoding_ctx **ctxp)
     struct decoding_ctx *ctx = *ctxp;
     if (!ctx)
         return;
+    sxpi_msg_free_data(&ctx->held_pkt);
     sxpi_decoder_free(&ctx->decoder);
+    sxpi_msg_fifo_free(&ctx->pending);
+    pthread_mutex_destroy(&ctx->pending_lock);
+    pthread_mutex_destroy(&ctx->skip_frame_lock);
     av_freep(ctxp);
 }
@@ -24,24 +24,47 @@
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 #include <libavutil/frame.h>
-#include <libavutil/threadmessage.h>
 
+#include "msg_queue.h"
 #include "opts.h"
 
 struct decoding_ctx *sxpi_decoding_alloc(void);
 
 int sxpi_decoding_init(void *log_ctx,
                        struct decoding_ctx *ctx,
-                       AVThreadMessageQueue *pkt_queue,
-                       AVThreadMessageQueue *frames_queue,
+                       struct msg_queue *pkt_queue,
+                       struct msg_queue *frames_queue,
+                       struct msg_pool *msg_pool,
                        int is_image,
                        const AVStream *stream,
-                       const struct sxplayer_opts *opts);
+                       const struct sxplayer_opts *opts,
+                       const int64_t *wanted_ts,
+                       int (*output_cb)(void *opaque, struct message *msg),
+                       void *output_opaque);
 
 const AVCodecContext *sxpi_decoding_get_avctx(struct decoding_ctx *ctx);
 
+/* Thread safe, can be called while the decoding is running */
+void sxpi_decoding_set_skip_frame(struct decoding_ctx *ctx, enum AVDiscard skip_frame);
+
+/*
+ * Get an empty frame to decode into, from the pool of the packets and frames
+ * of the queues. It must be given to sxpi_decoding_queue_frame() or released
+ * with sxpi_decoding_release_frame().
+ */
+AVFrame *sxpi_decoding_get_frame(struct decoding_ctx *ctx);
+
+void sxpi_decoding_release_frame(struct decoding_ctx *ctx, AVFrame **framep);
+
 int sxpi_decoding_queue_frame(struct decoding_ctx *ctx, AVFrame *frame);
 
+/*
+ * Decode one packet or handle one message, see sxpi_demuxing_step() for the
+ * flags and returned value. Without AV_THREAD_MESSAGE_NONBLOCK, the call may
+ * wait for a packet or for the room to queue the decoded frames.
+ */
+int sxpi_decoding_step(struct decoding_ctx *ctx, int flags);
+
 void sxpi_decoding_run(struct decoding_ctx *ctx);
 
 void sxpi_decoding_free(struct decoding_ctx **ctxp);
@@ -20,13 +20,28 @@
 
 #include <libavformat/avformat.h>
 #include <libavutil/avassert.h>
+#include <libavutil/avstring.h>
 #include <libavutil/display.h>
 #include <libavutil/eval.h>
+#include <libavutil/time.h>
 
 #include "mod_demuxing.h"
 #include "internal.h"
 #include "log.h"
+#include "media_cache.h"
 #include "msg.h"
+#include "shared_input.h"
+
+#define OUTPUT_POLL_INTERVAL 1000
+
+struct demuxing_output {
+    struct msg_queue *pkt_queue;
+    struct msg_pool *pkt_pool;              // packets of the queue
+    const struct sxplayer_opts *opts;
+    AVStream *stream;
+    int err;                                // the output can not be fed anymore
+    struct msg_fifo backlog;                // messages the queue could not take yet (several outputs or step mode only)
+};
 
 struct demuxing_ctx {
     void *log_ctx;
@@ -36,8 +51,24 @@ struct demuxing_ctx {
     AVStream *stream;
     int stream_idx;
     int is_image;
-    AVThreadMessageQueue *src_queue;
-    AVThreadMessageQueue *pkt_queue;
+    int intra_only;                         // every frame can be seeked to directly
+    int seek_by_bytes;
+    struct seek_index *seek_index;
+    int64_t prev_kf_pts;
+    struct media_cache *cache;
+    int cache_dirty;
+    int nb_cached_keyframes;
+    int has_cached_info;
+    int64_t cached_duration;
+    double cached_rotation;
+    struct msg_queue *src_queue;
+    struct demuxing_output *outputs;        // the first one is the stream selected at init
+    int nb_outputs;
+    int nb_alive_outputs;
+    struct shared_input *shared_input;      // owned by the caller
+    struct shared_input_cursor cursor;
+    int nonblock;                           // stepping without ever waiting for the outputs
+    int end_ret;                            // reason of the end of demuxing, 0 while running
 };
 
 struct demuxing_ctx *sxpi_demuxing_alloc(void)
@@ -52,6 +83,9 @@ struct demuxing_ctx *sxpi_demuxing_alloc(void)
 // duration
 int64_t sxpi_demuxing_probe_duration(const struct demuxing_ctx *ctx)
 {
+    if (ctx->has_cached_info)
+        return ctx->cached_duration;
+
     if (!ctx->is_image) {
         int64_t probe_duration64 = ctx->fmt_ctx->duration;
         AVRational scaleq = AV_TIME_BASE_Q;
@@ -67,13 +101,16 @@ int64_t sxpi_demuxing_probe_duration(const struct demuxing_ctx *ctx)
     return AV_NOPTS_VALUE;
 }
 
-double sxpi_demuxing_probe_rotation(const struct demuxing_ctx *ctx)
+double sxpi_demuxing_probe_rotation(const struct demuxing_ctx *ctx, int output)
 {
-    AVStream *st = (AVStream *)ctx->stream; // XXX: Fix FFmpeg.
+    AVStream *st = (AVStream *)ctx->outputs[output].stream; // XXX: Fix FFmpeg.
     AVDictionaryEntry *rotate_tag = av_dict_get(st->metadata, "rotate", NULL, 0);
     const uint8_t *displaymatrix = av_stream_get_side_data(st, AV_PKT_DATA_DISPLAYMATRIX, NULL);
     double theta = 0;
 
+    if (ctx->has_cached_info)
+        return ctx->cached_rotation;
+
     if (rotate_tag && *rotate_tag->value && strcmp(rotate_tag->value, "0")) {
         char *tail;
         theta = av_strtod(rotate_tag->value, &tail);
@@ -86,9 +123,9 @@ double sxpi_demuxing_probe_rotation(const struct demuxing_ctx *ctx)
     return theta;
 }
 
-const AVStream *sxpi_demuxing_get_stream(const struct demuxing_ctx *ctx)
+const AVStream *sxpi_demuxing_get_stream(const struct demuxing_ctx *ctx, int output)
 {
-    return ctx->stream;
+    return ctx->outputs[output].stream;
 }
 
 int sxpi_demuxing_is_image(const struct demuxing_ctx *ctx)
@@ -96,85 +133,284 @@ int sxpi_demuxing_is_image(const struct demuxing_ctx *ctx)
     return ctx->is_image;
 }
 
-int sxpi_demuxing_init(void *log_ctx,
-                       struct demuxing_ctx *ctx,
-                       AVThreadMessageQueue *src_queue,
-                       AVThreadMessageQueue *pkt_queue,
-                       const char *filename,
-                       const struct sxplayer_opts *opts)
+int sxpi_demuxing_has_cached_info(const struct demuxing_ctx *ctx)
 {
-    enum AVMediaType media_type;
+    return ctx->has_cached_info;
+}
 
-    ctx->log_ctx = log_ctx;
+static int apply_cached_info(struct demuxing_ctx *ctx,
+                             const struct media_info *info,
+                             enum AVMediaType media_type)
+{
+    if (info->stream_idx < 0 || info->stream_idx >= ctx->fmt_ctx->nb_streams)
+        return AVERROR_INVALIDDATA;
 
-    ctx->src_queue = src_queue;
-    ctx->pkt_queue = pkt_queue;
-    ctx->pkt_skip_mod = opts->pkt_skip_mod;
+    AVStream *st = ctx->fmt_ctx->streams[info->stream_idx];
+    if (st->codecpar->codec_type != media_type ||
+        info->codecpar->codec_type != media_type ||
+        av_cmp_q(st->time_base, info->time_base))
+        return AVERROR_INVALIDDATA;
+
+    int ret = avcodec_parameters_copy(st->codecpar, info->codecpar);
+    if (ret < 0)
+        return ret;
+
+    ctx->stream_idx      = info->stream_idx;
+    ctx->has_cached_info = 1;
+    ctx->cached_duration = info->duration;
+    ctx->cached_rotation = info->rotation;
+    return 0;
+}
+
+int sxpi_demuxing_add_output(struct demuxing_ctx *ctx,
+                             struct msg_queue *pkt_queue,
+                             struct msg_pool *pkt_pool,
+                             const struct sxplayer_opts *opts)
+{
+    /* The first output is reserved to the stream selected at init */
+    const int nb_outputs = FFMAX(ctx->nb_outputs, 1) + 1;
+    struct demuxing_output *outputs = av_realloc_array(ctx->outputs, nb_outputs, sizeof(*outputs));
+    if (!outputs)
+        return AVERROR(ENOMEM);
+    if (!ctx->nb_outputs)
+        memset(&outputs[0], 0, sizeof(*outputs));
+
+    struct demuxing_output *out = &outputs[nb_outputs - 1];
+    memset(out, 0, sizeof(*out));
+    out->pkt_queue = pkt_queue;
+    out->pkt_pool = pkt_pool;
+    out->opts = opts;
+
+    ctx->outputs = outputs;
+    ctx->nb_outputs = nb_outputs;
+    return nb_outputs - 1;
+}
 
+void sxpi_demuxing_set_shared_input(struct demuxing_ctx *ctx, struct shared_input *si)
+{
+    ctx->shared_input = si;
+}
+
+static enum AVMediaType get_media_type(const struct sxplayer_opts *opts)
+{
     switch (opts->avselect) {
-    case SXPLAYER_SELECT_VIDEO: media_type = AVMEDIA_TYPE_VIDEO; break;
-    case SXPLAYER_SELECT_AUDIO: media_type = AVMEDIA_TYPE_AUDIO; break;
+    case SXPLAYER_SELECT_VIDEO: return AVMEDIA_TYPE_VIDEO;
+    case SXPLAYER_SELECT_AUDIO: return AVMEDIA_TYPE_AUDIO;
     default:
         av_assert0(0);
     }
+}
+
+static int is_stream_routed(const struct demuxing_ctx *ctx, int stream_idx)
+{
+    for (int i = 0; i < ctx->nb_outputs; i++)
+        if (ctx->outputs[i].stream->index == stream_idx)
+            return 1;
+    return 0;
+}
+
+/* Open the input and select the stream, possibly skipping the probing with
+ * the cached media information */
+static int open_input(struct demuxing_ctx *ctx, const char *filename,
+                      const struct sxplayer_opts *opts, enum AVMediaType media_type,
+                      const struct media_info **cached_infop)
+{
+    if (opts->cache_dir && !ctx->shared_input)
+        ctx->cache = sxpi_media_cache_open(ctx->log_ctx, filename, opts);
+    const struct media_info *cached_info = ctx->cache ? sxpi_media_cache_get(ctx->cache) : NULL;
+    const AVInputFormat *cached_iformat = cached_info ? av_find_input_format(cached_info->format_name) : NULL;
 
     TRACE(ctx, "opening %s", filename);
-    int ret = avformat_open_input(&ctx->fmt_ctx, filename, NULL, NULL);
+    int ret = avformat_open_input(&ctx->fmt_ctx, filename, (AVInputFormat *)cached_iformat, NULL);
     if (ret < 0) {
         LOG(ctx, ERROR, "Unable to open input file '%s'", filename);
         return ret;
     }
 
-    TRACE(ctx, "find stream info");
-    ret = avformat_find_stream_info(ctx->fmt_ctx, NULL);
-    if (ret < 0) {
-        LOG(ctx, ERROR, "Unable to find input stream information");
-        return ret;
+    if (cached_info && ctx->nb_outputs > 1) {
+        TRACE(ctx, "cached media information does not cover the other outputs");
+        cached_info = NULL;
     }
 
-    TRACE(ctx, "find best stream");
-    ret = av_find_best_stream(ctx->fmt_ctx, media_type, opts->stream_idx, -1, NULL, 0);
-    if (ret < 0) {
-        LOG(ctx, ERROR, "Unable to find a %s stream in the input file",
-            av_get_media_type_string(media_type));
-        return ret;
+    if (cached_info) {
+        ret = apply_cached_info(ctx, cached_info, media_type);
+        if (ret < 0) {
+            LOG(ctx, WARNING, "Cached media information does not match the input, probing it");
+            cached_info = NULL;
+        }
+    }
+
+    if (!cached_info) {
+        TRACE(ctx, "find stream info");
+        ret = avformat_find_stream_info(ctx->fmt_ctx, NULL);
+        if (ret < 0) {
+            LOG(ctx, ERROR, "Unable to find input stream information");
+            return ret;
+        }
+
+        TRACE(ctx, "find best stream");
+        ret = av_find_best_stream(ctx->fmt_ctx, media_type, opts->stream_idx, -1, NULL, 0);
+        if (ret < 0) {
+            LOG(ctx, ERROR, "Unable to find a %s stream in the input file",
+                av_get_media_type_string(media_type));
+            return ret;
+        }
+        ctx->stream_idx = ret;
+        ctx->cache_dirty = 1;
+    }
+
+    *cached_infop = cached_info;
+    return 0;
+}
+
+static int init_input(struct demuxing_ctx *ctx, const char *filename,
+                      const struct sxplayer_opts *opts)
+{
+    const enum AVMediaType media_type = get_media_type(opts);
+    const struct media_info *cached_info = NULL;
+    int ret;
+
+    /* The input is only opened by the first context using it */
+    const int shared = ctx->shared_input &&
+                       (ctx->fmt_ctx = sxpi_shared_input_get_format(ctx->shared_input, &ctx->stream_idx));
+    if (!shared) {
+        ret = open_input(ctx, filename, opts, media_type, &cached_info);
+        if (ret < 0) {
+            avformat_close_input(&ctx->fmt_ctx);
+            return ret;
+        }
     }
-    ctx->stream_idx = ret;
+
     ctx->stream = ctx->fmt_ctx->streams[ctx->stream_idx];
+    ctx->outputs[0].stream = ctx->stream;
     ctx->is_image = strstr(ctx->fmt_ctx->iformat->name, "image2") ||
                     strstr(ctx->fmt_ctx->iformat->name, "_pipe");
-    LOG(ctx, INFO, "Selected %s stream %d",
-        av_get_media_type_string(media_type), ctx->stream_idx);
+    ctx->intra_only = !ctx->is_image && sxpi_is_intra_only(ctx->stream->codecpar);
+    LOG(ctx, INFO, "Selected %s stream %d%s",
+        av_get_media_type_string(media_type), ctx->stream_idx,
+        shared ? " of the shared input" : "");
+
+    for (int i = 1; i < ctx->nb_outputs; i++) {
+        struct demuxing_output *out = &ctx->outputs[i];
+        const enum AVMediaType out_media_type = get_media_type(out->opts);
+        ret = av_find_best_stream(ctx->fmt_ctx, out_media_type, out->opts->stream_idx, -1, NULL, 0);
+        if (ret < 0) {
+            LOG(ctx, ERROR, "Unable to find a %s stream in the input file for output %d",
+                av_get_media_type_string(out_media_type), i);
+            return ret;
+        }
+        out->stream = ctx->fmt_ctx->streams[ret];
+        LOG(ctx, INFO, "Selected %s stream %d for output %d",
+            av_get_media_type_string(out_media_type), ret, i);
+    }
+
+    /* Same heuristic as ffplay: formats with timestamp discontinuities are
+     * better seeked by byte offset */
+    const AVInputFormat *iformat = ctx->fmt_ctx->iformat;
+    ctx->seek_by_bytes = (iformat->flags & AVFMT_TS_DISCONT) &&
+                         !(iformat->flags & AVFMT_NO_BYTE_SEEK) &&
+                         strcmp(iformat->name, "ogg");
+    sxpi_seek_index_init(ctx->seek_index, ctx->stream_idx, ctx->stream->time_base);
+    if (cached_info && sxpi_seek_index_import(ctx->seek_index, cached_info->keyframes,
+                                              cached_info->nb_keyframes) < 0)
+        LOG(ctx, WARNING, "Unable to import the cached keyframe index");
+    ctx->nb_cached_keyframes = sxpi_seek_index_get_timestamps(ctx->seek_index, NULL, 0);
+
+    if (shared)
+        return 0;
 
     /* Automatically discard all the other streams so we don't have to filter
      * them out most of the time */
     for (int i = 0; i < ctx->fmt_ctx->nb_streams; i++)
-        if (i != ctx->stream_idx)
+        if (!is_stream_routed(ctx, i))
             ctx->fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
 
     av_dump_format(ctx->fmt_ctx, 0, filename, 0);
 
+    if (ctx->shared_input)
+        sxpi_shared_input_set_format(ctx->shared_input, ctx->fmt_ctx, ctx->stream_idx);
+
     return 0;
 }
 
+int sxpi_demuxing_init(void *log_ctx,
+                       struct demuxing_ctx *ctx,
+                       struct msg_queue *src_queue,
+                       struct msg_queue *pkt_queue,
+                       struct msg_pool *pkt_pool,
+                       struct seek_index *seek_index,
+                       const char *filename,
+                       const struct sxplayer_opts *opts)
+{
+    ctx->log_ctx = log_ctx;
+
+    if (!ctx->nb_outputs) {
+        ctx->outputs = av_mallocz(sizeof(*ctx->outputs));
+        if (!ctx->outputs)
+            return AVERROR(ENOMEM);
+        ctx->nb_outputs = 1;
+    }
+    ctx->outputs[0].pkt_queue = pkt_queue;
+    ctx->outputs[0].pkt_pool = pkt_pool;
+    ctx->outputs[0].opts = opts;
+    ctx->nb_alive_outputs = ctx->nb_outputs;
+
+    ctx->src_queue = src_queue;
+    ctx->seek_index = seek_index;
+    ctx->prev_kf_pts = AV_NOPTS_VALUE;
+    ctx->pkt_skip_mod = opts->pkt_skip_mod;
+
+    if (ctx->shared_input && ctx->nb_outputs > 1) {
+        LOG(ctx, WARNING, "The input can not be shared with several outputs");
+        ctx->shared_input = NULL;
+    }
+
+    if (!ctx->shared_input)
+        return init_input(ctx, filename, opts);
+
+    sxpi_shared_input_init_cursor(&ctx->cursor, log_ctx);
+    sxpi_shared_input_lock(ctx->shared_input);
+    int ret = init_input(ctx, filename, opts);
+    sxpi_shared_input_unlock(ctx->shared_input);
+    return ret;
+}
+
+static int read_packet(struct demuxing_ctx *ctx, AVPacket *pkt)
+{
+    if (ctx->shared_input)
+        return sxpi_shared_input_read(ctx->shared_input, &ctx->cursor, pkt);
+    return av_read_frame(ctx->fmt_ctx, pkt);
+}
+
 static int pull_packet(struct demuxing_ctx *ctx, AVPacket *pkt)
 {
     int ret;
-    AVFormatContext *fmt_ctx = ctx->fmt_ctx;
     const int target_stream_idx = ctx->stream->index;
 
     for (;;) {
-        ret = av_read_frame(fmt_ctx, pkt);
+        ret = read_packet(ctx, pkt);
         if (ret < 0)
             break;
 
-        if (pkt->stream_index != target_stream_idx) {
+        if (!is_stream_routed(ctx, pkt->stream_index)) {
             TRACE(ctx, "pkt->idx=%d vs %d",
                   pkt->stream_index, target_stream_idx);
             av_packet_unref(pkt);
             continue;
         }
 
+        /* The keyframe index and the packet skipping only concern the stream
+         * selected at init */
+        if (pkt->stream_index != target_stream_idx)
+            break;
+
+        if ((pkt->flags & AV_PKT_FLAG_KEY) && !ctx->is_image) {
+            const int64_t kf_pts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+            if (sxpi_seek_index_add(ctx->seek_index, kf_pts, pkt->pos, ctx->prev_kf_pts) < 0)
+                LOG(ctx, WARNING, "Unable to add keyframe to the seek index");
+            ctx->prev_kf_pts = kf_pts;
+        }
+
         if (ctx->pkt_skip_mod) {
             ctx->pkt_count++;
             if (ctx->pkt_count % ctx->pkt_skip_mod && !(pkt->flags & AV_PKT_FLAG_KEY)) {
@@ -190,75 +426,272 @@ static int pull_packet(struct demuxing_ctx *ctx, AVPacket *pkt)
     return ret;
 }
 
-void sxpi_demuxing_run(struct demuxing_ctx *ctx)
+/* Jump straight to the GOP containing the requested time if the keyframe
+ * index knows it, otherwise let libavformat find it; with an intra-only
+ * stream, the GOP is the requested frame itself */
+static int seek_media(struct demuxing_ctx *ctx, int64_t seek_to)
 {
     int ret;
-    int in_err, out_err;
+    struct seek_index_entry kf;
+    const int64_t st_seek_to = av_rescale_q(seek_to, AV_TIME_BASE_Q, ctx->stream->time_base);
 
-    TRACE(ctx, "demuxing packets in queue %p", ctx->pkt_queue);
+    /* The next keyframe read is not contiguous with the previous one */
+    ctx->prev_kf_pts = AV_NOPTS_VALUE;
 
-    for (;;) {
-        AVPacket pkt;
-        struct message msg;
+    if (ctx->shared_input) {
+        if (sxpi_seek_index_lookup(ctx->seek_index, st_seek_to, &kf))
+            return sxpi_shared_input_seek(ctx->shared_input, &ctx->cursor, kf.pts);
+        return sxpi_shared_input_seek(ctx->shared_input, &ctx->cursor, st_seek_to);
+    }
+
+    if (sxpi_seek_index_lookup(ctx->seek_index, st_seek_to, &kf)) {
+        if (ctx->seek_by_bytes && kf.pos >= 0) {
+            TRACE(ctx, "indexed keyframe at pos %"PRId64, kf.pos);
+            ret = avformat_seek_file(ctx->fmt_ctx, -1, kf.pos, kf.pos, kf.pos, AVSEEK_FLAG_BYTE);
+        } else {
+            TRACE(ctx, "indexed keyframe at pts %"PRId64, kf.pts);
+            ret = avformat_seek_file(ctx->fmt_ctx, ctx->stream_idx, INT64_MIN, kf.pts, kf.pts, 0);
+        }
+        if (ret >= 0)
+            return ret;
+        LOG(ctx, WARNING, "Unable to seek to indexed keyframe, fallback on regular seek");
+    }
+
+    /* Without dependencies between the frames, the frame displayed at the
+     * requested time is addressed directly in the stream time base */
+    if (ctx->intra_only) {
+        TRACE(ctx, "intra-only stream, seek to the frame at pts %"PRId64, st_seek_to);
+        ret = avformat_seek_file(ctx->fmt_ctx, ctx->stream_idx, INT64_MIN, st_seek_to, st_seek_to, 0);
+        if (ret >= 0)
+            return ret;
+    }
+
+    return avformat_seek_file(ctx->fmt_ctx, -1, INT64_MIN, seek_to, seek_to, 0);
+}
 
-        ret = av_thread_message_queue_recv(ctx->src_queue, &msg, AV_THREAD_MESSAGE_NONBLOCK);
-        if (ret != AVERROR(EAGAIN)) {
+/* Make the message of an output: a packet is taken from the pool of the
+ * output, and references the demuxed packet, or takes it over for the last
+ * output; the other messages have no data and are simply copied */
+static int output_message(struct demuxing_output *out, struct message *dst,
+                          const struct message *src, int last)
+{
+    *dst = *src;
+    if (src->type != MSG_PACKET)
+        return 0;
+
+    AVPacket *pkt = sxpi_msg_pool_get_packet(out->pkt_pool);
+    if (!pkt)
+        return AVERROR(ENOMEM);
+    if (last) {
+        av_packet_move_ref(pkt, src->data);
+    } else {
+        int ret = av_packet_ref(pkt, src->data);
+        if (ret < 0) {
+            sxpi_msg_pool_put_packet(out->pkt_pool, &pkt);
+            return ret;
+        }
+    }
+    dst->data = pkt;
+    dst->pool = out->pkt_pool;
+    return 0;
+}
+
+static void close_output(struct demuxing_ctx *ctx, struct demuxing_output *out, int err)
+{
+    if (err != AVERROR_EOF && err != AVERROR_EXIT)
+        LOG(ctx, ERROR, "Unable to send packet to decoder: %s", av_err2str(err));
+    TRACE(ctx, "can't send pkt to decoder: %s", av_err2str(err));
+    sxpi_msg_fifo_drop(&out->backlog);
+    sxpi_msg_queue_set_err_recv(out->pkt_queue, err);
+    out->err = err;
+    ctx->nb_alive_outputs--;
+}
+
+/* Send as many of the kept aside messages as the queue can take, returns the
+ * number of messages sent */
+static int flush_backlog(struct demuxing_ctx *ctx, struct demuxing_output *out)
+{
+    const int ret = sxpi_msg_fifo_flush(&out->backlog, out->pkt_queue);
+    if (ret < 0) {
+        close_output(ctx, out, ret);
+        return 0;
+    }
+    return ret;
+}
+
+/* With a single output, the demuxer simply waits for the decoder. With
+ * several of them, a full queue must not starve the other streams, so the
+ * messages it can not take yet are kept aside. The same goes when stepping,
+ * where the caller must never be blocked. */
+static int send_message(struct demuxing_ctx *ctx, struct demuxing_output *out,
+                        struct message *msg)
+{
+    int ret;
+
+    if (ctx->nb_outputs == 1 && !ctx->nonblock) {
+        ret = sxpi_msg_queue_send(out->pkt_queue, msg, 0);
+    } else {
+        flush_backlog(ctx, out);
+        if (out->err)
+            ret = out->err;
+        else if (out->backlog.count ||
+                 (ret = sxpi_msg_queue_send(out->pkt_queue, msg,
+                                                     AV_THREAD_MESSAGE_NONBLOCK)) == AVERROR(EAGAIN))
+            ret = sxpi_msg_fifo_push(&out->backlog, msg);
+    }
+
+    if (ret < 0) {
+        sxpi_msg_free_data(msg);
+        if (!out->err)
+            close_output(ctx, out, ret);
+    }
+    return ret;
+}
+
+/* Send the message to every output feeding from the stream (any stream if
+ * stream_idx is negative). The packet of a packet message is owned by the
+ * demuxer, and always consumed. The returned error is only meaningful once
+ * all the outputs are closed. */
+static int route_message(struct demuxing_ctx *ctx, struct message *msg, int stream_idx)
+{
+    struct demuxing_output *last = NULL;
+    struct message out_msg;
+    int ret;
+
+    for (int i = 0; i < ctx->nb_outputs; i++) {
+        struct demuxing_output *out = &ctx->outputs[i];
+        if (out->err || (stream_idx >= 0 && out->stream->index != stream_idx))
+            continue;
+        if (last) {
+            ret = output_message(last, &out_msg, msg, 0);
             if (ret < 0)
-                break;
-
-            if (msg.type == MSG_SEEK) {
-                av_assert0(!ctx->is_image);
-
-                /* Make later modules stop working ASAP */
-                av_thread_message_flush(ctx->pkt_queue);
-
-                /* do actual seek so the following packet that will be pulled in
-                 * this current thread will be at the (approximate) requested time */
-                const int64_t seek_to = *(int64_t *)msg.data;
-                LOG(ctx, INFO, "Seek in media at ts=%s", PTS2TIMESTR(seek_to));
-                ret = avformat_seek_file(ctx->fmt_ctx, -1, INT64_MIN, seek_to, seek_to, 0);
-                if (ret < 0) {
-                    sxpi_msg_free_data(&msg);
-                    break;
-                }
+                goto drop;
+            send_message(ctx, last, &out_msg);
+        }
+        last = out;
+    }
+
+    if (!last) {
+        ret = ctx->nb_alive_outputs ? 0 : AVERROR_EOF;
+        goto drop;
+    }
+    ret = output_message(last, &out_msg, msg, 1);
+    if (ret < 0)
+        goto drop;
+    ret = send_message(ctx, last, &out_msg);
+    return ctx->nb_alive_outputs ? 0 : ret;
+
+drop:
+    if (msg->type == MSG_PACKET)
+        av_packet_unref(msg->data);
+    return ret;
+}
+
+/* Returns 1 if there is at least one output ready to take a new packet, or
+ * wait a bit for one of the consumers otherwise (unless stepping). The seek
+ * requests must still be honored, so this never blocks. */
+static int wait_outputs(struct demuxing_ctx *ctx, int drain)
+{
+    int pending = 0, progress = 0;
+
+    for (int i = 0; i < ctx->nb_outputs; i++) {
+        struct demuxing_output *out = &ctx->outputs[i];
+        if (out->err)
+            continue;
+        if (flush_backlog(ctx, out) > 0)
+            progress = 1;
+        if (out->err)
+            continue;
+        if (!out->backlog.count && !drain)
+            return 1;
+        if (out->backlog.count)
+            pending = 1;
+    }
+
+    if (!pending)
+        return 1;
+    if (!progress && !ctx->nonblock)
+        av_usleep(OUTPUT_POLL_INTERVAL);
+    return 0;
+}
+
+/* Returns a positive value if some work was done, 0 if the outputs can not
+ * take a new packet yet (only when stepping), or the reason of the end of
+ * demuxing */
+static int demux_packet(struct demuxing_ctx *ctx)
+{
+    AVPacket pkt;
+    struct message msg;
+    int progress = 0;
+
+    int ret = sxpi_msg_queue_recv(ctx->src_queue, &msg, AV_THREAD_MESSAGE_NONBLOCK);
+    if (ret != AVERROR(EAGAIN)) {
+        if (ret < 0)
+            return ret;
+
+        if (msg.type == MSG_SEEK) {
+            av_assert0(!ctx->is_image);
+
+            /* Make later modules stop working ASAP */
+            for (int i = 0; i < ctx->nb_outputs; i++) {
+                sxpi_msg_fifo_drop(&ctx->outputs[i].backlog);
+                sxpi_msg_queue_flush(ctx->outputs[i].pkt_queue);
             }
 
-            /* Forward the message */
-            ret = av_thread_message_queue_send(ctx->pkt_queue, &msg, 0);
+            /* do actual seek so the following packet that will be pulled in
+             * this current thread will be at the (approximate) requested time */
+            const int64_t seek_to = msg.ts;
+            LOG(ctx, INFO, "Seek in media at ts=%s", PTS2TIMESTR(seek_to));
+            ret = seek_media(ctx, seek_to);
             if (ret < 0) {
                 sxpi_msg_free_data(&msg);
-                break;
+                return ret;
             }
         }
 
-        msg.type = MSG_PACKET;
-
-        ret = pull_packet(ctx, &pkt);
+        /* Forward the message */
+        ret = route_message(ctx, &msg, -1);
         if (ret < 0)
-            break;
+            return ret;
+        progress = 1;
+    }
 
-        TRACE(ctx, "pulled a packet of size %d, sending to decoder", pkt.size);
+    if ((ctx->nb_outputs > 1 || ctx->nonblock) && !wait_outputs(ctx, 0))
+        return ctx->nonblock ? progress : 1;
 
-        msg.data = av_memdup(&pkt, sizeof(pkt));
-        if (!msg.data) {
-            av_packet_unref(&pkt);
-            break;
-        }
+    ret = pull_packet(ctx, &pkt);
+    if (ret < 0)
+        return ret;
 
-        ret = av_thread_message_queue_send(ctx->pkt_queue, &msg, 0);
-        TRACE(ctx, "sent packet to decoder, ret=%s", av_err2str(ret));
+    TRACE(ctx, "pulled a packet of size %d, sending to decoder", pkt.size);
 
-        if (ret < 0) {
-            av_packet_unref(&pkt);
-            av_freep(&msg.data);
-            if (ret != AVERROR_EOF && ret != AVERROR_EXIT)
-                LOG(ctx, ERROR, "Unable to send packet to decoder: %s", av_err2str(ret));
-            TRACE(ctx, "can't send pkt to decoder: %s", av_err2str(ret));
-            av_thread_message_queue_set_err_recv(ctx->pkt_queue, ret);
-            break;
-        }
+    msg = (struct message){ .type = MSG_PACKET, .data = &pkt };
+    ret = route_message(ctx, &msg, pkt.stream_index);
+    TRACE(ctx, "sent packet to decoder, ret=%s", av_err2str(ret));
+    if (ret < 0)
+        return ret;
+    return 1;
+}
+
+int sxpi_demuxing_step(struct demuxing_ctx *ctx, int flags)
+{
+    int in_err, out_err;
+
+    ctx->nonblock = !!(flags & AV_THREAD_MESSAGE_NONBLOCK);
+
+    if (!ctx->end_ret) {
+        const int ret = demux_packet(ctx);
+        if (ret >= 0)
+            return ret;
+        ctx->end_ret = ret;
     }
 
+    /* The packets kept aside must reach the decoders before the end of stream */
+    if (ctx->end_ret == AVERROR_EOF && !wait_outputs(ctx, 1))
+        return ctx->nonblock ? 0 : 1;
+
+    const int ret = ctx->end_ret;
+    ctx->end_ret = 0;
     if (ret < 0 && ret != AVERROR_EOF) {
         in_err = out_err = ret;
     } else {
@@ -267,9 +700,46 @@ void sxpi_demuxing_run(struct demuxing_ctx *ctx)
     }
     TRACE(ctx, "notify user with %s and decoder with %s",
           av_err2str(in_err), av_err2str(out_err));
-    av_thread_message_queue_set_err_send(ctx->src_queue, in_err);
-    av_thread_message_flush(ctx->src_queue);
-    av_thread_message_queue_set_err_recv(ctx->pkt_queue, out_err);
+    sxpi_msg_queue_set_err_send(ctx->src_queue, in_err);
+    sxpi_msg_queue_flush(ctx->src_queue);
+    for (int i = 0; i < ctx->nb_outputs; i++) {
+        struct demuxing_output *out = &ctx->outputs[i];
+        sxpi_msg_fifo_drop(&out->backlog);
+        if (!out->err)
+            sxpi_msg_queue_set_err_recv(out->pkt_queue, out_err);
+        out->err = 0;
+    }
+    ctx->nb_alive_outputs = ctx->nb_outputs;
+    return ret;
+}
+
+void sxpi_demuxing_run(struct demuxing_ctx *ctx)
+{
+    TRACE(ctx, "demuxing packets in %d queue(s)", ctx->nb_outputs);
+    while (sxpi_demuxing_step(ctx, 0) >= 0);
+}
+
+/* Save the probed information (and what we learned about the keyframes) so
+ * the next open of this media can skip probing */
+static void store_media_info(struct demuxing_ctx *ctx)
+{
+    struct media_info info = {
+        .stream_idx = ctx->stream_idx,
+        .time_base  = ctx->stream->time_base,
+        .duration   = sxpi_demuxing_probe_duration(ctx),
+        .rotation   = sxpi_demuxing_probe_rotation(ctx, 0),
+        .codecpar   = ctx->stream->codecpar,
+    };
+    av_strlcpy(info.format_name, ctx->fmt_ctx->iformat->name, sizeof(info.format_name));
+
+    const int nb_keyframes = sxpi_seek_index_export(ctx->seek_index, &info.keyframes);
+    if (nb_keyframes < 0)
+        return;
+    if (ctx->cache_dirty || nb_keyframes != ctx->nb_cached_keyframes) {
+        info.nb_keyframes = nb_keyframes;
+        sxpi_media_cache_store(ctx->cache, &info);
+    }
+    av_free(info.keyframes);
 }
 
 void sxpi_demuxing_free(struct demuxing_ctx **ctxp)
@@ -277,6 +747,15 @@ void sxpi_demuxing_free(struct demuxing_ctx **ctxp)
     struct demuxing_ctx *ctx = *ctxp;
     if (!ctx)
         return;
-    avformat_close_input(&ctx->fmt_ctx);
+    if (ctx->cache && ctx->stream)
+        store_media_info(ctx);
+    sxpi_media_cache_close(&ctx->cache);
+    if (ctx->shared_input)
+        ctx->fmt_ctx = NULL;
+    else
+        avformat_close_input(&ctx->fmt_ctx);
+    for (int i = 0; i < ctx->nb_outputs; i++)
+        sxpi_msg_fifo_free(&ctx->outputs[i].backlog);
+    av_freep(&ctx->outputs);
     av_freep(ctxp);
 }
@@ -23,23 +23,56 @@
 
 #include <stdint.h>
 #include <libavformat/avformat.h>
-#include <libavutil/threadmessage.h>
 
+#include "msg_queue.h"
 #include "opts.h"
+#include "seek_index.h"
+#include "shared_input.h"
 
 struct demuxing_ctx *sxpi_demuxing_alloc(void);
 
+/*
+ * Register an additional output, fed with the packets of the stream selected
+ * by its options (avselect and stream_idx), before the demuxer is
+ * initialized. The returned index identifies the output in the getters below,
+ * output 0 being the stream selected by the init options. The packets of an
+ * output are taken from its pool, which must outlive its queue.
+ */
+int sxpi_demuxing_add_output(struct demuxing_ctx *ctx,
+                             struct msg_queue *pkt_queue,
+                             struct msg_pool *pkt_pool,
+                             const struct sxplayer_opts *opts);
+
+/*
+ * Read the packets through the shared input instead of opening the media,
+ * which is only done if nobody opened it yet. This must be set before the
+ * demuxer is initialized, and is ignored with several outputs.
+ */
+void sxpi_demuxing_set_shared_input(struct demuxing_ctx *ctx, struct shared_input *si);
+
 int sxpi_demuxing_init(void *log_ctx,
                        struct demuxing_ctx *ctx,
-                       AVThreadMessageQueue *src_queue,
-                       AVThreadMessageQueue *pkt_queue,
+                       struct msg_queue *src_queue,
+                       struct msg_queue *pkt_queue,
+                       struct msg_pool *pkt_pool,
+                       struct seek_index *seek_index,
                        const char *filename,
                        const struct sxplayer_opts *opts);
 
 int64_t sxpi_demuxing_probe_duration(const struct demuxing_ctx *ctx);
-double sxpi_demuxing_probe_rotation(const struct demuxing_ctx *ctx);
-const AVStream *sxpi_demuxing_get_stream(const struct demuxing_ctx *ctx);
+double sxpi_demuxing_probe_rotation(const struct demuxing_ctx *ctx, int output);
+const AVStream *sxpi_demuxing_get_stream(const struct demuxing_ctx *ctx, int output);
 int sxpi_demuxing_is_image(const struct demuxing_ctx *ctx);
+int sxpi_demuxing_has_cached_info(const struct demuxing_ctx *ctx);
+
+/*
+ * Demux one packet or handle one message. Returns a positive value if some
+ * work was done, 0 if the outputs can not take anything yet (only with
+ * AV_THREAD_MESSAGE_NONBLOCK in flags, in which case the call never waits),
+ * or a negative value once the demuxing ended and the queues were notified.
+ * The next call starts over, like a new run.
+ */
+int sxpi_demuxing_step(struct demuxing_ctx *ctx, int flags);
 
 void sxpi_demuxing_run(struct demuxing_ctx *ctx);
 
@@ -30,6 +30,7 @@
 #include <libavutil/timestamp.h>
 
 #include "sxplayer.h"
+#include "frame.h"
 #include "internal.h"
 #include "mod_filtering.h"
 #include "log.h"
@@ -42,8 +43,17 @@
 struct filtering_ctx {
     void *log_ctx;
 
-    AVThreadMessageQueue *in_queue;
-    AVThreadMessageQueue *out_queue;
+    struct msg_queue *in_queue;
+    struct msg_queue *out_queue;
+
+    /* push mode: frames are delivered through this callback instead of the
+     * out queue, which then only carries the seek messages */
+    int (*push_cb)(void *opaque, struct sxplayer_frame *frame);
+    void *push_opaque;
+    const struct sxplayer_opts *opts;
+    AVBufferPool *frame_pool;
+
+    struct notifier *notifier;              // signaled for every frame sent, latched at the end
 
     AVCodecParameters *codecpar;
     char *filters;
@@ -51,6 +61,7 @@ struct filtering_ctx {
     int sw_pix_fmt;
     int max_pixels;
     int audio_texture;
+    int lazy;                               // frames sent as decoded, converted by sxpi_filtering_convert_frame()
     AVRational st_timebase;
 
     AVFilterGraph *filter_graph;
@@ -60,6 +71,10 @@ struct filtering_ctx {
     float *window_func_lut;                 // audio window function lookup table
     RDFTContext *rdft;                      // real discrete fourier transform context
     FFTSample *rdft_data[AUDIO_NBCHANNELS]; // real discrete fourier transform data for each channel
+
+    int nonblock;                           // stepping without ever waiting for the sink
+    int end_ret;                            // reason of the end of filtering, 0 while running
+    struct msg_fifo pending;                // messages the out queue could not take yet
 };
 
 struct filtering_ctx *sxpi_filtering_alloc(void)
@@ -72,6 +87,7 @@ struct filtering_ctx *sxpi_filtering_alloc(void)
         av_freep(&ctx);
         return NULL;
     }
+    ctx->last_frame_format = AV_PIX_FMT_NONE;
     return ctx;
 }
 
@@ -339,20 +355,30 @@ static char *update_filters_str(char *filters, const char *append)
 
 int sxpi_filtering_init(void *log_ctx,
                         struct filtering_ctx *ctx,
-                        AVThreadMessageQueue *in_queue,
-                        AVThreadMessageQueue *out_queue,
+                        struct msg_queue *in_queue,
+                        struct msg_queue *out_queue,
                         const AVStream *stream,
                         const AVCodecContext *avctx,
                         double media_rotation,
-                        const struct sxplayer_opts *o)
+                        const struct sxplayer_opts *o,
+                        int (*push_cb)(void *opaque, struct sxplayer_frame *frame),
+                        void *push_opaque,
+                        AVBufferPool *frame_pool,
+                        struct notifier *notifier)
 {
     ctx->log_ctx = log_ctx;
     ctx->in_queue  = in_queue;
     ctx->out_queue = out_queue;
+    ctx->push_cb = push_cb;
+    ctx->push_opaque = push_opaque;
+    ctx->opts = o;
+    ctx->frame_pool = frame_pool;
+    ctx->notifier = notifier;
     ctx->sw_pix_fmt = o->sw_pix_fmt;
     ctx->max_pixels = o->max_pixels;
     ctx->audio_texture = o->audio_texture;
     ctx->st_timebase = stream->time_base;
+    ctx->lazy = o->lazy_filtering && !push_cb && stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO;
     ctx->max_pts = o->end_time64 > 0 ? av_rescale_q(o->end_time64, AV_TIME_BASE_Q, ctx->st_timebase) : AV_NOPTS_VALUE;
 
     int ret = avcodec_parameters_from_context(ctx->codecpar, avctx);
@@ -399,6 +425,55 @@ int sxpi_filtering_init(void *log_ctx,
     return 0;
 }
 
+/* Like with the queue, the frame is only consumed on success */
+static int push_user_frame(struct filtering_ctx *ctx, AVFrame *frame)
+{
+    AVFrame *user_frame = av_frame_alloc();
+    if (!user_frame)
+        return AVERROR(ENOMEM);
+    av_frame_move_ref(user_frame, frame);
+
+    struct sxplayer_frame *ret = sxpi_frame_wrap(ctx->frame_pool, user_frame, ctx->st_timebase, ctx->opts);
+    if (!ret) {
+        LOG(ctx, ERROR, "unable to wrap the filtered frame");
+        return AVERROR(ENOMEM);
+    }
+
+    TRACE(ctx, "pushing filtered frame to the user");
+    const int err = ctx->push_cb(ctx->push_opaque, ret);
+    if (err < 0)
+        return err;
+    av_frame_free(&frame);
+    return 0;
+}
+
+/* When stepping, the messages the queue can not take yet are kept aside
+ * (after the ones already waiting) instead of waiting for the user */
+static int send_message(struct filtering_ctx *ctx, struct message *msg)
+{
+    if (!ctx->nonblock)
+        return sxpi_msg_queue_send(ctx->out_queue, msg, 0);
+
+    int ret = ctx->pending.count ? AVERROR(EAGAIN)
+            : sxpi_msg_queue_send(ctx->out_queue, msg, AV_THREAD_MESSAGE_NONBLOCK);
+    if (ret == AVERROR(EAGAIN))
+        return sxpi_msg_fifo_push(&ctx->pending, msg);
+    if (ret >= 0 && msg->type == MSG_FRAME)
+        sxpi_notifier_signal(ctx->notifier);
+    return ret;
+}
+
+/* Returns 1 if nothing is waiting to be sent anymore */
+static int flush_pending(struct filtering_ctx *ctx)
+{
+    const int ret = sxpi_msg_fifo_flush(&ctx->pending, ctx->out_queue);
+    if (ret < 0)
+        return ret;
+    if (ret > 0)
+        sxpi_notifier_signal(ctx->notifier);
+    return !ctx->pending.count;
+}
+
 static int send_frame(struct filtering_ctx *ctx, AVFrame *frame)
 {
     int ret;
@@ -407,14 +482,20 @@ static int send_frame(struct filtering_ctx *ctx, AVFrame *frame)
         .data = frame,
     };
 
+    if (ctx->push_cb)
+        return push_user_frame(ctx, frame);
+
     TRACE(ctx, "sending filtered frame to the sink");
-    ret = av_thread_message_queue_send(ctx->out_queue, &msg, 0);
+    ret = send_message(ctx, &msg);
     if (ret < 0) {
         if (ret != AVERROR_EOF && ret != AVERROR_EXIT)
             LOG(ctx, ERROR, "unable to send frame: %s", av_err2str(ret));
+        return ret;
     }
 
-    return ret;
+    if (!ctx->nonblock)
+        sxpi_notifier_signal(ctx->notifier);
+    return 0;
 }
 
 static int push_frame(struct filtering_ctx *ctx, AVFrame *inframe)
@@ -517,93 +598,154 @@ static int flush_frames(struct filtering_ctx *ctx)
     return ret;
 }
 
-void sxpi_filtering_run(struct filtering_ctx *ctx)
+/* The message is always consumed */
+static int handle_message(struct filtering_ctx *ctx, struct message *msg)
 {
+    AVFrame *frame;
     int ret;
-    int in_err, out_err;
-
-    TRACE(ctx, "filtering packets from %p into %p", ctx->in_queue, ctx->out_queue);
 
-    // we want to force the reconstruction of the filtergraph
-    ctx->last_frame_format = AV_PIX_FMT_NONE;
+    if (msg->type == MSG_SEEK) {
+        TRACE(ctx, "message is a seek, destroy filtergraph and forward message to out queue");
+        if (!ctx->lazy) {
+            avfilter_graph_free(&ctx->filter_graph);
+            ctx->last_frame_format = AV_PIX_FMT_NONE;
+        }
+        sxpi_msg_fifo_drop(&ctx->pending);
+        sxpi_msg_queue_flush(ctx->out_queue);
+        ret = send_message(ctx, msg);
+        if (ret < 0) {
+            sxpi_msg_free_data(msg);
+            return ret;
+        }
+        return 1;
+    }
 
-    for (;;) {
-        AVFrame *frame;
-        struct message msg;
+    frame = msg->data;
 
-        TRACE(ctx, "fetching a frame from the inqueue");
-        ret = av_thread_message_queue_recv(ctx->in_queue, &msg, 0);
+    TRACE(ctx, "filtering %s %s frame @ ts=%s",
+          av_get_media_type_string(ctx->codecpar->codec_type),
+          ctx->codecpar->codec_type == AVMEDIA_TYPE_VIDEO ? av_get_pix_fmt_name(frame->format)
+                                                          : av_get_sample_fmt_name(frame->format),
+          av_ts2timestr(frame->pts, &ctx->st_timebase));
+
+    /* lazy filtergraph configuration */
+    // XXX: check width/height/samplerate/etc changes?
+    if (!ctx->lazy && ctx->last_frame_format != frame->format) {
+        ctx->last_frame_format = frame->format;
+        ret = setup_filtergraph(ctx);
         if (ret < 0) {
-            if (ret != AVERROR_EOF && ret != AVERROR_EXIT)
-                LOG(ctx, ERROR, "unable to fetch a frame from the inqueue: %s", av_err2str(ret));
-            break;
+            sxpi_msg_free_data(msg);
+            return ret;
         }
+    }
 
-        if (msg.type == MSG_SEEK) {
-            TRACE(ctx, "message is a seek, destroy filtergraph and forward message to out queue");
-            avfilter_graph_free(&ctx->filter_graph);
-            ctx->last_frame_format = AV_PIX_FMT_NONE;
-            av_thread_message_flush(ctx->out_queue);
-            ret = av_thread_message_queue_send(ctx->out_queue, &msg, 0);
-            if (ret < 0) {
-                sxpi_msg_free_data(&msg);
-                break;
-            }
-            continue;
-        }
+    // TODO: replace with a trim filter in libavfilter (check if hw accelerated
+    // filters work)
+    if (frame->pts < 0) {
+        sxpi_msg_free_data(msg);
+        TRACE(ctx, "frame ts is negative, skipping");
+        return 1;
+    } else if (ctx->max_pts != AV_NOPTS_VALUE && frame->pts > ctx->max_pts) {
+        sxpi_msg_free_data(msg);
+        TRACE(ctx, "reached trim duration");
+        return AVERROR_EXIT; // not EOF because we do not want to flush the frames
+    }
 
-        frame = msg.data;
-
-        TRACE(ctx, "filtering %s %s frame @ ts=%s",
-              av_get_media_type_string(ctx->codecpar->codec_type),
-              ctx->codecpar->codec_type == AVMEDIA_TYPE_VIDEO ? av_get_pix_fmt_name(frame->format)
-                                                              : av_get_sample_fmt_name(frame->format),
-              av_ts2timestr(frame->pts, &ctx->st_timebase));
-
-        /* lazy filtergraph configuration */
-        // XXX: check width/height/samplerate/etc changes?
-        if (ctx->last_frame_format != frame->format) {
-            ctx->last_frame_format = frame->format;
-            ret = setup_filtergraph(ctx);
-            if (ret < 0)
-                break;
+    if (ctx->lazy || !ctx->filter_graph) {
+        ret = send_frame(ctx, frame);
+        if (ret < 0) {
+            sxpi_msg_free_data(msg);
+            return ret;
         }
+    } else {
+        ret = push_frame(ctx, frame);
+        sxpi_msg_free_data(msg);
+        if (ret < 0)
+            return ret;
 
-        // TODO: replace with a trim filter in libavfilter (check if hw accelerated
-        // filters work)
-        if (frame->pts < 0) {
-            av_frame_free(&frame);
-            TRACE(ctx, "frame ts is negative, skipping");
-            continue;
-        } else if (ctx->max_pts != AV_NOPTS_VALUE && frame->pts > ctx->max_pts) {
-            av_frame_free(&frame);
-            TRACE(ctx, "reached trim duration");
-            ret = AVERROR_EXIT; // not EOF because we do not want to flush the frames
-            break;
-        }
+        ret = pull_send_frame(ctx);
+        if (ret < 0 && ret != AVERROR(EAGAIN))
+            return ret;
+    }
+    return 1;
+}
 
-        if (!ctx->filter_graph) {
-            ret = send_frame(ctx, frame);
-            if (ret < 0) {
-                av_frame_free(&frame);
-                break;
-            }
-        } else {
-            ret = push_frame(ctx, frame);
-            av_frame_free(&frame);
-            if (ret < 0)
-                break;
-
-            ret = pull_send_frame(ctx);
-            if (ret < 0 && ret != AVERROR(EAGAIN))
-                break;
-        }
+/* Returns a positive value if some work was done, 0 if the queues are not
+ * ready yet (only when stepping), or the reason of the end of filtering */
+static int filter_frame(struct filtering_ctx *ctx)
+{
+    struct message msg;
+    int ret;
+
+    if (ctx->nonblock) {
+        ret = flush_pending(ctx);
+        if (ret <= 0)
+            return ret;
     }
 
+    TRACE(ctx, "fetching a frame from the inqueue");
+    ret = sxpi_msg_queue_recv(ctx->in_queue, &msg, ctx->nonblock ? AV_THREAD_MESSAGE_NONBLOCK : 0);
+    if (ret == AVERROR(EAGAIN) && ctx->nonblock)
+        return 0;
+    if (ret < 0) {
+        if (ret != AVERROR_EOF && ret != AVERROR_EXIT)
+            LOG(ctx, ERROR, "unable to fetch a frame from the inqueue: %s", av_err2str(ret));
+        return ret;
+    }
+
+    return handle_message(ctx, &msg);
+}
+
+static void set_end(struct filtering_ctx *ctx, int ret)
+{
     /* Fetch remaining frames */
     if (ret == AVERROR_EOF)
         ret = flush_frames(ctx);
 
+    ctx->end_ret = ret < 0 && ret != AVERROR_EOF ? ret : AVERROR_EOF;
+}
+
+int sxpi_filtering_push_message(struct filtering_ctx *ctx, struct message *msg)
+{
+    if (ctx->end_ret)
+        return ctx->end_ret;
+
+    const int ret = handle_message(ctx, msg);
+    if (ret < 0)
+        set_end(ctx, ret);
+    return 0;
+}
+
+int sxpi_filtering_step(struct filtering_ctx *ctx, int flags)
+{
+    int ret;
+    int in_err, out_err;
+
+    ctx->nonblock = !!(flags & AV_THREAD_MESSAGE_NONBLOCK);
+
+    if (!ctx->end_ret) {
+        ret = filter_frame(ctx);
+        if (ret >= 0)
+            return ret;
+        set_end(ctx, ret);
+    }
+
+    /* The frames kept aside must reach the sink before the end of stream */
+    if (ctx->end_ret == AVERROR_EOF) {
+        ret = flush_pending(ctx);
+        if (!ret)
+            return 0;
+        if (ret < 0)
+            ctx->end_ret = ret;
+    }
+    sxpi_msg_fifo_drop(&ctx->pending);
+
+    ret = ctx->end_ret;
+    ctx->end_ret = 0;
+
+    // we want to force the reconstruction of the filtergraph
+    ctx->last_frame_format = AV_PIX_FMT_NONE;
+
     if (ret < 0 && ret != AVERROR_EOF) {
         in_err = out_err = ret;
     } else {
@@ -612,9 +754,62 @@ void sxpi_filtering_run(struct filtering_ctx *ctx)
     }
     TRACE(ctx, "notify decoder with %s and sink with %s",
           av_err2str(in_err), av_err2str(out_err));
-    av_thread_message_queue_set_err_send(ctx->in_queue,  in_err);
-    av_thread_message_flush(ctx->in_queue);
-    av_thread_message_queue_set_err_recv(ctx->out_queue, out_err);
+    sxpi_msg_queue_set_err_send(ctx->in_queue,  in_err);
+    sxpi_msg_queue_flush(ctx->in_queue);
+    sxpi_msg_queue_set_err_recv(ctx->out_queue, out_err);
+    sxpi_notifier_latch(ctx->notifier);
+
+    if (ctx->push_cb)
+        ctx->push_cb(ctx->push_opaque, NULL);
+    return ret;
+}
+
+void sxpi_filtering_run(struct filtering_ctx *ctx)
+{
+    TRACE(ctx, "filtering packets from %p into %p", ctx->in_queue, ctx->out_queue);
+    while (sxpi_filtering_step(ctx, 0) >= 0);
+}
+
+int sxpi_filtering_is_lazy(const struct filtering_ctx *ctx)
+{
+    return ctx->lazy;
+}
+
+int sxpi_filtering_convert_frame(struct filtering_ctx *ctx, AVFrame **framep)
+{
+    AVFrame *frame = *framep;
+    int ret;
+
+    if (ctx->last_frame_format != frame->format) {
+        ctx->last_frame_format = frame->format;
+        ret = setup_filtergraph(ctx);
+        if (ret < 0) {
+            ctx->last_frame_format = AV_PIX_FMT_NONE;
+            return ret;
+        }
+    }
+
+    if (!ctx->filter_graph)
+        return 0;
+
+    AVFrame *filtered_frame = av_frame_alloc();
+    if (!filtered_frame)
+        return AVERROR(ENOMEM);
+
+    ret = push_frame(ctx, frame);
+    if (ret >= 0)
+        ret = pull_frame(ctx, filtered_frame);
+    if (ret < 0) {
+        if (ret == AVERROR(EAGAIN))
+            LOG(ctx, ERROR, "the filters did not output the frame @ ts=%s right away",
+                av_ts2timestr(frame->pts, &ctx->st_timebase));
+        av_frame_free(&filtered_frame);
+        return ret;
+    }
+
+    av_frame_free(framep);
+    *framep = filtered_frame;
+    return 0;
 }
 
 void sxpi_filtering_free(struct filtering_ctx **fp)
@@ -636,5 +831,6 @@ void sxpi_filtering_free(struct filtering_ctx **fp)
     avfilter_graph_free(&ctx->filter_graph);
     avcodec_parameters_free(&ctx->codecpar);
     av_freep(&ctx->filters);
+    sxpi_msg_fifo_free(&ctx->pending);
     av_freep(fp);
 }
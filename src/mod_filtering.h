@@ -22,23 +22,56 @@
 #define MOD_FILTERING_H
 
 #include <libavcodec/avcodec.h>
-#include <libavutil/threadmessage.h>
+#include <libavutil/buffer.h>
 
+#include "msg_queue.h"
+#include "notifier.h"
 #include "opts.h"
 
 struct filtering_ctx *sxpi_filtering_alloc(void);
 
 int sxpi_filtering_init(void *log_ctx,
                         struct filtering_ctx *ctx,
-                        AVThreadMessageQueue *in_queue,
-                        AVThreadMessageQueue *out_queue,
+                        struct msg_queue *in_queue,
+                        struct msg_queue *out_queue,
                         const AVStream *stream,
                         const AVCodecContext *avctx,
                         double media_rotation,
-                        const struct sxplayer_opts *o);
+                        const struct sxplayer_opts *o,
+                        int (*push_cb)(void *opaque, struct sxplayer_frame *frame),
+                        void *push_opaque,
+                        AVBufferPool *frame_pool,
+                        struct notifier *notifier);
+
+/*
+ * Filter one frame or handle one message, see sxpi_demuxing_step() for the
+ * flags and returned value. Stepping without waiting is not possible in push
+ * mode, where the user callback may wait.
+ */
+int sxpi_filtering_step(struct filtering_ctx *ctx, int flags);
 
 void sxpi_filtering_run(struct filtering_ctx *ctx);
 
+/*
+ * Filter a frame or handle a message coming straight from the decoder instead
+ * of the in queue (fused decoding and filtering). The message is consumed
+ * unless the filtering already ended, in which case the reason is returned; a
+ * failure is reported on the next call, and sxpi_filtering_step() is then
+ * expected to notify the queues.
+ */
+int sxpi_filtering_push_message(struct filtering_ctx *ctx, struct message *msg);
+
+/*
+ * With lazy_filtering (video in pull mode), the frames are sent as decoded and
+ * only the ones returned to the user go through the filtergraph, with
+ * sxpi_filtering_convert_frame() on a context initialized without queues.
+ * The filters must output one frame for each input frame.
+ */
+int sxpi_filtering_is_lazy(const struct filtering_ctx *ctx);
+
+/* Replace the frame with its filtered version; it is left untouched on error */
+int sxpi_filtering_convert_frame(struct filtering_ctx *ctx, AVFrame **framep);
+
 void sxpi_filtering_free(struct filtering_ctx **ctxp);
 
 #endif
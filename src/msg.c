@@ -18,11 +18,15 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <string.h>
+
 #include <libavutil/frame.h>
 #include <libavutil/avassert.h>
+#include <libavutil/common.h>
 #include <libavcodec/avcodec.h>
 
 #include "msg.h"
+#include "msg_queue.h"
 
 void sxpi_msg_free_data(void *arg)
 {
@@ -31,23 +35,183 @@ void sxpi_msg_free_data(void *arg)
     switch (msg->type) {
     case MSG_FRAME: {
         AVFrame *frame = msg->data;
-        av_frame_free(&frame);
+        sxpi_msg_pool_put_frame(msg->pool, &frame);
         msg->data = NULL;
         break;
     }
-    case MSG_PACKET:
-        av_packet_unref(msg->data);
-        av_freep(&msg->data);
+    case MSG_PACKET: {
+        AVPacket *pkt = msg->data;
+        sxpi_msg_pool_put_packet(msg->pool, &pkt);
+        msg->data = NULL;
         break;
-    case MSG_SEEK:
+    }
     case MSG_INFO:
         av_freep(&msg->data);
         break;
+    case MSG_SEEK:
     case MSG_START:
     case MSG_STOP:
     case MSG_SYNC:
+    case MSG_DROP_REF:
         break;
     default:
         av_assert0(0);
     }
 }
+
+/* The free packets and frames wait in queues, which provide the thread safety
+ * without any lock; they are stored in messages without pool so they are
+ * simply freed with the queues */
+struct msg_pool {
+    struct msg_queue *packets;
+    struct msg_queue *frames;
+    int64_t nb_allocs;                      // updated atomically
+    int64_t nb_reuses;                      // updated atomically
+};
+
+static void *count_reuse(struct msg_pool *pool, void *data)
+{
+    __atomic_add_fetch(&pool->nb_reuses, 1, __ATOMIC_RELAXED);
+    return data;
+}
+
+static void count_alloc(struct msg_pool *pool)
+{
+    if (pool)
+        __atomic_add_fetch(&pool->nb_allocs, 1, __ATOMIC_RELAXED);
+}
+
+struct msg_pool *sxpi_msg_pool_alloc(int nb_packets, int nb_frames)
+{
+    struct msg_pool *pool = av_mallocz(sizeof(*pool));
+    if (!pool)
+        return NULL;
+    if (sxpi_msg_queue_alloc(&pool->packets, nb_packets) < 0 ||
+        sxpi_msg_queue_alloc(&pool->frames,  nb_frames)  < 0)
+        sxpi_msg_pool_free(&pool);
+    return pool;
+}
+
+AVPacket *sxpi_msg_pool_get_packet(struct msg_pool *pool)
+{
+    struct message msg;
+    if (pool && sxpi_msg_queue_recv(pool->packets, &msg, AV_THREAD_MESSAGE_NONBLOCK) >= 0)
+        return count_reuse(pool, msg.data);
+    count_alloc(pool);
+    return av_packet_alloc();
+}
+
+AVFrame *sxpi_msg_pool_get_frame(struct msg_pool *pool)
+{
+    struct message msg;
+    if (pool && sxpi_msg_queue_recv(pool->frames, &msg, AV_THREAD_MESSAGE_NONBLOCK) >= 0)
+        return count_reuse(pool, msg.data);
+    count_alloc(pool);
+    return av_frame_alloc();
+}
+
+void sxpi_msg_pool_put_packet(struct msg_pool *pool, AVPacket **pktp)
+{
+    AVPacket *pkt = *pktp;
+    if (!pkt)
+        return;
+    *pktp = NULL;
+    av_packet_unref(pkt);
+    struct message msg = { .type = MSG_PACKET, .data = pkt };
+    if (!pool || sxpi_msg_queue_send(pool->packets, &msg, AV_THREAD_MESSAGE_NONBLOCK) < 0)
+        av_packet_free(&pkt);
+}
+
+void sxpi_msg_pool_put_frame(struct msg_pool *pool, AVFrame **framep)
+{
+    AVFrame *frame = *framep;
+    if (!frame)
+        return;
+    *framep = NULL;
+    av_frame_unref(frame);
+    struct message msg = { .type = MSG_FRAME, .data = frame };
+    if (!pool || sxpi_msg_queue_send(pool->frames, &msg, AV_THREAD_MESSAGE_NONBLOCK) < 0)
+        av_frame_free(&frame);
+}
+
+void sxpi_msg_pool_get_stats(struct msg_pool *pool, int64_t *nb_allocs, int64_t *nb_reuses)
+{
+    *nb_allocs = __atomic_load_n(&pool->nb_allocs, __ATOMIC_RELAXED);
+    *nb_reuses = __atomic_load_n(&pool->nb_reuses, __ATOMIC_RELAXED);
+}
+
+void sxpi_msg_pool_free(struct msg_pool **poolp)
+{
+    struct msg_pool *pool = *poolp;
+    if (!pool)
+        return;
+    sxpi_msg_queue_free(&pool->packets);
+    sxpi_msg_queue_free(&pool->frames);
+    av_freep(poolp);
+}
+
+int sxpi_msg_fifo_push(struct msg_fifo *fifo, const struct message *msg)
+{
+    if (fifo->start + fifo->count == fifo->size) {
+        if (fifo->start) {
+            memmove(fifo->msgs, fifo->msgs + fifo->start, fifo->count * sizeof(*fifo->msgs));
+            fifo->start = 0;
+        } else {
+            const int size = FFMAX(fifo->size * 2, 16);
+            struct message *msgs = av_realloc_array(fifo->msgs, size, sizeof(*msgs));
+            if (!msgs)
+                return AVERROR(ENOMEM);
+            fifo->msgs = msgs;
+            fifo->size = size;
+        }
+    }
+    fifo->msgs[fifo->start + fifo->count++] = *msg;
+    return 0;
+}
+
+const struct message *sxpi_msg_fifo_peek(const struct msg_fifo *fifo)
+{
+    return fifo->count ? &fifo->msgs[fifo->start] : NULL;
+}
+
+int sxpi_msg_fifo_pop(struct msg_fifo *fifo, struct message *msg)
+{
+    if (!fifo->count)
+        return AVERROR(EAGAIN);
+    *msg = fifo->msgs[fifo->start++];
+    if (!--fifo->count)
+        fifo->start = 0;
+    return 0;
+}
+
+int sxpi_msg_fifo_flush(struct msg_fifo *fifo, struct msg_queue *queue)
+{
+    int nb_sent = 0;
+    while (fifo->count) {
+        int ret = sxpi_msg_queue_send(queue, &fifo->msgs[fifo->start], AV_THREAD_MESSAGE_NONBLOCK);
+        if (ret == AVERROR(EAGAIN))
+            break;
+        if (ret < 0)
+            return ret;
+        fifo->start++;
+        fifo->count--;
+        nb_sent++;
+    }
+    if (!fifo->count)
+        fifo->start = 0;
+    return nb_sent;
+}
+
+void sxpi_msg_fifo_drop(struct msg_fifo *fifo)
+{
+    for (int i = 0; i < fifo->count; i++)
+        sxpi_msg_free_data(&fifo->msgs[fifo->start + i]);
+    fifo->start = fifo->count = 0;
+}
+
+void sxpi_msg_fifo_free(struct msg_fifo *fifo)
+{
+    sxpi_msg_fifo_drop(fifo);
+    av_freep(&fifo->msgs);
+    fifo->size = 0;
+}
@@ -21,6 +21,10 @@
 #ifndef MSG_H
 #define MSG_H
 
+#include <stdint.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+
 enum msg_type {
     MSG_FRAME,
     MSG_PACKET,
@@ -29,14 +33,75 @@ enum msg_type {
     MSG_START,
     MSG_STOP,
     MSG_SYNC,
+    MSG_DROP_REF,
     NB_MSG
 };
 
+struct msg_pool;
+
 struct message {
-    void *data;
+    void *data;                             // frame, packet or stream information
     enum msg_type type;
+    void *origin;                           // user context which sent the control message
+    struct msg_pool *pool;                  // where the frame or packet goes back when freed, may be NULL
+    int64_t ts;                             // seek: requested time
+    int seek_id;                            // seek: identifier given by the control thread, 0 if none
+    int seek_precision;                     // seek: SXPLAYER_SEEK_*
+    int skip_frame;                         // drop ref: discard level (enum AVDiscard)
 };
 
+/* Release the frame or packet into the pool of the message, if any */
 void sxpi_msg_free_data(void *arg);
 
+/*
+ * Empty packets and frames recycled through the messages, so the modules do
+ * not allocate them for every message. The pool is not aware of the packets
+ * and frames it handed out: they may be released into another pool, or leave
+ * the pipeline (frames returned to the user), but it must outlive every
+ * message referencing it. All the functions are thread safe, and accept a
+ * NULL pool, in which case they simply allocate and free.
+ */
+struct msg_pool *sxpi_msg_pool_alloc(int nb_packets, int nb_frames);
+
+AVPacket *sxpi_msg_pool_get_packet(struct msg_pool *pool);
+
+AVFrame *sxpi_msg_pool_get_frame(struct msg_pool *pool);
+
+/* The data is unreferenced, and the packet freed if the pool is full */
+void sxpi_msg_pool_put_packet(struct msg_pool *pool, AVPacket **pktp);
+
+void sxpi_msg_pool_put_frame(struct msg_pool *pool, AVFrame **framep);
+
+/* Number of packets and frames allocated because the pool was empty, and
+ * taken back from the pool */
+void sxpi_msg_pool_get_stats(struct msg_pool *pool, int64_t *nb_allocs, int64_t *nb_reuses);
+
+void sxpi_msg_pool_free(struct msg_pool **poolp);
+
+/* Messages a queue could not take yet, in sending order */
+struct msg_fifo {
+    struct message *msgs;
+    int size;
+    int start;
+    int count;
+};
+
+int sxpi_msg_fifo_push(struct msg_fifo *fifo, const struct message *msg);
+
+/* Oldest message, or NULL if the fifo is empty */
+const struct message *sxpi_msg_fifo_peek(const struct msg_fifo *fifo);
+
+/* Returns AVERROR(EAGAIN) if the fifo is empty */
+int sxpi_msg_fifo_pop(struct msg_fifo *fifo, struct message *msg);
+
+/* Send as many of the kept aside messages as the queue can take without
+ * blocking, returns the number of messages sent or a queue error */
+struct msg_queue;
+
+int sxpi_msg_fifo_flush(struct msg_fifo *fifo, struct msg_queue *queue);
+
+void sxpi_msg_fifo_drop(struct msg_fifo *fifo);
+
+void sxpi_msg_fifo_free(struct msg_fifo *fifo);
+
 #endif
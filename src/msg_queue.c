@@ -0,0 +1,382 @@
+/*
+ * This file is part of sxplayer.
+ *
+ * Copyright (c) 2016 Stupeflix
+ *
+ * sxplayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * sxplayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with sxplayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _GNU_SOURCE // syscall() on Linux
+
+#include <limits.h>
+#include <stdint.h>
+
+#include <libavutil/common.h>
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+#include <libavutil/time.h>
+
+#include "msg_queue.h"
+#include "pthread_compat.h"
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define HAVE_FUTEX 1
+#else
+#define HAVE_FUTEX 0
+#endif
+
+#define RECV_INTERRUPTIBLE (1 << 30)   // internal receive flag, see sxpi_msg_queue_interrupt_recv()
+
+#define LOAD(p, order)          __atomic_load_n(p, __ATOMIC_##order)
+#define STORE(p, v, order)      __atomic_store_n(p, v, __ATOMIC_##order)
+
+/*
+ * Wait/wake point of one side of the queue. The waker only pays for a fence
+ * when nobody waits: a waiter registers itself before checking the queue
+ * again, and then sleeps as long as the sequence did not change.
+ */
+struct event {
+    uint32_t seq;
+    uint32_t nb_waiters;
+#if !HAVE_FUTEX
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+};
+
+/* The sequence tells whether the cell holds a message (position + 1) or is
+ * free for the position it is expected to be written at */
+struct cell {
+    uint32_t seq;
+    struct message msg;
+};
+
+struct msg_queue {
+    struct cell *cells;
+    uint32_t mask;
+    uint32_t capacity;
+
+    uint32_t head;                          // next position to receive
+    uint32_t tail;                          // next position to send
+
+    int err_send;
+    int err_recv;
+    int recv_interrupted;                   // consumed by the next interruptible receive waiting
+
+    struct event send_ev;                   // room available or send error
+    struct event recv_ev;                   // message available or receive error
+};
+
+static int event_init(struct event *ev)
+{
+#if !HAVE_FUTEX
+    if (pthread_mutex_init(&ev->lock, NULL))
+        return AVERROR(ENOMEM);
+    if (pthread_cond_init(&ev->cond, NULL)) {
+        pthread_mutex_destroy(&ev->lock);
+        return AVERROR(ENOMEM);
+    }
+#endif
+    return 0;
+}
+
+static void event_destroy(struct event *ev)
+{
+#if !HAVE_FUTEX
+    pthread_cond_destroy(&ev->cond);
+    pthread_mutex_destroy(&ev->lock);
+#endif
+}
+
+/* Must be called before checking the condition waited for */
+static uint32_t event_prepare_wait(struct event *ev)
+{
+    __atomic_add_fetch(&ev->nb_waiters, 1, __ATOMIC_SEQ_CST);
+    return LOAD(&ev->seq, SEQ_CST);
+}
+
+/* The deadline (av_gettime_relative() based, AV_NOPTS_VALUE for none) may
+ * end the wait before any signal */
+static void event_wait(struct event *ev, uint32_t seq, int64_t deadline)
+{
+#if HAVE_FUTEX
+    struct timespec timeout, *timeoutp = NULL;
+    if (deadline != AV_NOPTS_VALUE) {
+        const int64_t left = FFMAX(deadline - av_gettime_relative(), 0);
+        timeout.tv_sec  = left / 1000000;
+        timeout.tv_nsec = left % 1000000 * 1000;
+        timeoutp = &timeout;
+    }
+    syscall(SYS_futex, &ev->seq, FUTEX_WAIT_PRIVATE, seq, timeoutp, NULL, 0);
+#else
+    pthread_mutex_lock(&ev->lock);
+    if (deadline == AV_NOPTS_VALUE) {
+        while (LOAD(&ev->seq, SEQ_CST) == seq)
+            pthread_cond_wait(&ev->cond, &ev->lock);
+    } else {
+        /* The condition waits on the wall clock */
+        const int64_t abs_time = av_gettime() + FFMAX(deadline - av_gettime_relative(), 0);
+        const struct timespec abstime = {
+            .tv_sec  = abs_time / 1000000,
+            .tv_nsec = abs_time % 1000000 * 1000,
+        };
+        while (LOAD(&ev->seq, SEQ_CST) == seq)
+            if (pthread_cond_timedwait(&ev->cond, &ev->lock, &abstime) == ETIMEDOUT)
+                break;
+    }
+    pthread_mutex_unlock(&ev->lock);
+#endif
+}
+
+static void event_finish_wait(struct event *ev)
+{
+    __atomic_sub_fetch(&ev->nb_waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+/* Must be called after the change the waiters may be waiting for */
+static void event_signal(struct event *ev)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (!LOAD(&ev->nb_waiters, SEQ_CST))
+        return;
+#if HAVE_FUTEX
+    __atomic_add_fetch(&ev->seq, 1, __ATOMIC_SEQ_CST);
+    syscall(SYS_futex, &ev->seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&ev->lock);
+    __atomic_add_fetch(&ev->seq, 1, __ATOMIC_SEQ_CST);
+    pthread_cond_broadcast(&ev->cond);
+    pthread_mutex_unlock(&ev->lock);
+#endif
+}
+
+/* The cells sequences make the queue safe with several senders or receivers
+ * (flushes happen from both sides and from the control thread), while costing
+ * a single compare-and-swap per message when there is no contention */
+static int try_push(struct msg_queue *q, const struct message *msg)
+{
+    uint32_t pos = LOAD(&q->tail, RELAXED);
+    for (;;) {
+        if ((int32_t)(pos - LOAD(&q->head, ACQUIRE)) >= (int32_t)q->capacity)
+            return AVERROR(EAGAIN);
+        struct cell *cell = &q->cells[pos & q->mask];
+        const int32_t dif = (int32_t)(LOAD(&cell->seq, ACQUIRE) - pos);
+        if (dif < 0)
+            return AVERROR(EAGAIN);
+        if (dif > 0) {
+            pos = LOAD(&q->tail, RELAXED);
+            continue;
+        }
+        if (__atomic_compare_exchange_n(&q->tail, &pos, pos + 1, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            cell->msg = *msg;
+            STORE(&cell->seq, pos + 1, RELEASE);
+            return 0;
+        }
+    }
+}
+
+static int try_pop(struct msg_queue *q, struct message *msg)
+{
+    uint32_t pos = LOAD(&q->head, RELAXED);
+    for (;;) {
+        struct cell *cell = &q->cells[pos & q->mask];
+        const int32_t dif = (int32_t)(LOAD(&cell->seq, ACQUIRE) - (pos + 1));
+        if (dif < 0)
+            return AVERROR(EAGAIN);
+        if (dif > 0) {
+            pos = LOAD(&q->head, RELAXED);
+            continue;
+        }
+        if (__atomic_compare_exchange_n(&q->head, &pos, pos + 1, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            *msg = cell->msg;
+            STORE(&cell->seq, pos + q->mask + 1, RELEASE);
+            return 0;
+        }
+    }
+}
+
+int sxpi_msg_queue_alloc(struct msg_queue **qp, int nb_elems)
+{
+    if (nb_elems <= 0 || nb_elems > INT_MAX / 2)
+        return AVERROR(EINVAL);
+
+    struct msg_queue *q = av_mallocz(sizeof(*q));
+    if (!q)
+        return AVERROR(ENOMEM);
+
+    uint32_t size = 1;
+    while (size < nb_elems)
+        size <<= 1;
+    q->cells = av_calloc(size, sizeof(*q->cells));
+    if (!q->cells) {
+        av_free(q);
+        return AVERROR(ENOMEM);
+    }
+    for (uint32_t i = 0; i < size; i++)
+        q->cells[i].seq = i;
+    q->mask = size - 1;
+    q->capacity = nb_elems;
+
+    if (event_init(&q->send_ev) < 0) {
+        av_free(q->cells);
+        av_free(q);
+        return AVERROR(ENOMEM);
+    }
+    if (event_init(&q->recv_ev) < 0) {
+        event_destroy(&q->send_ev);
+        av_free(q->cells);
+        av_free(q);
+        return AVERROR(ENOMEM);
+    }
+
+    *qp = q;
+    return 0;
+}
+
+int sxpi_msg_queue_send(struct msg_queue *q, struct message *msg, int flags)
+{
+    int ret = LOAD(&q->err_send, ACQUIRE);
+    if (ret)
+        return ret;
+
+    ret = try_push(q, msg);
+    if (ret != AVERROR(EAGAIN) || (flags & AV_THREAD_MESSAGE_NONBLOCK)) {
+        if (ret >= 0)
+            event_signal(&q->recv_ev);
+        return ret;
+    }
+
+    for (;;) {
+        const uint32_t seq = event_prepare_wait(&q->send_ev);
+        ret = LOAD(&q->err_send, ACQUIRE);
+        if (!ret)
+            ret = try_push(q, msg);
+        if (ret != AVERROR(EAGAIN)) {
+            event_finish_wait(&q->send_ev);
+            if (ret >= 0)
+                event_signal(&q->recv_ev);
+            return ret;
+        }
+        event_wait(&q->send_ev, seq, AV_NOPTS_VALUE);
+        event_finish_wait(&q->send_ev);
+    }
+}
+
+static int queue_recv(struct msg_queue *q, struct message *msg, int flags, int64_t deadline)
+{
+    int ret = try_pop(q, msg);
+    if (ret >= 0) {
+        event_signal(&q->send_ev);
+        return ret;
+    }
+
+    const int err = LOAD(&q->err_recv, ACQUIRE);
+    if (err)
+        return err;
+    if (flags & AV_THREAD_MESSAGE_NONBLOCK)
+        return ret;
+
+    for (;;) {
+        const uint32_t seq = event_prepare_wait(&q->recv_ev);
+        ret = try_pop(q, msg);
+        if (ret >= 0) {
+            event_finish_wait(&q->recv_ev);
+            event_signal(&q->send_ev);
+            return ret;
+        }
+        ret = LOAD(&q->err_recv, ACQUIRE);
+        if (!ret && deadline != AV_NOPTS_VALUE && av_gettime_relative() >= deadline)
+            ret = AVERROR(EAGAIN);
+        if (!ret && (flags & RECV_INTERRUPTIBLE) &&
+            __atomic_exchange_n(&q->recv_interrupted, 0, __ATOMIC_ACQ_REL))
+            ret = AVERROR(EINTR);
+        if (ret) {
+            event_finish_wait(&q->recv_ev);
+            return ret;
+        }
+        event_wait(&q->recv_ev, seq, deadline);
+        event_finish_wait(&q->recv_ev);
+    }
+}
+
+int sxpi_msg_queue_recv(struct msg_queue *q, struct message *msg, int flags)
+{
+    return queue_recv(q, msg, flags, AV_NOPTS_VALUE);
+}
+
+int sxpi_msg_queue_recv_until(struct msg_queue *q, struct message *msg, int64_t deadline)
+{
+    return queue_recv(q, msg, 0, deadline);
+}
+
+int sxpi_msg_queue_recv_interruptible(struct msg_queue *q, struct message *msg)
+{
+    return queue_recv(q, msg, RECV_INTERRUPTIBLE, AV_NOPTS_VALUE);
+}
+
+void sxpi_msg_queue_interrupt_recv(struct msg_queue *q)
+{
+    STORE(&q->recv_interrupted, 1, RELEASE);
+    event_signal(&q->recv_ev);
+}
+
+void sxpi_msg_queue_set_err_send(struct msg_queue *q, int err)
+{
+    STORE(&q->err_send, err, RELEASE);
+    event_signal(&q->send_ev);
+}
+
+void sxpi_msg_queue_set_err_recv(struct msg_queue *q, int err)
+{
+    STORE(&q->err_recv, err, RELEASE);
+    event_signal(&q->recv_ev);
+}
+
+void sxpi_msg_queue_flush(struct msg_queue *q)
+{
+    struct message msg;
+    int nb_dropped = 0;
+
+    while (try_pop(q, &msg) >= 0) {
+        sxpi_msg_free_data(&msg);
+        nb_dropped++;
+    }
+    if (nb_dropped)
+        event_signal(&q->send_ev);
+}
+
+int sxpi_msg_queue_nb_elems(struct msg_queue *q)
+{
+    const uint32_t head = LOAD(&q->head, ACQUIRE);
+    const uint32_t tail = LOAD(&q->tail, ACQUIRE);
+    return av_clip((int32_t)(tail - head), 0, q->capacity);
+}
+
+void sxpi_msg_queue_free(struct msg_queue **qp)
+{
+    struct msg_queue *q = *qp;
+    if (!q)
+        return;
+    sxpi_msg_queue_flush(q);
+    event_destroy(&q->send_ev);
+    event_destroy(&q->recv_ev);
+    av_freep(&q->cells);
+    av_freep(qp);
+}
@@ -0,0 +1,67 @@
+/*
+ * This file is part of sxplayer.
+ *
+ * Copyright (c) 2016 Stupeflix
+ *
+ * sxplayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * sxplayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with sxplayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef MSG_QUEUE_H
+#define MSG_QUEUE_H
+
+#include <libavutil/threadmessage.h>
+
+#include "msg.h"
+
+/*
+ * Bounded lock-free message queue between the modules, a drop-in replacement
+ * of AVThreadMessageQueue (same flags, errors and flush semantics) where the
+ * sender and the receiver never take a lock unless they have to wait. The
+ * dropped messages are released with sxpi_msg_free_data().
+ */
+struct msg_queue;
+
+int sxpi_msg_queue_alloc(struct msg_queue **qp, int nb_elems);
+
+/* flags: 0 or AV_THREAD_MESSAGE_NONBLOCK */
+int sxpi_msg_queue_send(struct msg_queue *q, struct message *msg, int flags);
+
+/* The remaining messages are still received once the error is set */
+int sxpi_msg_queue_recv(struct msg_queue *q, struct message *msg, int flags);
+
+/* Blocking receive giving up with AVERROR(EAGAIN) once the deadline (in the
+ * av_gettime_relative() time base) is reached */
+int sxpi_msg_queue_recv_until(struct msg_queue *q, struct message *msg, int64_t deadline);
+
+/* Blocking receive giving up with AVERROR(EINTR) when the queue is empty and
+ * sxpi_msg_queue_interrupt_recv() was called since the latest interruption;
+ * the other receives ignore the interruptions */
+int sxpi_msg_queue_recv_interruptible(struct msg_queue *q, struct message *msg);
+
+void sxpi_msg_queue_interrupt_recv(struct msg_queue *q);
+
+void sxpi_msg_queue_set_err_send(struct msg_queue *q, int err);
+
+void sxpi_msg_queue_set_err_recv(struct msg_queue *q, int err);
+
+/* Can be called from any thread, concurrently with the sender and the
+ * receiver */
+void sxpi_msg_queue_flush(struct msg_queue *q);
+
+int sxpi_msg_queue_nb_elems(struct msg_queue *q);
+
+void sxpi_msg_queue_free(struct msg_queue **qp);
+
+#endif
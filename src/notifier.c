@@ -0,0 +1,178 @@
+/*
+ * This file is part of sxplayer.
+ *
+ * Copyright (c) 2015 Stupeflix
+ *
+ * sxplayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * sxplayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with sxplayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+#include "notifier.h"
+#include "pthread_compat.h"
+
+struct notifier {
+    pthread_mutex_t lock;
+    int fds[2];     // read and write ends, the same descriptor with eventfd
+    int signaled;   // the descriptor is readable, saves a syscall per signal
+    int latched;
+};
+
+struct notifier *sxpi_notifier_alloc(void)
+{
+    struct notifier *n = av_mallocz(sizeof(*n));
+    if (!n)
+        return NULL;
+    pthread_mutex_init(&n->lock, NULL);
+    n->fds[0] = n->fds[1] = -1;
+    return n;
+}
+
+#if !defined(_WIN32) && !defined(__linux__)
+static int set_nonblock_cloexec(int fd)
+{
+    const int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 ||
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0 ||
+        fcntl(fd, F_SETFD, FD_CLOEXEC) < 0)
+        return AVERROR(errno);
+    return 0;
+}
+#endif
+
+static int open_fds(struct notifier *n)
+{
+#if defined(__linux__)
+    const int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd < 0)
+        return AVERROR(errno);
+    n->fds[0] = n->fds[1] = fd;
+    return 0;
+#elif !defined(_WIN32)
+    int fds[2];
+    if (pipe(fds) < 0)
+        return AVERROR(errno);
+    int ret;
+    if ((ret = set_nonblock_cloexec(fds[0])) < 0 ||
+        (ret = set_nonblock_cloexec(fds[1])) < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return ret;
+    }
+    n->fds[0] = fds[0];
+    n->fds[1] = fds[1];
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+int sxpi_notifier_init(struct notifier *n)
+{
+    int ret = 0;
+    pthread_mutex_lock(&n->lock);
+    if (n->fds[0] < 0)
+        ret = open_fds(n);
+    pthread_mutex_unlock(&n->lock);
+    return ret;
+}
+
+int sxpi_notifier_get_fd(struct notifier *n)
+{
+    pthread_mutex_lock(&n->lock);
+    const int fd = n->fds[0];
+    pthread_mutex_unlock(&n->lock);
+    return fd;
+}
+
+static void signal_locked(struct notifier *n)
+{
+#ifndef _WIN32
+    if (n->fds[1] >= 0 && !n->signaled) {
+        const uint64_t v = 1;
+        if (write(n->fds[1], &v, sizeof(v)) == sizeof(v))
+            n->signaled = 1;
+    }
+#endif
+}
+
+static void clear_locked(struct notifier *n)
+{
+#ifndef _WIN32
+    if (n->signaled && !n->latched) {
+        uint64_t v;
+        while (read(n->fds[0], &v, sizeof(v)) > 0)
+            ;
+        n->signaled = 0;
+    }
+#endif
+}
+
+void sxpi_notifier_signal(struct notifier *n)
+{
+    pthread_mutex_lock(&n->lock);
+    signal_locked(n);
+    pthread_mutex_unlock(&n->lock);
+}
+
+void sxpi_notifier_clear(struct notifier *n)
+{
+    pthread_mutex_lock(&n->lock);
+    clear_locked(n);
+    pthread_mutex_unlock(&n->lock);
+}
+
+void sxpi_notifier_latch(struct notifier *n)
+{
+    pthread_mutex_lock(&n->lock);
+    n->latched = 1;
+    signal_locked(n);
+    pthread_mutex_unlock(&n->lock);
+}
+
+void sxpi_notifier_unlatch(struct notifier *n)
+{
+    pthread_mutex_lock(&n->lock);
+    n->latched = 0;
+    clear_locked(n);
+    pthread_mutex_unlock(&n->lock);
+}
+
+void sxpi_notifier_free(struct notifier **np)
+{
+    struct notifier *n = *np;
+    if (!n)
+        return;
+#ifndef _WIN32
+    if (n->fds[0] >= 0)
+        close(n->fds[0]);
+    if (n->fds[1] >= 0 && n->fds[1] != n->fds[0])
+        close(n->fds[1]);
+#endif
+    pthread_mutex_destroy(&n->lock);
+    av_freep(np);
+}
@@ -0,0 +1,48 @@
+/*
+ * This file is part of sxplayer.
+ *
+ * Copyright (c) 2015 Stupeflix
+ *
+ * sxplayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * sxplayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with sxplayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef NOTIFIER_H
+#define NOTIFIER_H
+
+/*
+ * File descriptor becoming readable when signaled, until cleared. It is only
+ * opened on demand so that contexts not integrated in an event loop do not pay
+ * for it.
+ */
+
+struct notifier *sxpi_notifier_alloc(void);
+
+/* Open the descriptor if not already, AVERROR(ENOSYS) if not supported */
+int sxpi_notifier_init(struct notifier *n);
+
+int sxpi_notifier_get_fd(struct notifier *n);
+
+void sxpi_notifier_signal(struct notifier *n);
+
+void sxpi_notifier_clear(struct notifier *n);
+
+/* Signal and ignore the clear requests until unlatched */
+void sxpi_notifier_latch(struct notifier *n);
+
+void sxpi_notifier_unlatch(struct notifier *n);
+
+void sxpi_notifier_free(struct notifier **np);
+
+#endif
@@ -23,6 +23,8 @@
 
 #include <stdint.h>
 
+struct sxplayer_frame;
+
 struct sxplayer_opts {
     int avselect;                           // select audio or video
     double start_time;                      // see public header
@@ -47,6 +49,19 @@ struct sxplayer_opts {
     char *vt_pix_fmt;                       // VideoToolbox pixel format in the CVPixelBufferRef
     int stream_idx;
     int use_pkt_duration;
+    char *cache_dir;                        // directory of the media information cache
+    int frame_cache_size;                   // memory budget of the decoded frame cache, in MiB
+    int packet_cache_size;                  // memory budget of the shared packet cache, in MiB
+    int direction;                          // playback direction (SXPLAYER_DIRECTION_*)
+    int exec_mode;                          // how the modules run (SXPLAYER_EXEC_*)
+    int codec_threads;                      // concurrent jobs of the shared codec thread pool, 0 for per decoder threads
+    int fused_filtering;                    // filter the frames in the decoder thread
+    int seek_precision;                     // precision of the seeks (SXPLAYER_SEEK_*), can change after configure
+    int lazy_filtering;                     // only filter the frames returned to the user
+    int adaptive_seek_trigger;              // pick between seeking and decoding forward from the measured costs
+    int intra_decoders;                     // parallel decoders of the intra-only video streams, 0 or 1 for a single one
+    int (*frame_cb)(void *arg, struct sxplayer_frame *frame); // user frame callback (push mode)
+    void *frame_cb_arg;                     // opaque user argument of the frame callback
 
     int64_t start_time64;
     int64_t end_time64;
@@ -32,6 +32,8 @@
 #include <limits.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
+#include <libavutil/time.h>
 
 typedef struct pthread_t {
     void *(*func)(void *arg);
@@ -159,6 +161,17 @@ static inline int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex
     return 0;
 }
 
+static inline int pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+                                         const struct timespec *abstime)
+{
+    const int64_t abs_ms = abstime->tv_sec * INT64_C(1000) + abstime->tv_nsec / 1000000;
+    const int64_t left = abs_ms - av_gettime() / 1000;
+    const DWORD timeout = left <= 0 ? 0 : left >= INFINITE ? INFINITE - 1 : (DWORD)left;
+    if (!SleepConditionVariableSRW(cond, mutex, timeout, 0))
+        return GetLastError() == ERROR_TIMEOUT ? ETIMEDOUT : EINVAL;
+    return 0;
+}
+
 static inline int pthread_cond_signal(pthread_cond_t *cond)
 {
     WakeConditionVariable(cond);
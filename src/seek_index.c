@@ -0,0 +1,198 @@
+/*
+ * This file is part of sxplayer.
+ *
+ * Copyright (c) 2015 Stupeflix
+ *
+ * sxplayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * sxplayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with sxplayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+#include <libavutil/avassert.h>
+#include <libavutil/avutil.h>
+#include <libavutil/mem.h>
+
+#include "seek_index.h"
+#include "pthread_compat.h"
+
+/*
+ * Keyframes are recorded by the demuxer as it reads the media, so the index
+ * is usually sparse: a seek can only trust an entry K if the keyframe
+ * following K is known as well (the entries were observed while reading
+ * linearly), otherwise there might be an unknown keyframe between K and the
+ * requested time.
+ */
+struct seek_index {
+    pthread_mutex_t lock;
+    int stream_idx;
+    AVRational time_base;
+    struct seek_index_entry *entries;
+    int nb_entries;
+    unsigned entries_size;
+};
+
+struct seek_index *sxpi_seek_index_alloc(void)
+{
+    struct seek_index *idx = av_mallocz(sizeof(*idx));
+    if (!idx)
+        return NULL;
+    if (pthread_mutex_init(&idx->lock, NULL)) {
+        av_free(idx);
+        return NULL;
+    }
+    idx->stream_idx = -1;
+    return idx;
+}
+
+void sxpi_seek_index_init(struct seek_index *idx, int stream_idx, AVRational time_base)
+{
+    pthread_mutex_lock(&idx->lock);
+    if (idx->stream_idx != stream_idx || av_cmp_q(idx->time_base, time_base)) {
+        idx->stream_idx = stream_idx;
+        idx->time_base  = time_base;
+        idx->nb_entries = 0;
+    }
+    pthread_mutex_unlock(&idx->lock);
+}
+
+/* Index of the last entry with a pts lower or equal to ts, -1 if none */
+static int search_entry(const struct seek_index *idx, int64_t ts)
+{
+    int lo = 0, hi = idx->nb_entries - 1, ret = -1;
+
+    while (lo <= hi) {
+        const int mid = (lo + hi) >> 1;
+        if (idx->entries[mid].pts <= ts) {
+            ret = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return ret;
+}
+
+int sxpi_seek_index_add(struct seek_index *idx, int64_t pts, int64_t pos, int64_t prev_pts)
+{
+    int ret = 0;
+
+    if (pts == AV_NOPTS_VALUE)
+        return 0;
+
+    pthread_mutex_lock(&idx->lock);
+
+    int i = search_entry(idx, pts);
+    if (i < 0 || idx->entries[i].pts != pts) {
+        struct seek_index_entry *entries = av_fast_realloc(idx->entries, &idx->entries_size,
+                                                           (idx->nb_entries + 1) * sizeof(*entries));
+        if (!entries) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        idx->entries = entries;
+        i++;
+        memmove(&entries[i + 1], &entries[i], (idx->nb_entries - i) * sizeof(*entries));
+        entries[i].pts = pts;
+        entries[i].pos = pos;
+        entries[i].contiguous = 0;
+        idx->nb_entries++;
+    } else if (idx->entries[i].pos < 0) {
+        idx->entries[i].pos = pos;
+    }
+
+    if (prev_pts != AV_NOPTS_VALUE && i > 0 && idx->entries[i - 1].pts == prev_pts)
+        idx->entries[i - 1].contiguous = 1;
+
+end:
+    pthread_mutex_unlock(&idx->lock);
+    return ret;
+}
+
+int sxpi_seek_index_lookup(struct seek_index *idx, int64_t ts, struct seek_index_entry *entry)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&idx->lock);
+    const int i = search_entry(idx, ts);
+    if (i >= 0 && idx->entries[i].contiguous) {
+        av_assert0(i + 1 < idx->nb_entries);
+        if (idx->entries[i + 1].pts > ts) {
+            *entry = idx->entries[i];
+            ret = 1;
+        }
+    }
+    pthread_mutex_unlock(&idx->lock);
+    return ret;
+}
+
+int sxpi_seek_index_get_prev(struct seek_index *idx, int64_t ts, int64_t *pts)
+{
+    pthread_mutex_lock(&idx->lock);
+    const int i = search_entry(idx, ts);
+    if (i >= 0)
+        *pts = idx->entries[i].pts;
+    pthread_mutex_unlock(&idx->lock);
+    return i >= 0;
+}
+
+int sxpi_seek_index_export(struct seek_index *idx, struct seek_index_entry **entriesp)
+{
+    int ret;
+
+    pthread_mutex_lock(&idx->lock);
+    ret = idx->nb_entries;
+    *entriesp = NULL;
+    if (ret) {
+        *entriesp = av_memdup(idx->entries, ret * sizeof(*idx->entries));
+        if (!*entriesp)
+            ret = AVERROR(ENOMEM);
+    }
+    pthread_mutex_unlock(&idx->lock);
+    return ret;
+}
+
+int sxpi_seek_index_import(struct seek_index *idx, const struct seek_index_entry *entries, int nb_entries)
+{
+    int64_t prev_pts = AV_NOPTS_VALUE;
+
+    for (int i = 0; i < nb_entries; i++) {
+        const struct seek_index_entry *e = &entries[i];
+        int ret = sxpi_seek_index_add(idx, e->pts, e->pos, prev_pts);
+        if (ret < 0)
+            return ret;
+        prev_pts = e->contiguous ? e->pts : AV_NOPTS_VALUE;
+    }
+    return 0;
+}
+
+int sxpi_seek_index_get_timestamps(struct seek_index *idx, double *timestamps, int max_nb)
+{
+    pthread_mutex_lock(&idx->lock);
+    const double tb = av_q2d(idx->time_base);
+    const int nb_entries = idx->nb_entries;
+    for (int i = 0; i < FFMIN(nb_entries, max_nb); i++)
+        timestamps[i] = idx->entries[i].pts * tb;
+    pthread_mutex_unlock(&idx->lock);
+    return nb_entries;
+}
+
+void sxpi_seek_index_free(struct seek_index **idxp)
+{
+    struct seek_index *idx = *idxp;
+    if (!idx)
+        return;
+    pthread_mutex_destroy(&idx->lock);
+    av_freep(&idx->entries);
+    av_freep(idxp);
+}
@@ -0,0 +1,55 @@
+/*
+ * This file is part of sxplayer.
+ *
+ * Copyright (c) 2015 Stupeflix
+ *
+ * sxplayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * sxplayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with sxplayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef SEEK_INDEX_H
+#define SEEK_INDEX_H
+
+#include <stdint.h>
+#include <libavutil/rational.h>
+
+struct seek_index_entry {
+    int64_t pts;        // keyframe presentation timestamp, in stream timebase
+    int64_t pos;        // byte offset of the keyframe packet, -1 if unknown
+    int contiguous;     // no unknown keyframe between this entry and the next one
+};
+
+struct seek_index *sxpi_seek_index_alloc(void);
+
+/* (Re)bind the index to a stream; the entries are dropped if the stream or
+ * its timebase changed */
+void sxpi_seek_index_init(struct seek_index *idx, int stream_idx, AVRational time_base);
+
+int sxpi_seek_index_add(struct seek_index *idx, int64_t pts, int64_t pos, int64_t prev_pts);
+
+int sxpi_seek_index_lookup(struct seek_index *idx, int64_t ts, struct seek_index_entry *entry);
+
+/* Get the pts of the last known keyframe at or before ts, return 1 if found */
+int sxpi_seek_index_get_prev(struct seek_index *idx, int64_t ts, int64_t *pts);
+
+/* Allocate a copy of the entries in *entriesp, return the number of entries */
+int sxpi_seek_index_export(struct seek_index *idx, struct seek_index_entry **entriesp);
+
+int sxpi_seek_index_import(struct seek_index *idx, const struct seek_index_entry *entries, int nb_entries);
+
+int sxpi_seek_index_get_timestamps(struct seek_index *idx, double *timestamps, int max_nb);
+
+void sxpi_seek_index_free(struct seek_index **idxp);
+
+#endif
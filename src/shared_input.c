@@ -0,0 +1,614 @@
+/*
+ * This file is part of sxplayer.
+ *
+ * Copyright (c) 2015 Stupeflix
+ *
+ * sxplayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * sxplayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with sxplayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include <libavutil/avstring.h>
+#include <libavutil/common.h>
+#include <libavutil/mem.h>
+
+#include "shared_input.h"
+#include "internal.h"
+#include "log.h"
+
+/* A keyframe only opens a new segment once the current one holds at least
+ * this number of packets, so the streams made of keyframes only (audio) are
+ * not split at every packet */
+#define MIN_SEGMENT_PACKETS 16
+
+/* Maximum number of packets read from the input at once, so the consumers
+ * reading at different positions take turns */
+#define MAX_READ_BATCH 64
+
+struct segment {
+    int64_t start;          // pts of the keyframe opening the segment
+    int64_t end;            // pts of the keyframe opening the next segment
+    int64_t max_pts;
+    AVPacket **packets;     // in demuxing order
+    int nb_packets;
+    int packets_size;
+    int complete;           // all the packets up to the next segment are known
+    int eof;                // complete, and the last segment of the stream
+    int64_t size;
+    uint64_t last_use;
+};
+
+/*
+ * The stream is cached in segments starting at a keyframe, sorted by start so
+ * the segment containing a given time can be found with a binary search. The
+ * input read position is only known when it is right after the last packet of
+ * the tail segment; extending any other segment requires a seek.
+ */
+struct shared_input {
+    /* Registry key */
+    char *filename;
+    int avselect;
+    int stream_idx_opt;
+    int refcount;
+
+    pthread_mutex_t lock;
+    AVFormatContext *fmt_ctx;
+    int stream_idx;
+    int at_start;                   // nothing was read since the input was opened
+    int64_t first_start;            // start of the first segment of the stream
+
+    struct segment **segments;
+    int nb_segments;
+    struct segment *tail;
+    int64_t size;
+    int64_t max_size;
+    uint64_t clock;
+
+    int64_t hits;
+    int64_t misses;
+};
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct shared_input **registry;
+static int registry_count;
+
+static struct shared_input *alloc_input(const char *filename, const struct sxplayer_opts *opts)
+{
+    struct shared_input *si = av_mallocz(sizeof(*si));
+    if (!si)
+        return NULL;
+    si->filename = av_strdup(filename);
+    if (!si->filename) {
+        av_free(si);
+        return NULL;
+    }
+    si->avselect       = opts->avselect;
+    si->stream_idx_opt = opts->stream_idx;
+    si->first_start    = AV_NOPTS_VALUE;
+    pthread_mutex_init(&si->lock, NULL);
+    return si;
+}
+
+struct shared_input *sxpi_shared_input_acquire(const char *filename, const struct sxplayer_opts *opts)
+{
+    struct shared_input *si = NULL;
+
+    pthread_mutex_lock(&registry_lock);
+    for (int i = 0; i < registry_count; i++) {
+        if (!strcmp(registry[i]->filename, filename) &&
+            registry[i]->avselect == opts->avselect &&
+            registry[i]->stream_idx_opt == opts->stream_idx) {
+            si = registry[i];
+            break;
+        }
+    }
+
+    if (!si) {
+        struct shared_input **entries = av_realloc_array(registry, registry_count + 1, sizeof(*registry));
+        if (entries) {
+            registry = entries;
+            si = alloc_input(filename, opts);
+            if (si)
+                registry[registry_count++] = si;
+        }
+    }
+
+    if (si) {
+        si->refcount++;
+        pthread_mutex_lock(&si->lock);
+        si->max_size = FFMAX(si->max_size, (int64_t)opts->packet_cache_size << 20);
+        pthread_mutex_unlock(&si->lock);
+    }
+    pthread_mutex_unlock(&registry_lock);
+    return si;
+}
+
+void sxpi_shared_input_lock(struct shared_input *si)
+{
+    pthread_mutex_lock(&si->lock);
+}
+
+void sxpi_shared_input_unlock(struct shared_input *si)
+{
+    pthread_mutex_unlock(&si->lock);
+}
+
+AVFormatContext *sxpi_shared_input_get_format(struct shared_input *si, int *stream_idx)
+{
+    *stream_idx = si->stream_idx;
+    return si->fmt_ctx;
+}
+
+void sxpi_shared_input_set_format(struct shared_input *si, AVFormatContext *fmt_ctx, int stream_idx)
+{
+    si->fmt_ctx = fmt_ctx;
+    si->stream_idx = stream_idx;
+    si->at_start = 1;
+}
+
+void sxpi_shared_input_init_cursor(struct shared_input_cursor *cur, void *log_ctx)
+{
+    memset(cur, 0, sizeof(*cur));
+    cur->log_ctx = log_ctx;
+    cur->start = AV_NOPTS_VALUE;
+}
+
+static int64_t get_pkt_pts(const AVPacket *pkt)
+{
+    return pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+}
+
+/* Index of the last segment starting at or before ts, -1 if none */
+static int search_segment(const struct shared_input *si, int64_t ts)
+{
+    int lo = 0, hi = si->nb_segments - 1, ret = -1;
+
+    while (lo <= hi) {
+        const int mid = (lo + hi) >> 1;
+        if (si->segments[mid]->start <= ts) {
+            ret = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return ret;
+}
+
+static struct segment *get_segment(const struct shared_input *si, int64_t start)
+{
+    const int i = search_segment(si, start);
+    return i >= 0 && si->segments[i]->start == start ? si->segments[i] : NULL;
+}
+
+static int segment_covers(const struct segment *seg, int64_t ts)
+{
+    if (seg->complete)
+        return seg->eof || ts < seg->end;
+    return ts <= seg->max_pts;
+}
+
+static struct segment *insert_segment(struct shared_input *si, int64_t start)
+{
+    struct segment **segments = av_realloc_array(si->segments, si->nb_segments + 1, sizeof(*segments));
+    if (!segments)
+        return NULL;
+    si->segments = segments;
+
+    struct segment *seg = av_mallocz(sizeof(*seg));
+    if (!seg)
+        return NULL;
+    seg->start   = start;
+    seg->end     = AV_NOPTS_VALUE;
+    seg->max_pts = start;
+
+    const int i = search_segment(si, start) + 1;
+    memmove(&segments[i + 1], &segments[i], (si->nb_segments - i) * sizeof(*segments));
+    segments[i] = seg;
+    si->nb_segments++;
+    return seg;
+}
+
+static void remove_segment(struct shared_input *si, int i)
+{
+    struct segment *seg = si->segments[i];
+
+    if (si->tail == seg)
+        si->tail = NULL;
+    si->size -= seg->size;
+    for (int j = 0; j < seg->nb_packets; j++)
+        av_packet_free(&seg->packets[j]);
+    av_freep(&seg->packets);
+    av_freep(&seg);
+
+    memmove(&si->segments[i], &si->segments[i + 1], (si->nb_segments - i - 1) * sizeof(*si->segments));
+    si->nb_segments--;
+}
+
+/* Move the packet into the segment */
+static int append_packet(struct shared_input *si, struct segment *seg, AVPacket *pkt)
+{
+    if (seg->nb_packets == seg->packets_size) {
+        const int size = FFMAX(seg->packets_size * 2, MIN_SEGMENT_PACKETS);
+        AVPacket **packets = av_realloc_array(seg->packets, size, sizeof(*packets));
+        if (!packets) {
+            av_packet_unref(pkt);
+            return AVERROR(ENOMEM);
+        }
+        seg->packets = packets;
+        seg->packets_size = size;
+    }
+
+    AVPacket *cached = av_packet_alloc();
+    if (!cached) {
+        av_packet_unref(pkt);
+        return AVERROR(ENOMEM);
+    }
+    av_packet_move_ref(cached, pkt);
+    seg->packets[seg->nb_packets++] = cached;
+
+    const int64_t size = cached->size + sizeof(*cached);
+    seg->size += size;
+    si->size += size;
+
+    const int64_t pts = get_pkt_pts(cached);
+    if (pts != AV_NOPTS_VALUE)
+        seg->max_pts = FFMAX(seg->max_pts, pts);
+    return 0;
+}
+
+/* Drop the least recently used segments until the cache fits its budget; the
+ * tail and the segments used by the current operation are always kept */
+static void evict_segments(struct shared_input *si)
+{
+    while (si->size > si->max_size) {
+        int lru = -1;
+        for (int i = 0; i < si->nb_segments; i++) {
+            const struct segment *seg = si->segments[i];
+            if (seg == si->tail || seg->last_use == si->clock)
+                continue;
+            if (lru < 0 || seg->last_use < si->segments[lru]->last_use)
+                lru = i;
+        }
+        if (lru < 0)
+            break;
+        remove_segment(si, lru);
+    }
+}
+
+/* Read the next packet of the selected stream from the input */
+static int read_input(struct shared_input *si, AVPacket *pkt)
+{
+    si->at_start = 0;
+    for (;;) {
+        int ret = av_read_frame(si->fmt_ctx, pkt);
+        if (ret < 0)
+            return ret;
+        if (pkt->stream_index == si->stream_idx)
+            return 0;
+        av_packet_unref(pkt);
+    }
+}
+
+/*
+ * Seek the input before ts (at the beginning of the stream if ts is
+ * AV_NOPTS_VALUE) and read up to the first keyframe with a pts at or after
+ * min_pts (any keyframe if min_pts is AV_NOPTS_VALUE).
+ */
+static int seek_input(struct shared_input *si, struct shared_input_cursor *cur,
+                      int64_t ts, int64_t min_pts, AVPacket *pkt)
+{
+    int ret = 0;
+
+    si->tail = NULL;
+    if (ts == AV_NOPTS_VALUE && !si->at_start) {
+        const AVStream *st = si->fmt_ctx->streams[si->stream_idx];
+        ts = st->start_time != AV_NOPTS_VALUE ? st->start_time : 0;
+    }
+    if (ts != AV_NOPTS_VALUE) {
+        TRACE(cur, "seek shared input at %"PRId64, ts);
+        ret = avformat_seek_file(si->fmt_ctx, si->stream_idx, INT64_MIN, ts, ts, 0);
+        if (ret < 0) {
+            LOG(cur, ERROR, "Unable to seek in the shared input: %s", av_err2str(ret));
+            return ret;
+        }
+    }
+
+    for (;;) {
+        ret = read_input(si, pkt);
+        if (ret < 0)
+            return ret;
+        const int64_t pts = get_pkt_pts(pkt);
+        if ((pkt->flags & AV_PKT_FLAG_KEY) && pts != AV_NOPTS_VALUE &&
+            (min_pts == AV_NOPTS_VALUE || pts >= min_pts))
+            return 0;
+        av_packet_unref(pkt);
+    }
+}
+
+/* Make the cursor read the segment opened by the first keyframe found after
+ * seeking the input at ts */
+static int open_segment(struct shared_input *si, struct shared_input_cursor *cur, int64_t ts)
+{
+    AVPacket pkt;
+    int ret = seek_input(si, cur, ts, AV_NOPTS_VALUE, &pkt);
+    if (ret < 0)
+        return ret;
+
+    const int64_t start = get_pkt_pts(&pkt);
+    struct segment *seg = get_segment(si, start);
+    if (!seg) {
+        seg = insert_segment(si, start);
+        if (!seg) {
+            av_packet_unref(&pkt);
+            return AVERROR(ENOMEM);
+        }
+    }
+    if (!seg->nb_packets) {
+        ret = append_packet(si, seg, &pkt);
+        if (ret < 0)
+            return ret;
+        si->tail = seg;
+    } else {
+        av_packet_unref(&pkt);
+        if (seg->nb_packets == 1 && !seg->complete)
+            si->tail = seg;
+    }
+
+    if (ts == AV_NOPTS_VALUE)
+        si->first_start = start;
+    seg->last_use = si->clock;
+    cur->start = start;
+    cur->idx = 0;
+    return 0;
+}
+
+/* Move the input read position after the last packet of the segment */
+static int reposition_input(struct shared_input *si, struct shared_input_cursor *cur,
+                            struct segment *seg)
+{
+    AVPacket pkt;
+
+    TRACE(cur, "reposition shared input at segment %"PRId64" packet %d",
+          seg->start, seg->nb_packets);
+
+    int ret = seek_input(si, cur, seg->start, seg->start, &pkt);
+    if (ret >= 0 && get_pkt_pts(&pkt) != seg->start) {
+        av_packet_unref(&pkt);
+        ret = AVERROR_INVALIDDATA;
+    }
+
+    if (ret >= 0 && !seg->nb_packets) {
+        ret = append_packet(si, seg, &pkt);
+    } else if (ret >= 0) {
+        av_packet_unref(&pkt);
+        for (int i = 1; i < seg->nb_packets && ret >= 0; i++) {
+            ret = read_input(si, &pkt);
+            if (ret >= 0)
+                av_packet_unref(&pkt);
+        }
+    }
+
+    if (ret < 0) {
+        LOG(cur, ERROR, "Unable to find back the segment at %"PRId64" in the shared input: %s",
+            seg->start, av_err2str(ret));
+        return ret == AVERROR_EOF ? AVERROR_INVALIDDATA : ret;
+    }
+    si->tail = seg;
+    return 0;
+}
+
+/* Read more packets of an incomplete segment from the input */
+static int extend_segment(struct shared_input *si, struct shared_input_cursor *cur,
+                          struct segment *seg)
+{
+    AVPacket pkt;
+    int ret;
+
+    if (si->tail != seg) {
+        const int nb_packets = seg->nb_packets;
+        ret = reposition_input(si, cur, seg);
+        if (ret < 0 || seg->nb_packets != nb_packets)
+            return ret;
+    }
+
+    for (int i = 0; i < MAX_READ_BATCH; i++) {
+        ret = read_input(si, &pkt);
+        if (ret == AVERROR_EOF) {
+            seg->complete = seg->eof = 1;
+            si->tail = NULL;
+            return 0;
+        }
+        if (ret < 0) {
+            si->tail = NULL;
+            return ret;
+        }
+
+        const int64_t pts = get_pkt_pts(&pkt);
+        if ((pkt.flags & AV_PKT_FLAG_KEY) && pts != AV_NOPTS_VALUE && pts > seg->max_pts &&
+            seg->nb_packets >= MIN_SEGMENT_PACKETS) {
+            seg->complete = 1;
+            seg->end = pts;
+
+            struct segment *next = get_segment(si, pts);
+            if (!next)
+                next = insert_segment(si, pts);
+            if (!next) {
+                av_packet_unref(&pkt);
+                si->tail = NULL;
+                return AVERROR(ENOMEM);
+            }
+            if (!next->nb_packets) {
+                si->tail = NULL;
+                ret = append_packet(si, next, &pkt);
+                if (ret < 0)
+                    return ret;
+                si->tail = next;
+            } else {
+                av_packet_unref(&pkt);
+                si->tail = next->nb_packets == 1 && !next->complete ? next : NULL;
+            }
+            next->last_use = si->clock;
+            return 0;
+        }
+
+        ret = append_packet(si, seg, &pkt);
+        if (ret < 0) {
+            si->tail = NULL;
+            return ret;
+        }
+    }
+    return 0;
+}
+
+int sxpi_shared_input_seek(struct shared_input *si, struct shared_input_cursor *cur, int64_t ts)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&si->lock);
+    si->clock++;
+    cur->eof = 0;
+
+    struct segment *seg = NULL;
+    for (int i = search_segment(si, ts); i >= 0 && !seg; i--)
+        if (segment_covers(si->segments[i], ts))
+            seg = si->segments[i];
+
+    if (seg) {
+        TRACE(cur, "seek at %"PRId64" served by segment %"PRId64, ts, seg->start);
+        seg->last_use = si->clock;
+        cur->start = seg->start;
+        cur->idx = 0;
+    } else {
+        ret = open_segment(si, cur, ts);
+        if (ret == AVERROR_EOF) {
+            cur->eof = 1;
+            ret = 0;
+        }
+    }
+
+    evict_segments(si);
+    pthread_mutex_unlock(&si->lock);
+    return ret;
+}
+
+int sxpi_shared_input_read(struct shared_input *si, struct shared_input_cursor *cur, AVPacket *pkt)
+{
+    int ret = 0, from_input = 0;
+
+    pthread_mutex_lock(&si->lock);
+    si->clock++;
+
+    for (;;) {
+        if (cur->eof) {
+            ret = AVERROR_EOF;
+            break;
+        }
+
+        if (cur->start == AV_NOPTS_VALUE)
+            cur->start = si->first_start;
+        if (cur->start == AV_NOPTS_VALUE) {
+            ret = open_segment(si, cur, AV_NOPTS_VALUE);
+            if (ret < 0)
+                break;
+            from_input = 1;
+            continue;
+        }
+
+        /* The segment may have been evicted since the cursor entered it, in
+         * which case it is read again up to the cursor position */
+        struct segment *seg = get_segment(si, cur->start);
+        if (!seg && !(seg = insert_segment(si, cur->start))) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        seg->last_use = si->clock;
+
+        if (cur->idx < seg->nb_packets) {
+            ret = av_packet_ref(pkt, seg->packets[cur->idx]);
+            if (ret < 0)
+                break;
+            cur->idx++;
+            if (from_input)
+                si->misses++;
+            else
+                si->hits++;
+            break;
+        }
+
+        if (seg->eof) {
+            ret = AVERROR_EOF;
+            break;
+        }
+        if (seg->complete) {
+            cur->start = seg->end;
+            cur->idx = 0;
+            continue;
+        }
+
+        ret = extend_segment(si, cur, seg);
+        if (ret < 0)
+            break;
+        from_input = 1;
+    }
+
+    evict_segments(si);
+    pthread_mutex_unlock(&si->lock);
+    return ret;
+}
+
+void sxpi_shared_input_get_stats(struct shared_input *si, struct shared_input_stats *stats)
+{
+    pthread_mutex_lock(&si->lock);
+    stats->hits   = si->hits;
+    stats->misses = si->misses;
+    stats->size   = si->size;
+    pthread_mutex_unlock(&si->lock);
+}
+
+void sxpi_shared_input_release(struct shared_input **sip)
+{
+    struct shared_input *si = *sip;
+    if (!si)
+        return;
+    *sip = NULL;
+
+    pthread_mutex_lock(&registry_lock);
+    const int last = !--si->refcount;
+    if (last) {
+        for (int i = 0; i < registry_count; i++) {
+            if (registry[i] == si) {
+                memmove(&registry[i], &registry[i + 1], (registry_count - i - 1) * sizeof(*registry));
+                registry_count--;
+                break;
+            }
+        }
+        if (!registry_count)
+            av_freep(&registry);
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    if (!last)
+        return;
+
+    while (si->nb_segments)
+        remove_segment(si, si->nb_segments - 1);
+    av_freep(&si->segments);
+    avformat_close_input(&si->fmt_ctx);
+    pthread_mutex_destroy(&si->lock);
+    av_freep(&si->filename);
+    av_free(si);
+}
@@ -0,0 +1,73 @@
+/*
+ * This file is part of sxplayer.
+ *
+ * Copyright (c) 2015 Stupeflix
+ *
+ * sxplayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * sxplayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with sxplayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef SHARED_INPUT_H
+#define SHARED_INPUT_H
+
+#include <stdint.h>
+#include <libavformat/avformat.h>
+
+#include "opts.h"
+
+/* Read position of one consumer of a shared input */
+struct shared_input_cursor {
+    void *log_ctx;
+    int64_t start;      // key of the segment being read, AV_NOPTS_VALUE for the beginning of the stream
+    int idx;            // index of the next packet in the segment
+    int eof;            // nothing left to read since the latest seek
+};
+
+struct shared_input_stats {
+    int64_t hits;       // packets served from memory
+    int64_t misses;     // packets read from the input to be served
+    int64_t size;       // memory currently used by the cached packets, in bytes
+};
+
+/*
+ * Get a reference to the process-wide input shared by all the contexts
+ * reading the same stream (avselect and stream_idx) of filename. The packet
+ * cache budget is the largest one requested.
+ */
+struct shared_input *sxpi_shared_input_acquire(const char *filename, const struct sxplayer_opts *opts);
+
+/* The format context accessors must be called with the lock held */
+void sxpi_shared_input_lock(struct shared_input *si);
+void sxpi_shared_input_unlock(struct shared_input *si);
+
+/* Return NULL if the input was not opened yet */
+AVFormatContext *sxpi_shared_input_get_format(struct shared_input *si, int *stream_idx);
+
+/* Give the opened input (with only the selected stream not discarded) to the
+ * shared input, which will close it */
+void sxpi_shared_input_set_format(struct shared_input *si, AVFormatContext *fmt_ctx, int stream_idx);
+
+void sxpi_shared_input_init_cursor(struct shared_input_cursor *cur, void *log_ctx);
+
+/* Move the cursor to the keyframe preceding ts (in stream timebase) */
+int sxpi_shared_input_seek(struct shared_input *si, struct shared_input_cursor *cur, int64_t ts);
+
+/* Get a new reference to the next packet of the selected stream */
+int sxpi_shared_input_read(struct shared_input *si, struct shared_input_cursor *cur, AVPacket *pkt);
+
+void sxpi_shared_input_get_stats(struct shared_input *si, struct shared_input_stats *stats);
+
+void sxpi_shared_input_release(struct shared_input **sip);
+
+#endif
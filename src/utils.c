@@ -20,6 +20,8 @@
 
 #define _GNU_SOURCE // pthread_setname_np on Linux
 
+#include <libavcodec/avcodec.h>
+
 #include "sxplayer.h"
 #include "internal.h"
 #include "pthread_compat.h"
@@ -99,3 +101,11 @@ void sxpi_update_dimensions(int *width, int *height, int max_pixels)
         }
     }
 }
+
+/* Every frame of an intra-only video stream is a keyframe, so none of them
+ * needs another one to be decoded */
+int sxpi_is_intra_only(const struct AVCodecParameters *par)
+{
+    const AVCodecDescriptor *desc = avcodec_descriptor_get(par->codec_id);
+    return par->codec_type == AVMEDIA_TYPE_VIDEO && desc && (desc->props & AV_CODEC_PROP_INTRA_ONLY);
+}
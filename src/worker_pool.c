@@ -0,0 +1,332 @@
+/*
+ * This file is part of sxplayer.
+ *
+ * Copyright (c) 2016 Stupeflix
+ *
+ * sxplayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * sxplayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with sxplayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <libavutil/common.h>
+#include <libavutil/cpu.h>
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+
+#include "internal.h"
+#include "pthread_compat.h"
+#include "worker_pool.h"
+
+#define MAX_TASK_STEPS 32   // steps in a row before giving the other tasks a chance
+
+enum task_state {
+    TASK_IDLE,              // waiting to be woken
+    TASK_QUEUED,            // in a run queue
+    TASK_RUNNING,
+};
+
+struct task {
+    worker_task_func func;
+    void *arg;
+    struct worker_set *set;
+    enum task_state state;
+    int woken;              // woken while running, so it must run again
+    struct task *set_next;
+    struct task *prev;      // run queue links
+    struct task *next;
+};
+
+struct task_queue {
+    struct task *head;
+    struct task *tail;
+};
+
+struct worker {
+    pthread_t tid;
+    struct task_queue local;    // tasks woken by this worker, the most recent first
+};
+
+struct worker_set {
+    struct task *tasks;
+    pthread_cond_t done_cond;   // signaled every time a task of the set is done
+};
+
+/* Starting and stopping the workers is serialized by the users lock, the
+ * scheduling (sets included) is protected by the pool lock */
+static pthread_mutex_t users_lock = PTHREAD_MUTEX_INITIALIZER;
+static int nb_users;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_cond = PTHREAD_COND_INITIALIZER;
+static struct worker *workers;
+static int nb_workers;
+static int quit;
+static struct task_queue injector;  // tasks woken from outside the pool, or which used all their steps
+
+static void push_front(struct task_queue *q, struct task *task)
+{
+    task->prev = NULL;
+    task->next = q->head;
+    if (q->head)
+        q->head->prev = task;
+    else
+        q->tail = task;
+    q->head = task;
+}
+
+static void push_back(struct task_queue *q, struct task *task)
+{
+    task->next = NULL;
+    task->prev = q->tail;
+    if (q->tail)
+        q->tail->next = task;
+    else
+        q->head = task;
+    q->tail = task;
+}
+
+static struct task *pop_front(struct task_queue *q)
+{
+    struct task *task = q->head;
+    if (!task)
+        return NULL;
+    q->head = task->next;
+    if (q->head)
+        q->head->prev = NULL;
+    else
+        q->tail = NULL;
+    return task;
+}
+
+static struct task *pop_back(struct task_queue *q)
+{
+    struct task *task = q->tail;
+    if (!task)
+        return NULL;
+    q->tail = task->prev;
+    if (q->tail)
+        q->tail->next = NULL;
+    else
+        q->head = NULL;
+    return task;
+}
+
+/* A task woken by a worker goes in front of its local queue since it most
+ * likely consumes what the worker just produced */
+static void schedule_task(struct task *task, struct worker *w)
+{
+    if (task->state == TASK_RUNNING) {
+        task->woken = 1;
+        return;
+    }
+    if (task->state != TASK_IDLE)
+        return;
+    task->state = TASK_QUEUED;
+    if (w)
+        push_front(&w->local, task);
+    else
+        push_back(&injector, task);
+    pthread_cond_signal(&pool_cond);
+}
+
+static void wake_set(struct worker_set *set, const struct task *self, struct worker *w)
+{
+    for (struct task *task = set->tasks; task; task = task->set_next)
+        if (task != self)
+            schedule_task(task, w);
+}
+
+static void remove_task(struct task *task)
+{
+    struct worker_set *set = task->set;
+    struct task **tp = &set->tasks;
+    while (*tp != task)
+        tp = &(*tp)->set_next;
+    *tp = task->set_next;
+    av_free(task);
+    pthread_cond_broadcast(&set->done_cond);
+}
+
+/* Own tasks first, then the ones woken from outside, and finally the oldest
+ * task of another worker */
+static struct task *pop_task(struct worker *w)
+{
+    struct task *task = pop_front(&w->local);
+    if (!task)
+        task = pop_front(&injector);
+    const int id = w - workers;
+    for (int i = 1; !task && i < nb_workers; i++)
+        task = pop_back(&workers[(id + i) % nb_workers].local);
+    return task;
+}
+
+static void *worker_thread(void *arg)
+{
+    struct worker *w = arg;
+
+    sxpi_set_thread_name("sxp/worker");
+
+    pthread_mutex_lock(&pool_lock);
+    for (;;) {
+        struct task *task = pop_task(w);
+        if (!task) {
+            if (quit)
+                break;
+            pthread_cond_wait(&pool_cond, &pool_lock);
+            continue;
+        }
+        task->state = TASK_RUNNING;
+        task->woken = 0;
+        pthread_mutex_unlock(&pool_lock);
+
+        int ret = 0, progress = 0;
+        for (int i = 0; i < MAX_TASK_STEPS; i++) {
+            ret = task->func(task->arg);
+            if (ret <= 0)
+                break;
+            progress = 1;
+        }
+
+        pthread_mutex_lock(&pool_lock);
+
+        /* The other tasks of the set may be waiting on what this one
+         * produced, consumed, or on its end */
+        if (progress || ret < 0)
+            wake_set(task->set, task, w);
+
+        if (ret < 0) {
+            remove_task(task);
+        } else if (ret > 0 || task->woken) {
+            task->state = TASK_QUEUED;
+            push_back(ret > 0 ? &injector : &w->local, task);
+        } else {
+            task->state = TASK_IDLE;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    return NULL;
+}
+
+static int start_pool(void)
+{
+    const int nb = FFMAX(av_cpu_count(), 1);
+    int ret = 0;
+
+    workers = av_calloc(nb, sizeof(*workers));
+    if (!workers)
+        return AVERROR(ENOMEM);
+
+    /* The workers wait for the lock until they are all started */
+    pthread_mutex_lock(&pool_lock);
+    quit = 0;
+    while (nb_workers < nb) {
+        struct worker *w = &workers[nb_workers];
+        ret = pthread_create(&w->tid, NULL, worker_thread, w);
+        if (ret)
+            break;
+        nb_workers++;
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    if (!nb_workers) {
+        av_freep(&workers);
+        return AVERROR(ret);
+    }
+    return 0;
+}
+
+static void stop_pool(void)
+{
+    pthread_mutex_lock(&pool_lock);
+    quit = 1;
+    pthread_cond_broadcast(&pool_cond);
+    pthread_mutex_unlock(&pool_lock);
+
+    for (int i = 0; i < nb_workers; i++)
+        pthread_join(workers[i].tid, NULL);
+    nb_workers = 0;
+    av_freep(&workers);
+}
+
+struct worker_set *sxpi_worker_pool_create_set(void)
+{
+    struct worker_set *set = av_mallocz(sizeof(*set));
+    if (!set)
+        return NULL;
+    if (pthread_cond_init(&set->done_cond, NULL)) {
+        av_free(set);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&users_lock);
+    const int ret = nb_users ? 0 : start_pool();
+    if (ret >= 0)
+        nb_users++;
+    pthread_mutex_unlock(&users_lock);
+
+    if (ret < 0) {
+        pthread_cond_destroy(&set->done_cond);
+        av_free(set);
+        return NULL;
+    }
+    return set;
+}
+
+int sxpi_worker_pool_add_task(struct worker_set *set, worker_task_func func, void *arg)
+{
+    struct task *task = av_mallocz(sizeof(*task));
+    if (!task)
+        return AVERROR(ENOMEM);
+    task->func = func;
+    task->arg = arg;
+    task->set = set;
+
+    pthread_mutex_lock(&pool_lock);
+    task->set_next = set->tasks;
+    set->tasks = task;
+    schedule_task(task, NULL);
+    pthread_mutex_unlock(&pool_lock);
+    return 0;
+}
+
+void sxpi_worker_pool_wake(struct worker_set *set)
+{
+    pthread_mutex_lock(&pool_lock);
+    wake_set(set, NULL, NULL);
+    pthread_mutex_unlock(&pool_lock);
+}
+
+void sxpi_worker_pool_wait(struct worker_set *set)
+{
+    pthread_mutex_lock(&pool_lock);
+    while (set->tasks)
+        pthread_cond_wait(&set->done_cond, &pool_lock);
+    pthread_mutex_unlock(&pool_lock);
+}
+
+void sxpi_worker_pool_free_set(struct worker_set **setp)
+{
+    struct worker_set *set = *setp;
+    if (!set)
+        return;
+
+    sxpi_worker_pool_wait(set);
+    pthread_cond_destroy(&set->done_cond);
+    av_freep(setp);
+
+    pthread_mutex_lock(&users_lock);
+    if (!--nb_users)
+        stop_pool();
+    pthread_mutex_unlock(&users_lock);
+}
@@ -0,0 +1,52 @@
+/*
+ * This file is part of sxplayer.
+ *
+ * Copyright (c) 2016 Stupeflix
+ *
+ * sxplayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * sxplayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with sxplayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+/*
+ * A task is a step function which must never wait: it returns a positive
+ * value when it made some progress, 0 when it can not go further until
+ * another task of its set (or an external event) makes progress, and a
+ * negative value when it is done.
+ */
+typedef int (*worker_task_func)(void *arg);
+
+/*
+ * Create a set of tasks woken together, run by the workers of the
+ * process-wide pool. The pool (one worker per CPU) is started with the first
+ * set and stopped with the last one.
+ */
+struct worker_set *sxpi_worker_pool_create_set(void);
+
+/* Schedule a new task in the set, it runs until its function returns a
+ * negative value */
+int sxpi_worker_pool_add_task(struct worker_set *set, worker_task_func func, void *arg);
+
+/* Schedule again the waiting tasks of the set, to be called after any
+ * external event they may be waiting for */
+void sxpi_worker_pool_wake(struct worker_set *set);
+
+/* Wait for all the tasks of the set to be done */
+void sxpi_worker_pool_wait(struct worker_set *set);
+
+void sxpi_worker_pool_free_set(struct worker_set **setp);
+
+#endif
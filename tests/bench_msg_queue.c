@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libavutil/threadmessage.h>
+#include <libavutil/time.h>
+
+#include "msg_queue.h"
+#include "pthread_compat.h"
+
+#define NB_MESSAGES_THROUGHPUT 1000000
+#define NB_MESSAGES_LATENCY    100000
+#define QUEUE_SIZE             5
+
+/* Same operations on both queue implementations */
+struct queue_ops {
+    const char *name;
+    int (*alloc)(void **q, int nb_elems);
+    int (*send)(void *q, struct message *msg);
+    int (*recv)(void *q, struct message *msg);
+    void (*free)(void **q);
+};
+
+static int av_alloc(void **q, int nb_elems)
+{
+    int ret = av_thread_message_queue_alloc((AVThreadMessageQueue **)q, nb_elems, sizeof(struct message));
+    if (ret < 0)
+        return ret;
+    av_thread_message_queue_set_free_func(*q, sxpi_msg_free_data);
+    return 0;
+}
+
+static int av_send(void *q, struct message *msg) { return av_thread_message_queue_send(q, msg, 0); }
+static int av_recv(void *q, struct message *msg) { return av_thread_message_queue_recv(q, msg, 0); }
+static void av_free_queue(void **q) { av_thread_message_queue_free((AVThreadMessageQueue **)q); }
+
+static int sx_alloc(void **q, int nb_elems) { return sxpi_msg_queue_alloc((struct msg_queue **)q, nb_elems); }
+static int sx_send(void *q, struct message *msg) { return sxpi_msg_queue_send(q, msg, 0); }
+static int sx_recv(void *q, struct message *msg) { return sxpi_msg_queue_recv(q, msg, 0); }
+static void sx_free_queue(void **q) { sxpi_msg_queue_free((struct msg_queue **)q); }
+
+static const struct queue_ops queues[] = {
+    {"AVThreadMessageQueue", av_alloc, av_send, av_recv, av_free_queue},
+    {"msg_queue",            sx_alloc, sx_send, sx_recv, sx_free_queue},
+};
+
+struct bench {
+    const struct queue_ops *ops;
+    void *in;
+    void *out;
+    int nb_messages;
+};
+
+static void *produce(void *arg)
+{
+    struct bench *b = arg;
+    for (int i = 0; i < b->nb_messages; i++) {
+        struct message msg = {.type = MSG_SYNC};
+        if (b->ops->send(b->in, &msg) < 0)
+            break;
+    }
+    return NULL;
+}
+
+static void *echo(void *arg)
+{
+    struct bench *b = arg;
+    for (int i = 0; i < b->nb_messages; i++) {
+        struct message msg;
+        if (b->ops->recv(b->in, &msg) < 0 || b->ops->send(b->out, &msg) < 0)
+            break;
+    }
+    return NULL;
+}
+
+/* Messages per second streamed from one thread to another */
+static int bench_throughput(const struct queue_ops *ops, double *rate)
+{
+    struct bench b = {.ops = ops, .nb_messages = NB_MESSAGES_THROUGHPUT};
+    int ret = ops->alloc(&b.in, QUEUE_SIZE);
+    if (ret < 0)
+        return ret;
+
+    pthread_t tid;
+    const int64_t t0 = av_gettime_relative();
+    if (pthread_create(&tid, NULL, produce, &b)) {
+        ops->free(&b.in);
+        return -1;
+    }
+    for (int i = 0; i < b.nb_messages; i++) {
+        struct message msg;
+        if ((ret = ops->recv(b.in, &msg)) < 0)
+            break;
+    }
+    const int64_t t1 = av_gettime_relative();
+    pthread_join(tid, NULL);
+    ops->free(&b.in);
+
+    *rate = b.nb_messages / ((t1 - t0) / 1000000.);
+    return ret;
+}
+
+/* Average time for a message to go from one thread to another, measured with
+ * round trips */
+static int bench_latency(const struct queue_ops *ops, double *latency)
+{
+    struct bench b = {.ops = ops, .nb_messages = NB_MESSAGES_LATENCY};
+    int ret;
+    if ((ret = ops->alloc(&b.in, 1)) < 0)
+        return ret;
+    if ((ret = ops->alloc(&b.out, 1)) < 0) {
+        ops->free(&b.in);
+        return ret;
+    }
+
+    pthread_t tid;
+    const int64_t t0 = av_gettime_relative();
+    if (pthread_create(&tid, NULL, echo, &b)) {
+        ops->free(&b.in);
+        ops->free(&b.out);
+        return -1;
+    }
+    for (int i = 0; i < b.nb_messages; i++) {
+        struct message msg = {.type = MSG_SYNC};
+        if ((ret = ops->send(b.in, &msg)) < 0 ||
+            (ret = ops->recv(b.out, &msg)) < 0)
+            break;
+    }
+    const int64_t t1 = av_gettime_relative();
+    pthread_join(tid, NULL);
+    ops->free(&b.in);
+    ops->free(&b.out);
+
+    *latency = (t1 - t0) * 1000. / (2 * b.nb_messages);
+    return ret;
+}
+
+int main(int ac, char **av)
+{
+    for (int i = 0; i < sizeof(queues) / sizeof(*queues); i++) {
+        const struct queue_ops *ops = &queues[i];
+        double rate, latency;
+        if (bench_throughput(ops, &rate) < 0 || bench_latency(ops, &latency) < 0) {
+            fprintf(stderr, "%s: benchmark failed\n", ops->name);
+            return -1;
+        }
+        printf("%-24s %12.0f msg/s %10.0f ns/msg\n", ops->name, rate, latency);
+    }
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libavformat/avformat.h>
+
+#define NB_FRAMES 100
+#define FRAME_RATE 25 // same as the test media
+
+/* Make an intra-only clip out of a JPEG image by muxing it as every frame of
+ * a MJPEG stream */
+int main(int ac, char **av)
+{
+    if (ac != 3) {
+        fprintf(stderr, "Usage: %s <image.jpg> <intra.mkv>\n", av[0]);
+        return -1;
+    }
+
+    const AVRational frame_tb = av_make_q(1, FRAME_RATE);
+    AVFormatContext *ifmt = NULL, *ofmt = NULL;
+    AVPacket *pkt = av_packet_alloc();
+    AVPacket *out_pkt = av_packet_alloc();
+    int ret = AVERROR(ENOMEM);
+
+    if (!pkt || !out_pkt)
+        goto end;
+
+    if ((ret = avformat_open_input(&ifmt, av[1], NULL, NULL)) < 0 ||
+        (ret = avformat_find_stream_info(ifmt, NULL)) < 0 ||
+        (ret = av_read_frame(ifmt, pkt)) < 0)
+        goto end;
+
+    if ((ret = avformat_alloc_output_context2(&ofmt, NULL, NULL, av[2])) < 0)
+        goto end;
+    AVStream *st = avformat_new_stream(ofmt, NULL);
+    if (!st) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    if ((ret = avcodec_parameters_copy(st->codecpar, ifmt->streams[pkt->stream_index]->codecpar)) < 0)
+        goto end;
+    st->codecpar->codec_tag = 0;
+    st->time_base = frame_tb;
+    st->avg_frame_rate = av_inv_q(frame_tb);
+
+    if ((ret = avio_open(&ofmt->pb, av[2], AVIO_FLAG_WRITE)) < 0 ||
+        (ret = avformat_write_header(ofmt, NULL)) < 0)
+        goto end;
+
+    for (int i = 0; i < NB_FRAMES; i++) {
+        if ((ret = av_packet_ref(out_pkt, pkt)) < 0)
+            goto end;
+        out_pkt->stream_index = st->index;
+        out_pkt->pts = out_pkt->dts = i;
+        out_pkt->duration = 1;
+        out_pkt->flags |= AV_PKT_FLAG_KEY;
+        out_pkt->pos = -1;
+        av_packet_rescale_ts(out_pkt, frame_tb, st->time_base);
+        if ((ret = av_interleaved_write_frame(ofmt, out_pkt)) < 0)
+            goto end;
+    }
+
+    ret = av_write_trailer(ofmt);
+
+end:
+    if (ret < 0)
+        fprintf(stderr, "Unable to make %s out of %s: %s\n", av[2], av[1], av_err2str(ret));
+    avformat_close_input(&ifmt);
+    if (ofmt) {
+        avio_closep(&ofmt->pb);
+        avformat_free_context(ofmt);
+    }
+    av_packet_free(&out_pkt);
+    av_packet_free(&pkt);
+    return ret < 0 ? -1 : 0;
+}
@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include <sxplayer.h>
+
+#include "test_utils.h"
+
+int main(int ac, char **av)
+{
+    if (ac < 2) {
+        fprintf(stderr, "Usage: %s <media.mkv> [<use_pkt_duration>]\n", av[0]);
+        return -1;
+    }
+
+    const char *filename = av[1];
+    const int use_pkt_duration = ac > 2 ? atoi(av[2]) : 0;
+    int ret = -1;
+
+    struct sxplayer_ctx *s = create_context(filename, use_pkt_duration);
+    if (!s)
+        return -1;
+    sxplayer_set_option(s, "adaptive_seek_trigger", 1);
+
+    if (check_seek(s, 0.0) < 0)
+        goto end;
+
+    /* Short jumps decoded forward, and long ones, in several passes so the
+     * keyframes are indexed and the costs measured */
+    int nb_forward = 0;
+    for (int pass = 0; pass < 3; pass++) {
+        double t = pass * 0.3;
+        if (pass && check_seek(s, t) < 0)
+            goto end;
+        while (t < 140.0) {
+            t += nb_forward % 8 == 7 ? 13.3 : 0.7;
+            if (check_seek(s, t) < 0)
+                goto end;
+            nb_forward++;
+        }
+    }
+
+    struct sxplayer_stats stats;
+    if (sxplayer_get_stats(s, &stats) < 0)
+        goto end;
+    printf("forward seeks:%"PRId64" decodes:%"PRId64" decode speed:%f seek overhead:%f\n",
+           stats.nb_forward_seeks, stats.nb_forward_decodes, stats.decode_speed, stats.seek_overhead);
+
+    if (stats.nb_forward_seeks + stats.nb_forward_decodes != nb_forward) {
+        fprintf(stderr, "%"PRId64" forward decisions for %d forward requests\n",
+                stats.nb_forward_seeks + stats.nb_forward_decodes, nb_forward);
+        goto end;
+    }
+    if (stats.decode_speed <= 0) {
+        fprintf(stderr, "decoding speed not measured\n");
+        goto end;
+    }
+
+    ret = 0;
+
+end:
+    sxplayer_free(&s);
+    return ret;
+}
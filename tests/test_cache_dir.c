@@ -0,0 +1,141 @@
+#define _XOPEN_SOURCE 700 // mkdtemp
+
+#include <dirent.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sxplayer.h>
+
+#define NB_RUNS 3
+
+static int open_media(const char *filename, int use_pkt_duration, const char *cache_dir,
+                      struct sxplayer_info *info, double *ts, struct sxplayer_stats *stats)
+{
+    int ret = 0;
+    struct sxplayer_ctx *s = sxplayer_create(filename);
+    if (!s)
+        return -1;
+
+    sxplayer_set_option(s, "auto_hwaccel", 0);
+    sxplayer_set_option(s, "use_pkt_duration", use_pkt_duration);
+    sxplayer_set_option(s, "cache_dir", cache_dir);
+
+    if (sxplayer_get_info(s, info) < 0) {
+        fprintf(stderr, "unable to get media info\n");
+        ret = -1;
+        goto end;
+    }
+
+    struct sxplayer_frame *frame = sxplayer_get_frame(s, 3.0);
+    if (!frame) {
+        fprintf(stderr, "unable to get a frame\n");
+        ret = -1;
+        goto end;
+    }
+    *ts = frame->ts;
+    sxplayer_release_frame(frame);
+
+    if (sxplayer_get_stats(s, stats) < 0) {
+        fprintf(stderr, "unable to get stats\n");
+        ret = -1;
+    }
+
+end:
+    sxplayer_free(&s);
+    return ret;
+}
+
+/* Count the cache files of the directory, removing them if asked to */
+static int count_cache_files(const char *dir, int remove_files)
+{
+    DIR *d = opendir(dir);
+    if (!d)
+        return -1;
+
+    int nb = 0;
+    struct dirent *entry;
+    while ((entry = readdir(d))) {
+        const char *name = entry->d_name;
+        if (!strcmp(name, ".") || !strcmp(name, ".."))
+            continue;
+        const size_t len = strlen(name);
+        if (!strncmp(name, "sxplayer-", 9) && len > 6 && !strcmp(name + len - 6, ".cache"))
+            nb++;
+        if (remove_files) {
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/%s", dir, name);
+            remove(path);
+        }
+    }
+    closedir(d);
+    return nb;
+}
+
+int main(int ac, char **av)
+{
+    if (ac < 2) {
+        fprintf(stderr, "Usage: %s <media.mkv> [<use_pkt_duration>]\n", av[0]);
+        return -1;
+    }
+
+    const char *filename = av[1];
+    const int use_pkt_duration = ac > 2 ? atoi(av[2]) : 0;
+    int ret = -1;
+
+    char cache_dir[] = "/tmp/sxplayer-test-XXXXXX";
+    if (!mkdtemp(cache_dir)) {
+        fprintf(stderr, "unable to create a temporary cache directory\n");
+        return -1;
+    }
+
+    struct sxplayer_info info[NB_RUNS];
+    struct sxplayer_stats stats[NB_RUNS];
+    double ts[NB_RUNS];
+
+    /* The first run probes the media and writes the cache, the following
+     * ones are served from it */
+    for (int i = 0; i < NB_RUNS; i++) {
+        if (open_media(filename, use_pkt_duration, cache_dir, &info[i], &ts[i], &stats[i]) < 0)
+            goto end;
+        printf("run #%d: %dx%d duration:%f tb:%d/%d frame@%f cache hits:%"PRId64"\n", i,
+               info[i].width, info[i].height, info[i].duration,
+               info[i].timebase[0], info[i].timebase[1], ts[i], stats[i].media_cache_hits);
+
+        const int nb_files = count_cache_files(cache_dir, 0);
+        if (nb_files != 1) {
+            fprintf(stderr, "run #%d: %d cache files instead of 1\n", i, nb_files);
+            goto end;
+        }
+        if (i == 0 && stats[i].media_cache_hits) {
+            fprintf(stderr, "run #%d: cache hit with an empty cache directory\n", i);
+            goto end;
+        }
+        if (i > 0 && !stats[i].media_cache_hits) {
+            fprintf(stderr, "run #%d: the cache was not used\n", i);
+            goto end;
+        }
+    }
+
+    for (int i = 1; i < NB_RUNS; i++) {
+        if (info[i].width       != info[0].width       ||
+            info[i].height      != info[0].height      ||
+            info[i].duration    != info[0].duration    ||
+            info[i].is_image    != info[0].is_image    ||
+            info[i].timebase[0] != info[0].timebase[0] ||
+            info[i].timebase[1] != info[0].timebase[1] ||
+            ts[i]               != ts[0]) {
+            fprintf(stderr, "run #%d differs from the first one\n", i);
+            goto end;
+        }
+    }
+
+    ret = 0;
+
+end:
+    count_cache_files(cache_dir, 1);
+    rmdir(cache_dir);
+    return ret;
+}
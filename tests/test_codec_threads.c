@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sxplayer.h>
+
+#include "test_utils.h"
+
+#define NB_FRAMES 4096
+#define NB_CONTEXTS 4
+
+static struct sxplayer_ctx *create_threads_context(const char *filename, int use_pkt_duration, int codec_threads)
+{
+    struct sxplayer_ctx *s = create_context(filename, use_pkt_duration);
+    if (s)
+        sxplayer_set_option(s, "codec_threads", codec_threads);
+    return s;
+}
+
+int main(int ac, char **av)
+{
+    if (ac < 2) {
+        fprintf(stderr, "Usage: %s <media.mkv> [<use_pkt_duration>]\n", av[0]);
+        return -1;
+    }
+
+    const char *filename = av[1];
+    const int use_pkt_duration = ac > 2 ? atoi(av[2]) : 0;
+
+    static double ref_ts[NB_FRAMES];
+    struct sxplayer_ctx *ref = NULL;
+    struct sxplayer_ctx *ctxs[NB_CONTEXTS] = {NULL};
+    int nb_frames[NB_CONTEXTS] = {0};
+    int ret = -1;
+
+    /* Reference timestamps, decoded with the decoder own threads */
+    ref = create_threads_context(filename, use_pkt_duration, 0);
+    if (!ref)
+        goto end;
+    const int n = read_frames(ref, ref_ts, NB_FRAMES);
+    if (n != NB_FRAMES) {
+        fprintf(stderr, "reference decoded %d/%d expected frames\n", n, NB_FRAMES);
+        goto end;
+    }
+
+    /* The contexts share a codec pool capped at a different value each */
+    for (int i = 0; i < NB_CONTEXTS; i++) {
+        ctxs[i] = create_threads_context(filename, use_pkt_duration, i + 1);
+        if (!ctxs[i])
+            goto end;
+    }
+
+    for (int nb_alive = NB_CONTEXTS; nb_alive;) {
+        for (int i = 0; i < NB_CONTEXTS; i++) {
+            if (nb_frames[i] < 0)
+                continue;
+            struct sxplayer_frame *frame = sxplayer_get_next_frame(ctxs[i]);
+            if (!frame) {
+                if (nb_frames[i] != NB_FRAMES) {
+                    fprintf(stderr, "context %d decoded %d/%d expected frames\n", i, nb_frames[i], NB_FRAMES);
+                    goto end;
+                }
+                nb_frames[i] = -1;
+                nb_alive--;
+                continue;
+            }
+            const double ts = frame->ts;
+            sxplayer_release_frame(frame);
+            if (nb_frames[i] >= NB_FRAMES || ts != ref_ts[nb_frames[i]]) {
+                fprintf(stderr, "context %d, frame #%d: unexpected ts %f\n", i, nb_frames[i], ts);
+                goto end;
+            }
+            nb_frames[i]++;
+        }
+    }
+
+    ret = 0;
+
+end:
+    sxplayer_free(&ref);
+    for (int i = 0; i < NB_CONTEXTS; i++)
+        sxplayer_free(&ctxs[i]);
+    return ret;
+}
@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <sxplayer.h>
+
+#include "test_utils.h"
+
+#define MAX_REQUESTS 10000
+#define TIMEOUT 1000
+
+/* Request the time with a short timeout until the exact frame is obtained */
+static int converge(struct sxplayer_ctx *s, double t, double *last_ts)
+{
+    for (int i = 0; i < MAX_REQUESTS; i++) {
+        int status;
+        struct sxplayer_frame *frame = sxplayer_get_frame_deadline(s, t, TIMEOUT, &status);
+        if (frame) {
+            if (frame->ts > t) {
+                fprintf(stderr, "t=%f: got future frame %f\n", t, frame->ts);
+                sxplayer_release_frame(frame);
+                return -1;
+            }
+            *last_ts = frame->ts;
+            sxplayer_release_frame(frame);
+        } else if (status == SXPLAYER_DEADLINE_PARTIAL) {
+            fprintf(stderr, "t=%f: partial status without a frame\n", t);
+            return -1;
+        }
+        if (status == SXPLAYER_DEADLINE_EXACT) {
+            printf("t=%f: exact frame %f after %d request(s)\n", t, *last_ts, i + 1);
+            return 0;
+        }
+    }
+    fprintf(stderr, "t=%f: no exact frame after %d requests\n", t, MAX_REQUESTS);
+    return -1;
+}
+
+int main(int ac, char **av)
+{
+    if (ac < 2) {
+        fprintf(stderr, "Usage: %s <media.mkv> [<use_pkt_duration>]\n", av[0]);
+        return -1;
+    }
+
+    const char *filename = av[1];
+    const int use_pkt_duration = ac > 2 ? atoi(av[2]) : 0;
+
+    struct sxplayer_ctx *s = create_context(filename, use_pkt_duration);
+    if (!s)
+        return -1;
+
+    static const double times[] = {0.0, 0.5, 0.52, 60.0, 12.0, 12.04, 100.0, 3.0};
+
+    int ret = 0;
+    double last_ts = -1;
+    for (int i = 0; i < sizeof(times) / sizeof(*times); i++) {
+        const double t = times[i];
+        if (converge(s, t, &last_ts) < 0) {
+            ret = -1;
+            break;
+        }
+        if (fabs(last_ts - expected_ts(t)) > 1e-6) {
+            fprintf(stderr, "t=%f: got frame %f instead of %f\n", t, last_ts, expected_ts(t));
+            ret = -1;
+            break;
+        }
+    }
+
+    sxplayer_free(&s);
+    return ret;
+}
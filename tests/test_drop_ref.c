@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sxplayer.h>
+
+#define NB_FRAMES 4096
+#define SWITCH_FRAME 100
+
+/* Decode the whole media, switching to the drop mode after a few frames */
+static int decode_media(const char *filename, int use_pkt_duration, int drop,
+                        double *ts, int *nb_keyframes, double **keyframes)
+{
+    int n = 0;
+    struct sxplayer_ctx *s = sxplayer_create(filename);
+    if (!s)
+        return -1;
+
+    sxplayer_set_option(s, "auto_hwaccel", 0);
+    sxplayer_set_option(s, "use_pkt_duration", use_pkt_duration);
+
+    for (;;) {
+        if (n == SWITCH_FRAME && sxplayer_set_drop_ref(s, drop) < 0) {
+            fprintf(stderr, "unable to set drop mode %d\n", drop);
+            n = -1;
+            break;
+        }
+        struct sxplayer_frame *frame = sxplayer_get_next_frame(s);
+        if (!frame)
+            break;
+        if (n < NB_FRAMES)
+            ts[n] = frame->ts;
+        n++;
+        sxplayer_release_frame(frame);
+    }
+
+    if (n >= 0 && keyframes) {
+        *nb_keyframes = sxplayer_get_keyframes(s, NULL, 0);
+        *keyframes = calloc(*nb_keyframes, sizeof(**keyframes));
+        if (*nb_keyframes < 0 || !*keyframes)
+            n = -1;
+        else
+            sxplayer_get_keyframes(s, *keyframes, *nb_keyframes);
+    }
+
+    sxplayer_free(&s);
+    return n;
+}
+
+static int is_keyframe(double ts, const double *keyframes, int nb_keyframes)
+{
+    for (int i = 0; i < nb_keyframes; i++)
+        if (keyframes[i] == ts)
+            return 1;
+    return 0;
+}
+
+int main(int ac, char **av)
+{
+    if (ac < 2) {
+        fprintf(stderr, "Usage: %s <media.mkv> [<use_pkt_duration>]\n", av[0]);
+        return -1;
+    }
+
+    const char *filename = av[1];
+    const int use_pkt_duration = ac > 2 ? atoi(av[2]) : 0;
+    static double ref_ts[NB_FRAMES], ts[NB_FRAMES];
+    double *keyframes = NULL;
+    int nb_keyframes = 0, ret = 0;
+
+    struct sxplayer_ctx *s = sxplayer_create(filename);
+    if (!s)
+        return -1;
+    if (sxplayer_set_drop_ref(s, NB_SXPLAYER_DROP_REF) >= 0) {
+        fprintf(stderr, "invalid drop mode accepted\n");
+        ret = -1;
+    }
+    sxplayer_free(&s);
+
+    const int nb_ref = decode_media(filename, use_pkt_duration, SXPLAYER_DROP_NONE, ref_ts, NULL, NULL);
+    const int nb_nonkey = decode_media(filename, use_pkt_duration, SXPLAYER_DROP_NONKEY, ts, &nb_keyframes, &keyframes);
+    printf("%d frames decoded, %d with keyframes only after frame #%d\n",
+           nb_ref, nb_nonkey, SWITCH_FRAME);
+    if (nb_ref != NB_FRAMES || nb_nonkey <= SWITCH_FRAME || nb_nonkey > nb_ref) {
+        fprintf(stderr, "unexpected number of frames\n");
+        ret = -1;
+        goto end;
+    }
+
+    /* The switch happens without restarting the decoding: the frames before
+     * it are unchanged, and only keyframes are decoded some time after */
+    for (int i = 0; i < SWITCH_FRAME; i++) {
+        if (ts[i] != ref_ts[i]) {
+            fprintf(stderr, "frame #%d: %f != %f\n", i, ts[i], ref_ts[i]);
+            ret = -1;
+            goto end;
+        }
+    }
+    if (!is_keyframe(ts[nb_nonkey - 1], keyframes, nb_keyframes)) {
+        fprintf(stderr, "frame %f is not a keyframe\n", ts[nb_nonkey - 1]);
+        ret = -1;
+    }
+
+end:
+    free(keyframes);
+    return ret;
+}
@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <poll.h>
+
+#include <sxplayer.h>
+
+#define NB_FRAMES 4096
+#define POLL_TIMEOUT 10000
+
+int main(int ac, char **av)
+{
+    if (ac < 2) {
+        fprintf(stderr, "Usage: %s <media.mkv> [<use_pkt_duration>]\n", av[0]);
+        return -1;
+    }
+
+    const char *filename = av[1];
+    const int use_pkt_duration = ac > 2 ? atoi(av[2]) : 0;
+
+    int i = 0, ret = 0;
+    struct sxplayer_ctx *s = sxplayer_create(filename);
+    if (!s)
+        return -1;
+
+    sxplayer_set_option(s, "auto_hwaccel", 0);
+    sxplayer_set_option(s, "use_pkt_duration", use_pkt_duration);
+
+    const int fd = sxplayer_get_event_fd(s);
+    if (fd < 0) {
+        fprintf(stderr, "unable to get the event fd\n");
+        sxplayer_free(&s);
+        return -1;
+    }
+
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+    if (poll(&pfd, 1, 100) != 0) {
+        fprintf(stderr, "event fd readable before the playback started\n");
+        ret = -1;
+    }
+
+    sxplayer_start(s);
+
+    for (;;) {
+        const int n = poll(&pfd, 1, POLL_TIMEOUT);
+        if (n <= 0) {
+            fprintf(stderr, "event fd not readable after %dms (frame #%d)\n", POLL_TIMEOUT, i);
+            ret = -1;
+            break;
+        }
+
+        struct sxplayer_frame *frame = sxplayer_get_next_frame(s);
+        if (!frame) {
+            printf("null frame\n");
+            break;
+        }
+        i++;
+        sxplayer_release_frame(frame);
+    }
+
+    sxplayer_free(&s);
+
+    if (i != NB_FRAMES) {
+        fprintf(stderr, "decoded %d/%d expected frames\n", i, NB_FRAMES);
+        ret = -1;
+    }
+
+    return ret;
+}
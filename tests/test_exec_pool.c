@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sxplayer.h>
+
+#include "test_utils.h"
+
+#define NB_FRAMES 4096
+#define NB_CONTEXTS 8
+
+/* Read all the contexts in turn, so they all compete for the workers */
+static int read_interleaved(struct sxplayer_ctx **ctxs)
+{
+    int nb_frames[NB_CONTEXTS] = {0};
+    double last_ts[NB_CONTEXTS];
+    int nb_alive = NB_CONTEXTS;
+
+    for (int i = 0; i < NB_CONTEXTS; i++)
+        last_ts[i] = -1;
+
+    while (nb_alive) {
+        for (int i = 0; i < NB_CONTEXTS; i++) {
+            if (nb_frames[i] < 0)
+                continue;
+            struct sxplayer_frame *frame = sxplayer_get_next_frame(ctxs[i]);
+            if (!frame) {
+                if (nb_frames[i] != NB_FRAMES) {
+                    fprintf(stderr, "context %d decoded %d/%d expected frames\n", i, nb_frames[i], NB_FRAMES);
+                    return -1;
+                }
+                nb_frames[i] = -1;
+                nb_alive--;
+                continue;
+            }
+            const double ts = frame->ts;
+            sxplayer_release_frame(frame);
+            if (ts <= last_ts[i]) {
+                fprintf(stderr, "context %d: frame ts %f after %f\n", i, ts, last_ts[i]);
+                return -1;
+            }
+            last_ts[i] = ts;
+            nb_frames[i]++;
+        }
+    }
+    return 0;
+}
+
+static int check_seeks(struct sxplayer_ctx **ctxs)
+{
+    static const double times[] = {60.0, 10.0, 10.5, 150.0, 0.0};
+
+    for (int j = 0; j < sizeof(times) / sizeof(*times); j++) {
+        for (int i = 0; i < NB_CONTEXTS; i++) {
+            const double t = times[(i + j) % (sizeof(times) / sizeof(*times))];
+            if (check_seek(ctxs[i], t) < 0) {
+                fprintf(stderr, "context %d failed to seek\n", i);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int ac, char **av)
+{
+    if (ac < 2) {
+        fprintf(stderr, "Usage: %s <media.mkv> [<use_pkt_duration>]\n", av[0]);
+        return -1;
+    }
+
+    const char *filename = av[1];
+    const int use_pkt_duration = ac > 2 ? atoi(av[2]) : 0;
+
+    struct sxplayer_ctx *ctxs[NB_CONTEXTS] = {NULL};
+    int ret = -1;
+
+    for (int i = 0; i < NB_CONTEXTS; i++) {
+        ctxs[i] = create_context(filename, use_pkt_duration);
+        if (!ctxs[i])
+            goto end;
+        sxplayer_set_option(ctxs[i], "exec_mode", SXPLAYER_EXEC_POOL);
+    }
+
+    if (read_interleaved(ctxs) < 0 || check_seeks(ctxs) < 0)
+        goto end;
+
+    /* Stopping some contexts must not disturb the others */
+    for (int i = 0; i < NB_CONTEXTS; i += 2)
+        sxplayer_stop(ctxs[i]);
+    if (check_seeks(ctxs) < 0)
+        goto end;
+
+    ret = 0;
+
+end:
+    for (int i = 0; i < NB_CONTEXTS; i++)
+        sxplayer_free(&ctxs[i]);
+    return ret;
+}
@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include <sxplayer.h>
+
+#define NB_STEPS 40
+#define STEP (1/25.)
+
+/* Scrub forward then backward over the same range, return the frames ts */
+static int scrub(const char *filename, int use_pkt_duration, int frame_cache_size,
+                 double *ts, struct sxplayer_stats *stats)
+{
+    int ret = 0;
+    struct sxplayer_ctx *s = sxplayer_create(filename);
+    if (!s)
+        return -1;
+
+    sxplayer_set_option(s, "auto_hwaccel", 0);
+    sxplayer_set_option(s, "use_pkt_duration", use_pkt_duration);
+    sxplayer_set_option(s, "frame_cache_size", frame_cache_size);
+
+    for (int i = 0; i < 2 * NB_STEPS; i++) {
+        const int step = i < NB_STEPS ? i : 2 * NB_STEPS - 1 - i;
+        const double t = 2.0 + step * STEP;
+        struct sxplayer_frame *frame = sxplayer_get_frame(s, t);
+        ts[i] = frame ? frame->ts : -1;
+        sxplayer_release_frame(frame);
+    }
+
+    if (sxplayer_get_stats(s, stats) < 0) {
+        fprintf(stderr, "unable to get stats\n");
+        ret = -1;
+    }
+
+    sxplayer_free(&s);
+    return ret;
+}
+
+int main(int ac, char **av)
+{
+    if (ac < 2) {
+        fprintf(stderr, "Usage: %s <media.mkv> [<use_pkt_duration>]\n", av[0]);
+        return -1;
+    }
+
+    const char *filename = av[1];
+    const int use_pkt_duration = ac > 2 ? atoi(av[2]) : 0;
+    double ref_ts[2 * NB_STEPS], ts[2 * NB_STEPS];
+    struct sxplayer_stats ref_stats, stats;
+
+    if (scrub(filename, use_pkt_duration, 0,  ref_ts, &ref_stats) < 0 ||
+        scrub(filename, use_pkt_duration, 64, ts,     &stats) < 0)
+        return -1;
+
+    for (int i = 0; i < 2 * NB_STEPS; i++) {
+        if (ts[i] != ref_ts[i]) {
+            fprintf(stderr, "request #%d: got frame %f instead of %f\n", i, ts[i], ref_ts[i]);
+            return -1;
+        }
+    }
+
+    printf("frame cache: %"PRId64" hits, %"PRId64" misses, %d frames, %"PRId64" bytes\n",
+           stats.frame_cache_hits, stats.frame_cache_misses,
+           stats.frame_cache_nb_frames, stats.frame_cache_size);
+
+    if (ref_stats.frame_cache_hits || ref_stats.frame_cache_nb_frames) {
+        fprintf(stderr, "frame cache used while disabled\n");
+        return -1;
+    }
+
+    if (stats.frame_cache_hits < NB_STEPS - 1) {
+        fprintf(stderr, "backward requests were not served by the frame cache\n");
+        return -1;
+    }
+
+    return 0;
+}
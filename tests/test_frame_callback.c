@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include <sxplayer.h>
+
+#define NB_FRAMES 4096
+
+enum {
+    MODE_ACCEPT,
+    MODE_REFUSE,
+    MODE_DEFER,
+    NB_MODES
+};
+
+struct state {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int mode;
+    int nb_calls;
+    int nb_accepted;
+    int nb_deferred;
+    int64_t deferred_pts;
+    int need_resume;
+    int eos;
+};
+
+static int frame_cb(void *arg, struct sxplayer_frame *frame)
+{
+    struct state *st = arg;
+    int ret = SXPLAYER_FRAME_ACCEPTED;
+
+    pthread_mutex_lock(&st->lock);
+    if (!frame) {
+        st->eos = 1;
+    } else if (st->mode == MODE_REFUSE && st->nb_calls++ & 1) {
+        ret = SXPLAYER_FRAME_REFUSED;
+    } else if (st->mode == MODE_DEFER && frame->pts != st->deferred_pts) {
+        st->deferred_pts = frame->pts;
+        st->nb_deferred++;
+        st->need_resume = 1;
+        ret = SXPLAYER_FRAME_DEFERRED;
+    } else {
+        st->nb_accepted++;
+        sxplayer_release_frame(frame);
+    }
+    pthread_cond_signal(&st->cond);
+    pthread_mutex_unlock(&st->lock);
+    return ret;
+}
+
+int main(int ac, char **av)
+{
+    if (ac < 2) {
+        fprintf(stderr, "Usage: %s <media.mkv> [<use_pkt_duration>]\n", av[0]);
+        return -1;
+    }
+
+    const char *filename = av[1];
+    const int use_pkt_duration = ac > 2 ? atoi(av[2]) : 0;
+
+    int ret = 0;
+    struct sxplayer_ctx *s = sxplayer_create(filename);
+    if (!s)
+        return -1;
+
+    struct state st = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .cond = PTHREAD_COND_INITIALIZER,
+    };
+
+    sxplayer_set_option(s, "auto_hwaccel", 0);
+    sxplayer_set_option(s, "use_pkt_duration", use_pkt_duration);
+    sxplayer_set_frame_callback(s, &st, frame_cb);
+
+    for (int mode = 0; mode < NB_MODES; mode++) {
+        pthread_mutex_lock(&st.lock);
+        st.mode = mode;
+        st.nb_calls = st.nb_accepted = st.nb_deferred = 0;
+        st.deferred_pts = -1;
+        st.eos = 0;
+        pthread_mutex_unlock(&st.lock);
+
+        if (sxplayer_start(s) < 0) {
+            fprintf(stderr, "unable to start the playback\n");
+            ret = -1;
+            break;
+        }
+
+        pthread_mutex_lock(&st.lock);
+        while (!st.eos) {
+            if (st.need_resume) {
+                st.need_resume = 0;
+                pthread_mutex_unlock(&st.lock);
+                sxplayer_resume_frames(s);
+                pthread_mutex_lock(&st.lock);
+            } else {
+                pthread_cond_wait(&st.cond, &st.lock);
+            }
+        }
+        const int nb_accepted = st.nb_accepted;
+        const int nb_deferred = st.nb_deferred;
+        pthread_mutex_unlock(&st.lock);
+
+        const int expected = mode == MODE_REFUSE ? NB_FRAMES / 2 : NB_FRAMES;
+        printf("mode %d: %d accepted frames, %d deferred\n", mode, nb_accepted, nb_deferred);
+        if (nb_accepted != expected) {
+            fprintf(stderr, "mode %d: accepted %d/%d expected frames\n", mode, nb_accepted, expected);
+            ret = -1;
+        }
+        if (mode == MODE_DEFER && nb_deferred != NB_FRAMES) {
+            fprintf(stderr, "deferred %d/%d expected frames\n", nb_deferred, NB_FRAMES);
+            ret = -1;
+        }
+    }
+
+    if (sxplayer_get_next_frame(s)) {
+        fprintf(stderr, "frames should not be pulled in push mode\n");
+        ret = -1;
+    }
+
+    sxplayer_free(&s);
+    return ret;
+}
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <libavutil/motion_vector.h>
+#include <sxplayer.h>
+
+#define NB_KEPT 8
+
+static uint32_t mvs_checksum(const struct sxplayer_frame *frame)
+{
+    uint32_t sum = 0;
+    const uint8_t *p = frame->mvs;
+    for (size_t i = 0; i < frame->nb_mvs * sizeof(AVMotionVector); i++)
+        sum = sum * 31 + p[i];
+    return sum;
+}
+
+int main(int ac, char **av)
+{
+    if (ac < 2) {
+        fprintf(stderr, "Usage: %s <media.mkv> [<use_pkt_duration>]\n", av[0]);
+        return -1;
+    }
+
+    const char *filename = av[1];
+    const int use_pkt_duration = ac > 2 ? atoi(av[2]) : 0;
+
+    int ret = 0, nb_mvs = 0;
+    struct sxplayer_frame *kept[NB_KEPT] = {0};
+    uint32_t kept_checksums[NB_KEPT] = {0};
+    struct sxplayer_ctx *s = sxplayer_create(filename);
+    if (!s)
+        return -1;
+
+    sxplayer_set_option(s, "auto_hwaccel", 0);
+    sxplayer_set_option(s, "export_mvs", 1);
+    sxplayer_set_option(s, "use_pkt_duration", use_pkt_duration);
+
+    /* Cycle through the pool while holding a few frames */
+    for (int i = 0; i < 200; i++) {
+        struct sxplayer_frame *frame = sxplayer_get_next_frame(s);
+        if (!frame) {
+            fprintf(stderr, "unexpected end of stream at frame #%d\n", i);
+            ret = -1;
+            break;
+        }
+        nb_mvs += frame->nb_mvs;
+        if (i % 25 == 0 && i / 25 < NB_KEPT) {
+            kept[i / 25] = frame;
+            kept_checksums[i / 25] = mvs_checksum(frame);
+        } else {
+            sxplayer_release_frame(frame);
+        }
+    }
+
+    printf("%d motion vectors exported\n", nb_mvs);
+
+    /* The frames must remain valid after the context is destroyed */
+    sxplayer_free(&s);
+
+    for (int i = 0; i < NB_KEPT; i++) {
+        struct sxplayer_frame *frame = kept[i];
+        if (!frame)
+            continue;
+        const double expected_ts = i;
+        if (frame->ts != expected_ts) {
+            fprintf(stderr, "kept frame #%d has ts %f instead of %f\n", i, frame->ts, expected_ts);
+            ret = -1;
+        }
+        if (mvs_checksum(frame) != kept_checksums[i]) {
+            fprintf(stderr, "kept frame #%d motion vectors changed\n", i);
+            ret = -1;
+        }
+        memset(frame->datap[0], 0, frame->linesizep[0]);
+        sxplayer_release_frame(frame);
+    }
+
+    return ret;
+}
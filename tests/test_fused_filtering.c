@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sxplayer.h>
+
+#include "test_utils.h"
+
+#define NB_FRAMES 4096
+
+static struct sxplayer_ctx *create_fused_context(const char *filename, int use_pkt_duration, int fused)
+{
+    struct sxplayer_ctx *s = create_context(filename, use_pkt_duration);
+    if (s)
+        sxplayer_set_option(s, "fused_filtering", fused);
+    return s;
+}
+
+static int check_seeks(struct sxplayer_ctx *s)
+{
+    static const double times[] = {60.0, 10.0, 10.5, 150.0, 0.0};
+
+    for (int i = 0; i < sizeof(times) / sizeof(*times); i++)
+        if (check_seek(s, times[i]) < 0)
+            return -1;
+    return 0;
+}
+
+int main(int ac, char **av)
+{
+    if (ac < 2) {
+        fprintf(stderr, "Usage: %s <media.mkv> [<use_pkt_duration>]\n", av[0]);
+        return -1;
+    }
+
+    const char *filename = av[1];
+    const int use_pkt_duration = ac > 2 ? atoi(av[2]) : 0;
+
+    static double ref_ts[NB_FRAMES];
+    static double ts[NB_FRAMES];
+    struct sxplayer_ctx *ref = NULL;
+    struct sxplayer_ctx *s = NULL;
+    int ret = -1;
+
+    ref = create_fused_context(filename, use_pkt_duration, 0);
+    s = create_fused_context(filename, use_pkt_duration, 1);
+    if (!ref || !s)
+        goto end;
+
+    int n = read_frames(ref, ref_ts, NB_FRAMES);
+    if (n != NB_FRAMES) {
+        fprintf(stderr, "reference decoded %d/%d expected frames\n", n, NB_FRAMES);
+        goto end;
+    }
+
+    n = read_frames(s, ts, NB_FRAMES);
+    if (n != NB_FRAMES) {
+        fprintf(stderr, "fused context decoded %d/%d expected frames\n", n, NB_FRAMES);
+        goto end;
+    }
+    for (int i = 0; i < NB_FRAMES; i++) {
+        if (ts[i] != ref_ts[i]) {
+            fprintf(stderr, "frame #%d: got ts %f instead of %f\n", i, ts[i], ref_ts[i]);
+            goto end;
+        }
+    }
+
+    if (check_seeks(s) < 0)
+        goto end;
+
+    ret = 0;
+
+end:
+    sxplayer_free(&ref);
+    sxplayer_free(&s);
+    return ret;
+}
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include <sxplayer.h>
+
+#include "test_utils.h"
+
+#define NB_FRAMES 100 // frames in the intra-only clip
+#define NB_DECODERS 4
+#define NB_PARTIAL_READ 7
+#define MAX_ALLOCS (NB_FRAMES / 4)
+
+/* Read the frames from the n-th one up to the end, which must all be there,
+ * once and in order, whatever decoder they went through */
+static int check_sequence(struct sxplayer_ctx *s, int n)
+{
+    for (;;) {
+        struct sxplayer_frame *frame = sxplayer_get_next_frame(s);
+        if (!frame)
+            break;
+        const double t = (double)n / FRAME_RATE;
+        if (check_frame(frame, t, t) < 0)
+            return -1;
+        n++;
+    }
+    if (n != NB_FRAMES) {
+        fprintf(stderr, "stream ended at frame %d/%d\n", n, NB_FRAMES);
+        return -1;
+    }
+    return 0;
+}
+
+/* Interrupt the decoding while frames are in flight in the decoders */
+static int read_partially(struct sxplayer_ctx *s)
+{
+    for (int i = 0; i < NB_PARTIAL_READ; i++) {
+        struct sxplayer_frame *frame = sxplayer_get_next_frame(s);
+        if (!frame) {
+            fprintf(stderr, "stream ended after %d frames\n", i);
+            return -1;
+        }
+        sxplayer_release_frame(frame);
+    }
+    return 0;
+}
+
+static int run(struct sxplayer_ctx *s)
+{
+    /* Whole stream */
+    if (check_sequence(s, 0) < 0)
+        return -1;
+
+    /* Exact seek in the middle of the stream */
+    if (check_seek(s, 2.03) < 0 || check_sequence(s, 51) < 0)
+        return -1;
+
+    /* Stop and seeks while the decoders are busy: none of the frames they
+     * were working on may come out after the flush */
+    if (read_partially(s) < 0 || sxplayer_stop(s) < 0 ||
+        check_seek(s, 1.51) < 0 || check_sequence(s, 38) < 0)
+        return -1;
+    if (sxplayer_seek(s, 0.5) < 0 || read_partially(s) < 0 ||
+        sxplayer_seek(s, 3.1) < 0 || check_sequence(s, 77) < 0)
+        return -1;
+
+    return sxplayer_stop(s);
+}
+
+int main(int ac, char **av)
+{
+    if (ac < 2) {
+        fprintf(stderr, "Usage: %s <intra.mkv> [<use_pkt_duration>]\n", av[0]);
+        return -1;
+    }
+
+    const char *filename = av[1];
+    const int use_pkt_duration = ac > 2 ? atoi(av[2]) : 0;
+    struct sxplayer_stats stats0, stats1;
+    int ret = -1;
+
+    struct sxplayer_ctx *s = create_context(filename, use_pkt_duration);
+    if (!s)
+        return -1;
+    sxplayer_set_option(s, "intra_decoders", NB_DECODERS);
+
+    if (run(s) < 0 || sxplayer_get_stats(s, &stats0) < 0)
+        goto end;
+
+    /* The packets and frames flushed from the decoders by the stops and
+     * seeks of the first run must have been given back to the pool */
+    if (run(s) < 0 || sxplayer_get_stats(s, &stats1) < 0)
+        goto end;
+    const int64_t nb_allocs = stats1.msg_pool_allocs - stats0.msg_pool_allocs;
+    printf("message pool: %"PRId64" allocations in the second run\n", nb_allocs);
+    if (nb_allocs > MAX_ALLOCS) {
+        fprintf(stderr, "the flushed packets and frames are leaking\n");
+        goto end;
+    }
+
+    ret = 0;
+
+end:
+    sxplayer_free(&s);
+    return ret;
+}
@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sxplayer.h>
+
+#include "test_utils.h"
+
+#define NB_FRAMES 100 // frames in the intra-only clip
+#define LAST_TS ((NB_FRAMES - 1) / (double)FRAME_RATE)
+
+/* Seek forward, backward and to the last frame, whose packet is only pushed
+ * to the decoder once the demuxer reaches the end of the stream */
+static const double times[] = {
+    0.5, 1.02, 2.7, 3.3, 1.5, 0.22, 2.98, 0.0, LAST_TS + 0.01, 1.9,
+};
+
+int main(int ac, char **av)
+{
+    if (ac < 2) {
+        fprintf(stderr, "Usage: %s <intra.mkv> [<use_pkt_duration>]\n", av[0]);
+        return -1;
+    }
+
+    const char *filename = av[1];
+    const int use_pkt_duration = ac > 2 ? atoi(av[2]) : 0;
+    int ret = -1;
+
+    /* Straight to the last frame from a fresh context */
+    struct sxplayer_ctx *s = create_context(filename, use_pkt_duration);
+    if (!s || check_seek(s, LAST_TS) < 0)
+        goto end;
+    sxplayer_free(&s);
+
+    s = create_context(filename, use_pkt_duration);
+    if (!s)
+        goto end;
+    for (int i = 0; i < sizeof(times) / sizeof(*times); i++)
+        if (check_seek(s, times[i]) < 0)
+            goto end;
+
+    /* The frames skipped to reach the last seek must not show up afterwards */
+    const double last_t = times[sizeof(times) / sizeof(*times) - 1];
+    const int expected = NB_FRAMES - 1 - (int)lrint(expected_ts(last_t) * FRAME_RATE);
+    const int n = read_frames(s, NULL, 0);
+    if (n != expected) {
+        fprintf(stderr, "read %d frames after the last seek instead of %d\n", n, expected);
+        goto end;
+    }
+
+    ret = 0;
+
+end:
+    sxplayer_free(&s);
+    return ret;
+}
@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sxplayer.h>
+
+int main(int ac, char **av)
+{
+    if (ac < 2) {
+        fprintf(stderr, "Usage: %s <media.mkv> [<use_pkt_duration>]\n", av[0]);
+        return -1;
+    }
+
+    const char *filename = av[1];
+    const int use_pkt_duration = ac > 2 ? atoi(av[2]) : 0;
+
+    int ret = 0;
+    double *timestamps = NULL;
+    struct sxplayer_ctx *s = sxplayer_create(filename);
+    if (!s)
+        return -1;
+
+    sxplayer_set_option(s, "auto_hwaccel", 0);
+    sxplayer_set_option(s, "use_pkt_duration", use_pkt_duration);
+
+    if (sxplayer_get_keyframes(s, NULL, 0) != 0) {
+        fprintf(stderr, "keyframe index is not empty before demuxing\n");
+        ret = -1;
+        goto end;
+    }
+
+    for (;;) {
+        struct sxplayer_frame *frame = sxplayer_get_next_frame(s);
+        if (!frame)
+            break;
+        sxplayer_release_frame(frame);
+    }
+
+    const int nb_keyframes = sxplayer_get_keyframes(s, NULL, 0);
+    printf("%d keyframes indexed\n", nb_keyframes);
+    if (nb_keyframes <= 0) {
+        fprintf(stderr, "no keyframe indexed after a full demux\n");
+        ret = -1;
+        goto end;
+    }
+
+    timestamps = calloc(nb_keyframes, sizeof(*timestamps));
+    if (!timestamps) {
+        ret = -1;
+        goto end;
+    }
+
+    if (sxplayer_get_keyframes(s, timestamps, nb_keyframes) != nb_keyframes) {
+        fprintf(stderr, "keyframe index changed while the media was not read\n");
+        ret = -1;
+        goto end;
+    }
+
+    for (int i = 1; i < nb_keyframes; i++) {
+        if (timestamps[i] <= timestamps[i - 1]) {
+            fprintf(stderr, "keyframe #%d (%f) is not after keyframe #%d (%f)\n",
+                    i, timestamps[i], i - 1, timestamps[i - 1]);
+            ret = -1;
+            goto end;
+        }
+    }
+
+    /* Seeks landing in the indexed region must still be frame accurate */
+    for (int i = nb_keyframes - 1; i >= 0; i -= 3) {
+        const double t = timestamps[i];
+        struct sxplayer_frame *frame = sxplayer_get_frame(s, t);
+        if (!frame) {
+            fprintf(stderr, "got no frame at keyframe time %f\n", t);
+            ret = -1;
+            goto end;
+        }
+        if (frame->ts != t) {
+            fprintf(stderr, "requested keyframe at %f, got frame at %f\n", t, frame->ts);
+            ret = -1;
+        }
+        sxplayer_release_frame(frame);
+        if (ret < 0)
+            goto end;
+    }
+
+end:
+    free(timestamps);
+    sxplayer_free(&s);
+    return ret;
+}
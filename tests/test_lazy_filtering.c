@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sxplayer.h>
+
+#include "test_utils.h"
+
+#define NB_REQUESTS 200
+
+static struct sxplayer_ctx *create_lazy_context(const char *filename, int use_pkt_duration, int lazy)
+{
+    struct sxplayer_ctx *s = create_context(filename, use_pkt_duration);
+    if (!s)
+        return NULL;
+    sxplayer_set_option(s, "max_pixels", 320 * 240);
+    sxplayer_set_option(s, "lazy_filtering", lazy);
+    return s;
+}
+
+int main(int ac, char **av)
+{
+    if (ac < 2) {
+        fprintf(stderr, "Usage: %s <media.mkv> [<use_pkt_duration>]\n", av[0]);
+        return -1;
+    }
+
+    const char *filename = av[1];
+    const int use_pkt_duration = ac > 2 ? atoi(av[2]) : 0;
+    int ret = -1;
+
+    struct sxplayer_ctx *ref = create_lazy_context(filename, use_pkt_duration, 0);
+    struct sxplayer_ctx *s = create_lazy_context(filename, use_pkt_duration, 1);
+    if (!ref || !s)
+        goto end;
+
+    /* Requests skipping frames, with a few seeks in both directions */
+    for (int i = 0; i < NB_REQUESTS; i++) {
+        const double t = i == NB_REQUESTS / 2 ? 10.0 : i * 0.13 + (i > NB_REQUESTS / 2 ? 20.0 : 0.0);
+        struct sxplayer_frame *ref_frame = sxplayer_get_frame(ref, t);
+        struct sxplayer_frame *frame = sxplayer_get_frame(s, t);
+        const int diff = cmp_frames(ref_frame, frame);
+        if (diff)
+            fprintf(stderr, "t=%f: frames differ (%f vs %f)\n", t,
+                    ref_frame ? ref_frame->ts : -1., frame ? frame->ts : -1.);
+        sxplayer_release_frame(ref_frame);
+        sxplayer_release_frame(frame);
+        if (diff)
+            goto end;
+    }
+
+    /* Every frame goes through the filters when none is skipped */
+    for (int i = 0; i < NB_REQUESTS; i++) {
+        struct sxplayer_frame *ref_frame = sxplayer_get_next_frame(ref);
+        struct sxplayer_frame *frame = sxplayer_get_next_frame(s);
+        const int diff = cmp_frames(ref_frame, frame);
+        if (diff)
+            fprintf(stderr, "next frame #%d: frames differ\n", i);
+        sxplayer_release_frame(ref_frame);
+        sxplayer_release_frame(frame);
+        if (diff)
+            goto end;
+    }
+
+    ret = 0;
+
+end:
+    sxplayer_free(&ref);
+    sxplayer_free(&s);
+    return ret;
+}
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <sxplayer.h>
+
+#include "test_utils.h"
+
+#define NB_FRAMES 4096
+#define NB_SAMPLES 7938000
+
+static struct sxplayer_ctx *create_audio(struct sxplayer_ctx *s, int use_pkt_duration)
+{
+    struct sxplayer_ctx *a = sxplayer_create_linked(s, SXPLAYER_SELECT_AUDIO);
+    if (!a)
+        return NULL;
+    sxplayer_set_option(a, "use_pkt_duration", use_pkt_duration);
+    sxplayer_set_option(a, "audio_texture", 0);
+    return a;
+}
+
+/* Read both streams entirely from a single thread, the audio following the
+ * video */
+static int read_streams(struct sxplayer_ctx *v, struct sxplayer_ctx *a)
+{
+    int nb_frames = 0, nb_samples = 0;
+    int video_eos = 0, audio_eos = 0;
+    double video_ts = -1, audio_ts = -1;
+
+    while (!video_eos || !audio_eos) {
+        if (!video_eos) {
+            struct sxplayer_frame *frame = sxplayer_get_next_frame(v);
+            if (!frame) {
+                video_eos = 1;
+            } else {
+                video_ts = frame->ts;
+                nb_frames++;
+                sxplayer_release_frame(frame);
+            }
+        }
+        while (!audio_eos && (video_eos || audio_ts < video_ts)) {
+            struct sxplayer_frame *frame = sxplayer_get_next_frame(a);
+            if (!frame) {
+                audio_eos = 1;
+            } else {
+                audio_ts = frame->ts;
+                nb_samples += frame->nb_samples;
+                sxplayer_release_frame(frame);
+            }
+        }
+    }
+
+    printf("read %d video frames and %d audio samples\n", nb_frames, nb_samples);
+    if (nb_frames != NB_FRAMES || nb_samples != NB_SAMPLES) {
+        fprintf(stderr, "expected %d video frames and %d audio samples\n", NB_FRAMES, NB_SAMPLES);
+        return -1;
+    }
+    return 0;
+}
+
+static int check_frames(struct sxplayer_ctx *v, struct sxplayer_ctx *a, double t)
+{
+    struct sxplayer_frame *vframe = sxplayer_get_frame(v, t);
+    struct sxplayer_frame *aframe = sxplayer_get_frame(a, t);
+    int ret = 0;
+
+    if (!vframe || !aframe) {
+        fprintf(stderr, "t=%f: missing frame (video:%p audio:%p)\n", t, vframe, aframe);
+        ret = -1;
+    } else {
+        printf("t=%f: video frame %f, audio frame %f\n", t, vframe->ts, aframe->ts);
+        if (fabs(vframe->ts - expected_ts(t)) > 1e-6) {
+            fprintf(stderr, "t=%f: got video frame %f instead of %f\n", t, vframe->ts, expected_ts(t));
+            ret = -1;
+        }
+        if (aframe->ts > t || aframe->ts < t - 0.1) {
+            fprintf(stderr, "t=%f: got unexpected audio frame %f\n", t, aframe->ts);
+            ret = -1;
+        }
+    }
+
+    sxplayer_release_frame(vframe);
+    sxplayer_release_frame(aframe);
+    return ret;
+}
+
+int main(int ac, char **av)
+{
+    if (ac < 2) {
+        fprintf(stderr, "Usage: %s <media.mkv> [<use_pkt_duration>]\n", av[0]);
+        return -1;
+    }
+
+    const char *filename = av[1];
+    const int use_pkt_duration = ac > 2 ? atoi(av[2]) : 0;
+
+    int ret = 0;
+    struct sxplayer_ctx *v = create_context(filename, use_pkt_duration);
+    struct sxplayer_ctx *a = v ? create_audio(v, use_pkt_duration) : NULL;
+    if (!v || !a) {
+        ret = -1;
+        goto end;
+    }
+
+    if (read_streams(v, a) < 0) {
+        ret = -1;
+        goto end;
+    }
+
+    static const double times[] = {10.0, 3.0, 3.5, 120.0, 0.0};
+    for (int i = 0; i < sizeof(times) / sizeof(*times); i++) {
+        if (check_frames(v, a, times[i]) < 0) {
+            ret = -1;
+            goto end;
+        }
+    }
+
+    /* The seeks requested back to back by both contexts are all honored */
+    for (int i = 0; i < sizeof(times) / sizeof(*times); i++) {
+        if (sxplayer_seek(v, times[i]) < 0 || sxplayer_seek(a, times[i]) < 0 ||
+            check_frames(v, a, times[i]) < 0) {
+            ret = -1;
+            goto end;
+        }
+    }
+
+    if (sxplayer_create_linked(v, SXPLAYER_SELECT_AUDIO)) {
+        fprintf(stderr, "context should not be linked once configured\n");
+        ret = -1;
+        goto end;
+    }
+
+    /* The linked context must survive the context it shares the input with */
+    sxplayer_free(&a);
+    sxplayer_free(&v);
+    v = create_context(filename, use_pkt_duration);
+    a = v ? create_audio(v, use_pkt_duration) : NULL;
+    if (!v || !a || check_frames(v, a, 1.0) < 0) {
+        ret = -1;
+        goto end;
+    }
+    sxplayer_free(&v);
+    struct sxplayer_frame *frame = sxplayer_get_frame(a, 2.0);
+    if (!frame) {
+        fprintf(stderr, "detached context did not return any frame\n");
+        ret = -1;
+    }
+    sxplayer_release_frame(frame);
+
+end:
+    sxplayer_free(&a);
+    sxplayer_free(&v);
+    return ret;
+}
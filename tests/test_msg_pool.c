@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include <sxplayer.h>
+
+#include "test_utils.h"
+
+#define NB_FRAMES 4096
+#define NB_SEEKS 10
+#define MAX_ALLOCS (NB_FRAMES / 8)
+
+/* Seek around, then play the whole media and stop */
+static int run(struct sxplayer_ctx *s)
+{
+    for (int i = 0; i < NB_SEEKS; i++)
+        if (check_seek(s, fmod(i * 37.21, 160.0)) < 0)
+            return -1;
+
+    if (sxplayer_seek(s, 0.0) < 0)
+        return -1;
+    const int n = read_frames(s, NULL, 0);
+    if (n != NB_FRAMES) {
+        fprintf(stderr, "decoded %d/%d expected frames\n", n, NB_FRAMES);
+        return -1;
+    }
+
+    return sxplayer_stop(s);
+}
+
+int main(int ac, char **av)
+{
+    if (ac < 2) {
+        fprintf(stderr, "Usage: %s <media.mkv> [<use_pkt_duration>]\n", av[0]);
+        return -1;
+    }
+
+    const char *filename = av[1];
+    const int use_pkt_duration = ac > 2 ? atoi(av[2]) : 0;
+    struct sxplayer_stats stats0, stats1;
+    int ret = -1;
+
+    struct sxplayer_ctx *s = create_context(filename, use_pkt_duration);
+    if (!s)
+        return -1;
+
+    /* The first run fills the pools */
+    if (run(s) < 0 || sxplayer_get_stats(s, &stats0) < 0)
+        goto end;
+    printf("message pool: %"PRId64" allocations, %"PRId64" reuses\n",
+           stats0.msg_pool_allocs, stats0.msg_pool_reuses);
+
+    /* The same run again must be served by the packets and frames given back
+     * to the pools by the first one, including the ones flushed by the seeks
+     * and the stop */
+    if (run(s) < 0 || sxplayer_get_stats(s, &stats1) < 0)
+        goto end;
+    const int64_t nb_allocs = stats1.msg_pool_allocs - stats0.msg_pool_allocs;
+    const int64_t nb_reuses = stats1.msg_pool_reuses - stats0.msg_pool_reuses;
+    printf("message pool: %"PRId64" allocations, %"PRId64" reuses\n", nb_allocs, nb_reuses);
+    if (nb_reuses < NB_FRAMES) {
+        fprintf(stderr, "the packets and frames were not recycled\n");
+        goto end;
+    }
+    if (nb_allocs > MAX_ALLOCS) {
+        fprintf(stderr, "the packets and frames are not given back to the pools\n");
+        goto end;
+    }
+
+    ret = 0;
+
+end:
+    sxplayer_free(&s);
+    return ret;
+}
@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sxplayer.h>
+
+#define NB_STEPS 100
+#define STEP (1/25.)
+
+/* Play the media backward from 5s, return the frames ts */
+static int play_backward(const char *filename, int use_pkt_duration, int direction,
+                         double *ts, struct sxplayer_stats *stats)
+{
+    int ret = 0;
+    struct sxplayer_ctx *s = sxplayer_create(filename);
+    if (!s)
+        return -1;
+
+    sxplayer_set_option(s, "auto_hwaccel", 0);
+    sxplayer_set_option(s, "use_pkt_duration", use_pkt_duration);
+    sxplayer_set_option(s, "direction", direction);
+
+    for (int i = 0; i < NB_STEPS; i++) {
+        const double t = 5.0 - i * STEP;
+        struct sxplayer_frame *frame = sxplayer_get_frame(s, t);
+        ts[i] = frame ? frame->ts : -1;
+        sxplayer_release_frame(frame);
+    }
+
+    if (sxplayer_get_stats(s, stats) < 0) {
+        fprintf(stderr, "unable to get stats\n");
+        ret = -1;
+    }
+
+    sxplayer_free(&s);
+    return ret;
+}
+
+int main(int ac, char **av)
+{
+    if (ac < 2) {
+        fprintf(stderr, "Usage: %s <media.mkv> [<use_pkt_duration>]\n", av[0]);
+        return -1;
+    }
+
+    const char *filename = av[1];
+    const int use_pkt_duration = ac > 2 ? atoi(av[2]) : 0;
+    double ref_ts[NB_STEPS], ts[NB_STEPS];
+    struct sxplayer_stats ref_stats, stats;
+
+    if (play_backward(filename, use_pkt_duration, SXPLAYER_DIRECTION_FORWARD,  ref_ts, &ref_stats) < 0 ||
+        play_backward(filename, use_pkt_duration, SXPLAYER_DIRECTION_BACKWARD, ts,     &stats) < 0)
+        return -1;
+
+    for (int i = 0; i < NB_STEPS; i++) {
+        if (ts[i] != ref_ts[i]) {
+            fprintf(stderr, "request #%d: got frame %f instead of %f\n", i, ts[i], ref_ts[i]);
+            return -1;
+        }
+    }
+
+    printf("frame cache: %d hits, %d misses\n",
+           (int)stats.frame_cache_hits, (int)stats.frame_cache_misses);
+
+    /* Every GOP must be decoded only once */
+    if (stats.frame_cache_misses >= stats.frame_cache_hits) {
+        fprintf(stderr, "backward requests were not served by the frame cache\n");
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <sxplayer.h>
+
+#include "test_utils.h"
+
+#define NB_SEEKS 50
+
+/* Check the next frame is the one displayed at t */
+static int check_next_frame(struct sxplayer_ctx *s, double t)
+{
+    return check_frame(sxplayer_get_next_frame(s), t, expected_ts(t));
+}
+
+int main(int ac, char **av)
+{
+    if (ac < 2) {
+        fprintf(stderr, "Usage: %s <media.mkv> [<use_pkt_duration>]\n", av[0]);
+        return -1;
+    }
+
+    const char *filename = av[1];
+    const int use_pkt_duration = ac > 2 ? atoi(av[2]) : 0;
+    int ret = -1;
+
+    struct sxplayer_ctx *s = create_context(filename, use_pkt_duration);
+    if (!s)
+        return -1;
+
+    if (check_next_frame(s, 0.0) < 0)
+        goto end;
+
+    /* Scrub back and forth: only the latest position must come out */
+    for (int burst = 0; burst < 4; burst++) {
+        double t = 0.0;
+        for (int i = 0; i < NB_SEEKS; i++) {
+            t = fmod((burst * NB_SEEKS + i) * 37.21, 160.0) + 0.01;
+            if (sxplayer_seek(s, t) < 0) {
+                fprintf(stderr, "seek to %f failed\n", t);
+                goto end;
+            }
+        }
+        if (check_next_frame(s, t) < 0)
+            goto end;
+
+        /* The playback goes on from there */
+        if (check_next_frame(s, t + 1.0 / FRAME_RATE) < 0)
+            goto end;
+    }
+
+    ret = 0;
+
+end:
+    sxplayer_free(&s);
+    return ret;
+}
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sxplayer.h>
+
+#include "test_utils.h"
+
+/* Check the frame obtained at t is the keyframe at expected */
+static int check_keyframe(struct sxplayer_ctx *s, double t, double expected)
+{
+    return check_frame(sxplayer_get_frame(s, t), t, expected);
+}
+
+int main(int ac, char **av)
+{
+    if (ac < 2) {
+        fprintf(stderr, "Usage: %s <media.mkv> [<use_pkt_duration>]\n", av[0]);
+        return -1;
+    }
+
+    const char *filename = av[1];
+    const int use_pkt_duration = ac > 2 ? atoi(av[2]) : 0;
+    int ret = -1;
+    double *timestamps = NULL;
+
+    struct sxplayer_ctx *s = create_context(filename, use_pkt_duration);
+    if (!s)
+        return -1;
+    sxplayer_set_option(s, "seek_precision", SXPLAYER_SEEK_KEYFRAME);
+
+    /* Index all the keyframes */
+    for (;;) {
+        struct sxplayer_frame *frame = sxplayer_get_next_frame(s);
+        if (!frame)
+            break;
+        sxplayer_release_frame(frame);
+    }
+
+    const int nb_keyframes = sxplayer_get_keyframes(s, NULL, 0);
+    if (nb_keyframes < 2) {
+        fprintf(stderr, "not enough keyframes indexed (%d)\n", nb_keyframes);
+        goto end;
+    }
+    timestamps = calloc(nb_keyframes, sizeof(*timestamps));
+    if (!timestamps || sxplayer_get_keyframes(s, timestamps, nb_keyframes) != nb_keyframes)
+        goto end;
+
+    /* Every request moves backward, so each of them seeks */
+    for (int i = nb_keyframes - 2; i >= 0; i--) {
+        const double t = (timestamps[i] + timestamps[i + 1]) / 2.;
+        if (check_keyframe(s, t, timestamps[i]) < 0)
+            goto end;
+    }
+
+    /* The same seeks are frame accurate again */
+    if (sxplayer_set_seek_precision(s, SXPLAYER_SEEK_EXACT) < 0)
+        goto end;
+    for (int i = nb_keyframes - 2; i >= 0; i--) {
+        const double t = (timestamps[i] + timestamps[i + 1]) / 2.;
+        if (check_seek(s, t) < 0)
+            goto end;
+    }
+
+    /* An explicit seek honors the precision the same way */
+    if (sxplayer_set_seek_precision(s, SXPLAYER_SEEK_KEYFRAME) < 0)
+        goto end;
+    const double t = (timestamps[0] + timestamps[1]) / 2.;
+    if (sxplayer_seek(s, t) < 0 || check_keyframe(s, t, timestamps[0]) < 0)
+        goto end;
+
+    if (sxplayer_set_seek_precision(s, NB_SXPLAYER_SEEK) >= 0) {
+        fprintf(stderr, "invalid seek precision accepted\n");
+        goto end;
+    }
+
+    ret = 0;
+
+end:
+    free(timestamps);
+    sxplayer_free(&s);
+    return ret;
+}
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sxplayer.h>
+
+#include "test_utils.h"
+
+#define NB_TARGETS 5
+
+int main(int ac, char **av)
+{
+    if (ac < 2) {
+        fprintf(stderr, "Usage: %s <media.mkv> [<use_pkt_duration>]\n", av[0]);
+        return -1;
+    }
+
+    const char *filename = av[1];
+    const int use_pkt_duration = ac > 2 ? atoi(av[2]) : 0;
+
+    /* Frames in the middle of their GOP, requested from the last one so every
+     * request seeks and skips the non reference frames preceding its target */
+    static const int targets[NB_TARGETS] = {3990, 2517, 1003, 517, 11};
+    struct sxplayer_frame *ref_frames[NB_TARGETS] = {NULL};
+    int ret = -1;
+
+    struct sxplayer_ctx *ref = create_context(filename, use_pkt_duration);
+    struct sxplayer_ctx *s = create_context(filename, use_pkt_duration);
+    if (!ref || !s)
+        goto end;
+    sxplayer_set_option(ref, "max_pixels", 320 * 240);
+    sxplayer_set_option(s, "max_pixels", 320 * 240);
+
+    /* The reference frames are obtained by decoding every frame */
+    for (int n = 0, i = NB_TARGETS - 1; i >= 0; n++) {
+        struct sxplayer_frame *frame = sxplayer_get_next_frame(ref);
+        if (!frame) {
+            fprintf(stderr, "reference ended at frame #%d\n", n);
+            goto end;
+        }
+        if (n == targets[i])
+            ref_frames[i--] = frame;
+        else
+            sxplayer_release_frame(frame);
+    }
+
+    for (int i = 0; i < NB_TARGETS; i++) {
+        const double t = (targets[i] + 0.5) / FRAME_RATE;
+        struct sxplayer_frame *frame = sxplayer_get_frame(s, t);
+        const int diff = cmp_frames(ref_frames[i], frame);
+        if (diff)
+            fprintf(stderr, "t=%f: got frame %f instead of %f\n", t,
+                    frame ? frame->ts : -1., ref_frames[i]->ts);
+        sxplayer_release_frame(frame);
+        if (diff)
+            goto end;
+    }
+
+    ret = 0;
+
+end:
+    for (int i = 0; i < NB_TARGETS; i++)
+        sxplayer_release_frame(ref_frames[i]);
+    sxplayer_free(&ref);
+    sxplayer_free(&s);
+    return ret;
+}
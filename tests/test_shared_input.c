@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include <sxplayer.h>
+
+#include "test_utils.h"
+
+#define NB_FRAMES 4096
+
+static struct sxplayer_ctx *create_shared_context(const char *filename, int use_pkt_duration)
+{
+    struct sxplayer_ctx *s = create_context(filename, use_pkt_duration);
+    if (s)
+        sxplayer_set_option(s, "packet_cache_size", 64);
+    return s;
+}
+
+int main(int ac, char **av)
+{
+    if (ac < 2) {
+        fprintf(stderr, "Usage: %s <media.mkv> [<use_pkt_duration>]\n", av[0]);
+        return -1;
+    }
+
+    const char *filename = av[1];
+    const int use_pkt_duration = ac > 2 ? atoi(av[2]) : 0;
+
+    static double ts0[NB_FRAMES], ts1[NB_FRAMES];
+    struct sxplayer_stats stats0, stats1;
+    int ret = -1;
+
+    struct sxplayer_ctx *s0 = create_shared_context(filename, use_pkt_duration);
+    struct sxplayer_ctx *s1 = create_shared_context(filename, use_pkt_duration);
+    if (!s0 || !s1)
+        goto end;
+
+    /* The first context reads the media from the input */
+    int n = read_frames(s0, ts0, NB_FRAMES);
+    if (n != NB_FRAMES) {
+        fprintf(stderr, "context 0 decoded %d/%d expected frames\n", n, NB_FRAMES);
+        goto end;
+    }
+    sxplayer_get_stats(s0, &stats0);
+    printf("packet cache: %"PRId64" hits, %"PRId64" misses, %"PRId64" bytes\n",
+           stats0.packet_cache_hits, stats0.packet_cache_misses, stats0.packet_cache_size);
+    if (!stats0.packet_cache_misses) {
+        fprintf(stderr, "the packets were not read from the input\n");
+        goto end;
+    }
+
+    /* The second one must be fully served from memory */
+    n = read_frames(s1, ts1, NB_FRAMES);
+    if (n != NB_FRAMES) {
+        fprintf(stderr, "context 1 decoded %d/%d expected frames\n", n, NB_FRAMES);
+        goto end;
+    }
+    for (int i = 0; i < NB_FRAMES; i++) {
+        if (ts0[i] != ts1[i]) {
+            fprintf(stderr, "frame #%d: got ts %f instead of %f\n", i, ts1[i], ts0[i]);
+            goto end;
+        }
+    }
+    sxplayer_get_stats(s1, &stats1);
+    printf("packet cache: %"PRId64" hits, %"PRId64" misses, %"PRId64" bytes\n",
+           stats1.packet_cache_hits, stats1.packet_cache_misses, stats1.packet_cache_size);
+    if (stats1.packet_cache_misses != stats0.packet_cache_misses ||
+        stats1.packet_cache_hits - stats0.packet_cache_hits < NB_FRAMES) {
+        fprintf(stderr, "the packets were not served from the packet cache\n");
+        goto end;
+    }
+
+    /* The input must outlive the context which opened it */
+    sxplayer_free(&s0);
+    static const double times[] = {60.0, 10.0, 10.5, 150.0};
+    for (int i = 0; i < sizeof(times) / sizeof(*times); i++)
+        if (check_seek(s1, times[i]) < 0)
+            goto end;
+
+    ret = 0;
+
+end:
+    sxplayer_free(&s0);
+    sxplayer_free(&s1);
+    return ret;
+}
@@ -0,0 +1,81 @@
+#ifndef TEST_UTILS_H
+#define TEST_UTILS_H
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <sxplayer.h>
+
+#define FRAME_RATE 25 // frame rate of the test media
+
+/* Timestamp of the frame displayed at t */
+static inline double expected_ts(double t)
+{
+    return floor(t * FRAME_RATE + 1e-6) / FRAME_RATE;
+}
+
+static inline struct sxplayer_ctx *create_context(const char *filename, int use_pkt_duration)
+{
+    struct sxplayer_ctx *s = sxplayer_create(filename);
+    if (!s)
+        return NULL;
+    sxplayer_set_option(s, "auto_hwaccel", 0);
+    sxplayer_set_option(s, "use_pkt_duration", use_pkt_duration);
+    return s;
+}
+
+/* Read the remaining frames, storing up to nb_ts of their timestamps, and
+ * return how many there were */
+static inline int read_frames(struct sxplayer_ctx *s, double *ts, int nb_ts)
+{
+    int n = 0;
+    for (;;) {
+        struct sxplayer_frame *frame = sxplayer_get_next_frame(s);
+        if (!frame)
+            break;
+        if (n < nb_ts)
+            ts[n] = frame->ts;
+        n++;
+        sxplayer_release_frame(frame);
+    }
+    return n;
+}
+
+/* Check and release the frame obtained for a request at t */
+static inline int check_frame(struct sxplayer_frame *frame, double t, double expected)
+{
+    if (!frame) {
+        fprintf(stderr, "t=%f: no frame\n", t);
+        return -1;
+    }
+    const double frame_ts = frame->ts;
+    sxplayer_release_frame(frame);
+    if (fabs(frame_ts - expected) > 1e-6) {
+        fprintf(stderr, "t=%f: got frame %f instead of %f\n", t, frame_ts, expected);
+        return -1;
+    }
+    return 0;
+}
+
+static inline int check_seek(struct sxplayer_ctx *s, double t)
+{
+    return check_frame(sxplayer_get_frame(s, t), t, expected_ts(t));
+}
+
+/* Returns 0 if both frames (or none) are there with the same timestamp and
+ * the same RGBA pixels */
+static inline int cmp_frames(const struct sxplayer_frame *ref, const struct sxplayer_frame *frame)
+{
+    if (!ref || !frame)
+        return ref != frame;
+    if (frame->ts != ref->ts || frame->pix_fmt != ref->pix_fmt ||
+        frame->width != ref->width || frame->height != ref->height)
+        return 1;
+    for (int y = 0; y < ref->height; y++)
+        if (memcmp(frame->data + y * frame->linesize, ref->data + y * ref->linesize, ref->width * 4))
+            return 1;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <poll.h>
+
+#include <sxplayer.h>
+
+#include "test_utils.h"
+
+#define NB_REQUESTS 200
+#define NB_QUEUED_REQUESTS 10
+#define POLL_TIMEOUT 10000
+
+/* Wait for the pipeline to queue a frame after the one returned last */
+static int wait_frame_queued(struct sxplayer_ctx *s)
+{
+    const int fd = sxplayer_get_event_fd(s);
+    if (fd < 0)
+        return -1;
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+    if (poll(&pfd, 1, POLL_TIMEOUT) != 1) {
+        fprintf(stderr, "no frame queued after %dms\n", POLL_TIMEOUT);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int ac, char **av)
+{
+    if (ac < 2) {
+        fprintf(stderr, "Usage: %s <media.mkv> [<use_pkt_duration>]\n", av[0]);
+        return -1;
+    }
+
+    const char *filename = av[1];
+    const int use_pkt_duration = ac > 2 ? atoi(av[2]) : 0;
+    int ret = -1;
+
+    struct sxplayer_ctx *s = create_context(filename, use_pkt_duration);
+    if (!s)
+        return -1;
+
+    /* Increasing times between the frames, some of them within the same
+     * frame, the others skipping frames the decoder drops */
+    static const double steps[] = {0.011, 0.13, 0.031, 0.29, 0.017};
+    double t = 0.007;
+    for (int i = 0; i < NB_REQUESTS; i++) {
+        if (check_seek(s, t) < 0)
+            goto end;
+        t += steps[i % (sizeof(steps) / sizeof(*steps))];
+    }
+
+    /* The time is requested while the frames following the previous request
+     * are already queued */
+    for (int i = 0; i < NB_QUEUED_REQUESTS; i++) {
+        t = 30.007 + i * 0.53;
+        if (check_seek(s, t) < 0 || wait_frame_queued(s) < 0)
+            goto end;
+    }
+
+    ret = 0;
+
+end:
+    sxplayer_free(&s);
+    return ret;
+}